@@ -1,6 +1,9 @@
 /**
  * Arduino firmware for a motorised telescope focuser which provides an HTTP interface.
- * HTTP requests to this device are blocking and will not respond until motor movement is complete so take care with your client side timeouts.
+ * HTTP requests return immediately. Motor movement runs in the background from loop() and can be followed by polling the state,
+ * which reports the live absolutePosition and a moving flag until the move is complete.
+ * Where the focuser comes to rest is journaled in EEPROM (see journal.h) and restored at power on, the state reports
+ * positionRestored and the bootCount.
  *
  * Based on the ethercard library by Jean-Claude Wippler (https://github.com/jcw/ethercard) You will need to install this in your arduino IDE to flash this firmware. See instrunctions in the ethercard github project page.
  *
@@ -32,6 +35,9 @@
  *      B+ --  coil b
  *      B- --  coil b
  *      12v+ -- NA (common from motor not connected, was running very hot when stopped for some reason when connected)
+ *     Arduino -- Thermistor (optional, 10k NTC for temperature compensation, see temperature.h):
+ *      5v -- 10k resistor -- A0
+ *      A0 -- thermistor -- GND
  *
  *
  *  Example curl requests:
@@ -39,37 +45,59 @@
  *    Move to a position:  curl 'http://192.168.1.203/focuser?absolutePosition=20000'
  *    Change the speed config:  curl 'http://192.168.1.203/focuser?speed=100'
  *    Change backlashSteps config: curl 'http://192.168.1.203/focuser?backlashSteps=11'
+ *    Change the backlash strategy (CW, CCW or empty for direction changes only): curl 'http://192.168.1.203/focuser?alwaysApproach=CW'
+ *    Ramp up to a faster top speed:  curl 'http://192.168.1.203/focuser?acceleration=2000&maxSpeed=560&speed=560'
+ *    Start an autofocus sweep:  curl 'http://192.168.1.203/focuser?sequence=9000,9100,9200,9300'
+ *      then step through it with ordinary moves:  curl 'http://192.168.1.203/focuser?absolutePosition=9100'
+ *    Set the position without moving, e.g. after a reset:  curl 'http://192.168.1.203/focuser?syncPosition=8450'
+ *    Poll a move with the compact status frame:  curl 'http://192.168.1.203/focuser/p'
+ *  Status polls and moves can also be sent as UDP datagrams to port 4030, see udpframe.h.
  *  October 2015 Derek OKeeffe
  *
  **/
+#include <EEPROM.h>
 #include <EtherCard.h>
-#include <Stepper.h>
+#include <util/atomic.h>
+//The modules below have no Arduino dependencies: the mock focuser farm and the driver's host tests build them on a PC,
+//and the driver shares planner.h and udpframe.h
+#include "journal.h"
+#include "motion.h"
+#include "planner.h"
+#include "ramp.h"
+#include "request.h"
+#include "temperature.h"
+#include "udpframe.h"
 
-#define BUFFERSIZE 350
+//The longest focus response is 425 bytes, after 54 of Ethernet, IP and TCP headers
+#define BUFFERSIZE 500
 #define CS_PIN 8
+#define THERMISTOR_PIN A0
 
 //HTTP responses
-const char FOCUS_RESPONSE[] PROGMEM = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nPragma: no-cache\r\n\r\n{\"uptime\":\"$D$D:$D$D:$D$D\",\"speed\":$D,\"temperature\":null,\"temperatureCompensationOn\":false,\"backlashSteps\":$D,\"absolutePosition\":$D,\"maxPosition\":$D,\"minPosition\":$D,\"gearBoxMultiplier\":$D}";
+const char FOCUS_RESPONSE[] PROGMEM = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nPragma: no-cache\r\n\r\n{\"uptime\":\"$D$D:$D$D:$D$D\",\"speed\":$D,\"temperature\":$S,\"temperatureCompensationOn\":false,\"backlashSteps\":$D,\"absolutePosition\":$D,\"maxPosition\":$D,\"minPosition\":$D,\"gearBoxMultiplier\":$D,\"moving\":$S,\"targetPosition\":$D,\"maxSpeed\":$D,\"acceleration\":$D,\"sequenceStep\":$D,\"sequenceLength\":$D,\"bootCount\":$D,\"positionRestored\":$S}";
+//Compact status for polling while moving: absolutePosition targetPosition moving speed moveCount sequenceStep
+const char COMPACT_RESPONSE[] PROGMEM = "HTTP/1.0 200 OK\r\n\r\n$D $D $D $D $D $D";
 const char BADREQUEST_RESPONSE[] PROGMEM = "HTTP/1.0 400 Bad Request";
 const char NOTFOUND_RESPONSE[] PROGMEM = "HTTP/1.0 404 Not Found";
 
 //Focuser defaults and constants
-//The default starting position when powered on.
+//The starting position when powered on for the first time, after that the journaled one.
 const int DEFAULT_ABS_POSN = 10000;
 const int MAX_APS_POSN = 20000;
 const int MIN_APS_POSN = 0;
-const int MAX_SPEED = 280;
+//Speeds are in rpm. Without acceleration the motor stalls much above 280, with a ramp it can be raised using maxSpeed.
+const int DEFAULT_MAX_SPEED = 280;
+//Acceleration in steps per second per second. 0 starts and stops at full speed.
+const int DEFAULT_ACCELERATION = 0;
 const int STEPS_PER_REVOLUTION = 195; //steps per rev of the motor. One I used is,,,wierd.
 const int GEARBOX_MULTIPLIER = 10; //if the stepper is attached to a gearbox. In my case it is. All steps (backlash and movements) will be multiplied by this.
 
 //Backlash compensation steps.
 const int DEFAULT_BACKLASHSTEPS = 100;
-//ALWAYS_APPROACH_CCW_BACKLASH_COMPENSATION is useful when attaching to SCT mirror shift focuser knobs.
-//The final focus turn should always be CCW on most SCTs to avoid mirror movement during long exposures. This strategy also reduces image shift when using auto focus software.
-//This setting works in conjunction with backlash steps. If CW motion, then it will go beyond the requested position then back CCW to the requested position.
-//If set to false then backlash steps are only applied on direction changes.
-//If using zero backlash crawford focuser, set this to false and backlash steps to 0.
-const boolean ALWAYS_APPROACH_CCW_BACKLASH_COMPENSATION = true;
+//Always approaching CCW is useful when attaching to SCT mirror shift focuser knobs, see planner.h for the strategies.
+//Requests change it with alwaysApproach=CW, CCW or an empty value for compensation on direction changes only.
+//If using zero backlash crawford focuser, use an empty value and backlash steps of 0.
+const int8_t DEFAULT_BACKLASH_STRATEGY = BACKLASH_APPROACH_CCW;
 
 
 // ethernet interface mac address, must be unique on the LAN
@@ -82,28 +110,148 @@ BufferFiller bfill;
 
 //motor settings
 static int backlashSteps;
-static int currentPosition;
+static int8_t backlashStrategy;
 static int currentSpeed;
-//-1=counter clock wise motion, +1 = clockwise.
-static int previousDirection = 0;
-Stepper myStepper(STEPS_PER_REVOLUTION, 6, 7);
+static int maxSpeed;
+static int acceleration;
+//Moves started since power on, wrapping at 32768, so a poller can tell its move from a later one and notice a reset.
+static int moveCount;
 
 /**
- * Setup: Initalise the ethernet module and motor controller. Set absolute position to default
+ * Move sequence for autofocus sweeps. Loading one moves to its first target, later targets are reached with ordinary
+ * absolutePosition requests, which run as sequence legs so backlash is taken up once per sweep rather than per sample.
+ * A request for any position that is not further along the sequence ends it.
+ */
+static int sequence[REQUEST_MAX_SEQUENCE];
+static byte sequenceLength;
+//1 based index of the target last moved to, 0 before the first.
+static byte sequenceStep;
+//The way every target is approached: CW (1) if the sequence runs to lower positions, otherwise CCW (-1).
+static int8_t sequenceDirection;
+
+/**
+ * UDP channel. The last client to send a command gets telemetry, broadcast so no ARP lookup is needed, until it has
+ * been quiet for UDP_SUBSCRIPTION_MS. Its last reply is kept to answer a resent command without acting on it twice.
+ */
+static const uint8_t BROADCAST_IP[] = { 255, 255, 255, 255 };
+static uint8_t udpClientIp[4];
+static uint16_t udpClientPort;
+static unsigned long udpLastHeard;
+static uint8_t udpReply[UDP_STATUS_SIZE];
+static unsigned long lastTelemetry;
+static uint16_t telemetrySeq;
+static bool telemetryMoving;
+
+/**
+ * Temperature, averaged over TEMPERATURE_SAMPLES readings taken TEMPERATURE_SAMPLE_MS apart so it changes every second
+ * or two without jitter. TEMPERATURE_NONE until the first average, or without a thermistor.
+ */
+const unsigned long TEMPERATURE_SAMPLE_MS = 100;
+const uint8_t TEMPERATURE_SAMPLES = 16;
+static int temperatureTenths = TEMPERATURE_NONE;
+static uint16_t temperatureSum;
+static uint8_t temperatureCount;
+static unsigned long lastTemperatureSample;
+
+/**
+ * Step generator on Timer1. The compare interrupt issues each step and loads the interval to the next one from the ramp.
+ * Pins 6 and 7 (PD6 and PD7) are driven with the same 2 wire sequence the Stepper library used, so steps, speeds and
+ * positions mean what they always have.
+ */
+//CTC mode with a /64 prescaler, 4us ticks
+const uint32_t STEP_TIMER_HZ = F_CPU / 64;
+const uint8_t STEP_PINS = _BV(PD6) | _BV(PD7);
+const uint8_t STEP_SEQUENCE[] = { _BV(PD7), _BV(PD6) | _BV(PD7), _BV(PD6), 0 };
+
+static StepRamp ramp;
+static volatile int8_t stepDirection;
+static volatile uint8_t stepPhase;
+static volatile bool stepTimerRunning;
+
+ISR(TIMER1_COMPA_vect) {
+  stepPhase = (stepPhase + stepDirection) & 3;
+  PORTD = (PORTD & ~STEP_PINS) | STEP_SEQUENCE[stepPhase];
+  uint32_t interval = ramp.nextInterval();
+  if (interval == 0) {
+    TIMSK1 &= ~_BV(OCIE1A);
+    stepTimerRunning = false;
+  } else {
+    OCR1A = interval - 1;
+  }
+}
+
+class TimerStepDriver : public StepDriver {
+  public:
+    void begin() {
+      pinMode(6, OUTPUT);
+      pinMode(7, OUTPUT);
+      PORTD = (PORTD & ~STEP_PINS) | STEP_SEQUENCE[stepPhase];
+      TCCR1A = 0;
+      TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);
+    }
+
+    virtual void start(int8_t direction, int32_t steps, uint32_t speed, uint32_t acceleration) {
+      uint32_t interval = ramp.begin(steps, speed, acceleration, STEP_TIMER_HZ);
+      stepDirection = direction;
+      stepTimerRunning = true;
+      OCR1A = interval - 1;
+      TCNT1 = 0;
+      TIFR1 = _BV(OCF1A);
+      TIMSK1 |= _BV(OCIE1A);
+    }
+
+    virtual int32_t stepsDone() {
+      int32_t done;
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        done = ramp.stepsDone();
+      }
+      return done;
+    }
+
+    virtual bool isRunning() {
+      return stepTimerRunning;
+    }
+};
+
+TimerStepDriver stepDriver;
+FocuserMotion motion(stepDriver, STEPS_PER_REVOLUTION, GEARBOX_MULTIPLIER);
+
+class EepromStorage : public JournalStorage {
+  public:
+    virtual uint8_t read(uint16_t address) {
+      return EEPROM.read(address);
+    }
+
+    virtual void write(uint16_t address, uint8_t value) {
+      EEPROM.update(address, value);
+    }
+};
+
+EepromStorage eepromStorage;
+PositionJournal journal(eepromStorage);
+
+/**
+ * Setup: Initalise the ethernet module and motor controller. Restore the absolute position from the journal, or the
+ * default on first power on
  */
 void setup () {
   Serial.begin(9600);
   Serial.println("\n[getStaticIP]");
-  currentPosition = DEFAULT_ABS_POSN;
-  currentSpeed = MAX_SPEED;
+  journal.begin(DEFAULT_ABS_POSN);
+  motion.setPosition(journal.position());
+  currentSpeed = DEFAULT_MAX_SPEED;
+  maxSpeed = DEFAULT_MAX_SPEED;
+  acceleration = DEFAULT_ACCELERATION;
   backlashSteps = DEFAULT_BACKLASHSTEPS;
+  backlashStrategy = DEFAULT_BACKLASH_STRATEGY;
+  stepDriver.begin();
   if (ether.begin(sizeof Ethernet::buffer, mymac, CS_PIN) == 0) {
     Serial.println(F("Failed to access Ethernet controller"));
   }
   Serial.println("\n[static setup]");  
   ether.staticSetup(myip);
-  myStepper.setSpeed(currentSpeed);
   Serial.println("\n[gotIP]");  
+  ether.udpServerListenOnPort(&udpCommand, UDP_FOCUSER_PORT);
 }
 
 /**
@@ -114,12 +262,103 @@ static word focusResponse() {
   word h = t / 3600;
   byte m = (t / 60) % 60;
   byte s = t % 60;
+  char temperature[TEMPERATURE_TEXT_SIZE];
+  formatTemperature(temperatureTenths, temperature);
   bfill = ether.tcpOffset();
   bfill.emit_p(FOCUS_RESPONSE,
-               h / 10, h % 10, m / 10, m % 10, s / 10, s % 10, currentSpeed, backlashSteps, currentPosition, MAX_APS_POSN, MIN_APS_POSN, GEARBOX_MULTIPLIER);
+               h / 10, h % 10, m / 10, m % 10, s / 10, s % 10, currentSpeed, temperature, backlashSteps, motion.position(), MAX_APS_POSN, MIN_APS_POSN, GEARBOX_MULTIPLIER,
+               motion.isMoving() ? "true" : "false", motion.targetPosition(), maxSpeed, acceleration, sequenceStep, sequenceLength,
+               journal.bootCount(), journal.restored() ? "true" : "false");
+  return bfill.position();
+}
+
+/**
+ * Build the compact status frame. Only what changes during a move, the configuration comes from focusResponse().
+ */
+static word compactResponse() {
+  bfill = ether.tcpOffset();
+  bfill.emit_p(COMPACT_RESPONSE, motion.position(), motion.targetPosition(), motion.isMoving() ? 1 : 0, currentSpeed, moveCount, sequenceStep);
   return bfill.position();
 }
 
+/**
+ * The status datagram sent as a UDP reply or telemetry.
+ */
+static void udpStatus(uint8_t type, uint16_t seq, uint8_t* frame) {
+  UdpStatus status = { type, (uint16_t)seq, (uint16_t)motion.position(), (uint16_t)motion.targetPosition(),
+                       (uint8_t)(motion.isMoving() ? UDP_FLAG_MOVING : 0), (uint16_t)currentSpeed, (uint16_t)moveCount, sequenceStep };
+  encodeUdpStatus(status, frame);
+}
+
+/**
+ * Called by EtherCard for each datagram to UDP_FOCUSER_PORT. A move runs through interpretCommand() like its HTTP
+ * equivalent. A command with the sequence number just answered is a resend, it gets the same reply again.
+ */
+static void udpCommand(uint16_t destPort, uint8_t srcIp[4], uint16_t srcPort, const char* data, uint16_t len) {
+  UdpCommand command;
+  if (!decodeUdpCommand((const uint8_t*) data, len, command)) {
+    return;
+  }
+  bool resend = udpClientPort == srcPort && memcmp(udpClientIp, srcIp, 4) == 0 && udpGet16(udpReply + 1) == command.seq &&
+                udpReply[0] == (command.type | UDP_REPLY);
+  if (!resend) {
+    if (command.type == UDP_MOVE) {
+      FocuserRequest request;
+      clearRequest(request);
+      request.absolutePosition = command.target;
+      if (command.backlashSteps != UDP_KEEP) {
+        request.backlashSteps = command.backlashSteps;
+      }
+      if (command.backlashStrategy >= BACKLASH_APPROACH_CCW && command.backlashStrategy <= BACKLASH_APPROACH_CW) {
+        request.alwaysApproach = command.backlashStrategy;
+      }
+      interpretCommand(request);
+    }
+    udpStatus(command.type | UDP_REPLY, command.seq, udpReply);
+    memcpy(udpClientIp, srcIp, 4);
+    udpClientPort = srcPort;
+  }
+  udpLastHeard = millis();
+  ether.makeUdpReply((const char*) udpReply, UDP_STATUS_SIZE, destPort);
+}
+
+/**
+ * Telemetry for the UDP client, if it is still listening. Sent straight away when a move starts or stops.
+ */
+static void sendTelemetry() {
+  unsigned long now = millis();
+  if (udpClientPort == 0 || now - udpLastHeard > UDP_SUBSCRIPTION_MS) {
+    return;
+  }
+  bool moving = motion.isMoving();
+  if (moving == telemetryMoving && now - lastTelemetry < (moving ? UDP_TELEMETRY_MOVING_MS : UDP_TELEMETRY_IDLE_MS)) {
+    return;
+  }
+  telemetryMoving = moving;
+  lastTelemetry = now;
+  uint8_t frame[UDP_STATUS_SIZE];
+  udpStatus(UDP_TELEMETRY, ++telemetrySeq, frame);
+  ether.sendUdp((const char*) frame, UDP_STATUS_SIZE, UDP_FOCUSER_PORT, BROADCAST_IP, udpClientPort);
+}
+
+/**
+ * Take a thermistor reading when one is due, updating the temperature when enough are summed. An analogRead() takes
+ * about 100us, the step timer keeps the motor going meanwhile.
+ */
+static void sampleTemperature() {
+  unsigned long now = millis();
+  if (now - lastTemperatureSample < TEMPERATURE_SAMPLE_MS) {
+    return;
+  }
+  lastTemperatureSample = now;
+  temperatureSum += analogRead(THERMISTOR_PIN);
+  if (++temperatureCount == TEMPERATURE_SAMPLES) {
+    temperatureTenths = thermistorTenths((float) temperatureSum / TEMPERATURE_SAMPLES);
+    temperatureSum = 0;
+    temperatureCount = 0;
+  }
+}
+
 /**
  * Build the 404 HTTP response
  */
@@ -134,102 +373,102 @@ static word notFound() {
  * Main loop
  */
 void loop () {
+  motion.run();
+  //At rest somewhere new, after a move or a syncPosition
+  if (!motion.isMoving()) {
+    journal.commit(motion.position());
+  }
   word len = ether.packetReceive();
   word pos = ether.packetLoop(len);
   if (pos)  {
     bfill = ether.tcpOffset();
-    char* data = (char *) Ethernet::buffer + pos;
-    //Serial.println(data);
-    String stringData = String(data);
-    if (!stringData.startsWith("GET /focuser")) {
+    const char* data = (const char *) Ethernet::buffer + pos;
+    FocuserRequest request;
+    parseRequest(data, len - pos, request);
+    if (request.route == ROUTE_COMPACT) {
+      ether.httpServerReply(compactResponse());
+    } else if (request.route == ROUTE_NOT_FOUND) {
       ether.httpServerReply(notFound());
-    } else if (stringData.startsWith("GET /focuser?")) {
-      interpretCommandFromQueryString(data);
-      ether.httpServerReply(focusResponse());
     } else {
+      if (request.hasQuery) {
+        interpretCommand(request);
+      }
       ether.httpServerReply(focusResponse());
     }
   }
+  sendTelemetry();
+  sampleTemperature();
 }
 
-static int getIntArg(const char* data, const char* key, int value = -1) {
-  char temp[30];
-  if (ether.findKeyVal(data + 7, temp, sizeof temp, key) > 0) {
-    value = atoi(temp);
-  }
-  return value;
+/**
+ * Load the positions of a sequence= argument as the move sequence. Returns false, leaving no sequence, if there are none.
+ */
+static bool loadSequence(const FocuserRequest &request) {
+  sequenceLength = request.sequenceLength;
+  sequenceStep = 0;
+  memcpy(sequence, request.sequence, sequenceLength * sizeof sequence[0]);
+  sequenceDirection = sequenceLength > 1 && sequence[1] < sequence[0] ? 1 : -1;
+  return sequenceLength > 0;
 }
 
 /**
- * Iterpret the query string and move the stepper if needed
+ * The approach for a move to position: the sequence direction if position is one of the targets still ahead, after
+ * which the sequence continues from there. 0, ending the sequence, if not.
  */
-static void interpretCommandFromQueryString (const char* data) {
-  int requestedPosition = currentPosition;
-  if (data[12] == '?') {
-    int s = getIntArg(data, "speed", currentSpeed);
-    int a = getIntArg(data, "absolutePosition", currentPosition);
-    int b = getIntArg(data, "backlashSteps", backlashSteps);
-    if (s > 0) {
-      myStepper.setSpeed(s);
-      currentSpeed = s;
+static int8_t sequenceApproach(int position) {
+  for (byte i = sequenceStep; i < sequenceLength; i++) {
+    if (sequence[i] == position) {
+      sequenceStep = i + 1;
+      return sequenceDirection;
     }
-    if (a > 0) {
-      requestedPosition = a;
-    }
-    if (b > 0) {
-      backlashSteps = b;
-    }
-  }
-  if (requestedPosition != currentPosition) {
-    int steps = currentPosition - requestedPosition;
-    moveMotor(steps);
-    currentPosition = requestedPosition;
   }
+  sequenceLength = 0;
+  sequenceStep = 0;
+  return 0;
 }
 
 /**
- * Move the motor and also apply backlash compensation depending on settings.
- * If ALWAYS_APPROACH_CCW_BACKLASH_COMPENSATION==true, then backlash is only applied for all CW motion. Rotating CW, then back CCW the backlash steps.
- * If ALWAYS_APPROACH_CCW_BACKLASH_COMPENSATION==false then backlash is applied on direction changes.
- * Whenever backlash motion is applied, motor speed is set to max.
- */
-static void moveMotor(int steps) {
-  String debugMessage = "moving: ";
-  Serial.println(debugMessage + (steps * GEARBOX_MULTIPLIER));
-  for (int i = 0; i < GEARBOX_MULTIPLIER; i++) {
-    //move the moter steps * GEARBOX_MULTIPLIER times. We cannot just * the 2 int values as sometimes they are too big and results in +ive int becoming -ve
-    myStepper.step(steps);
-  }
-  //now apply backlash strategy
-  if (ALWAYS_APPROACH_CCW_BACKLASH_COMPENSATION) {
-    if (steps > 0) {
-      Serial.println("Going CW then back CCW by backlash ammount");
-      //CW motion request so we need to go further than requested then back
-      myStepper.setSpeed(MAX_SPEED);
-      myStepper.step(backlashSteps * GEARBOX_MULTIPLIER);    //go CW backlash
-      myStepper.step(backlashSteps * -1 * GEARBOX_MULTIPLIER); //now go back CCW to where we came from;
-      myStepper.setSpeed(currentSpeed);
-    }
-  } else {
-    //standard backlash compensation mode, use the backlash steps configured
-    if (!backlashSteps > 0 && (steps > 0 && previousDirection < 0 || steps < 0 && previousDirection > 0)) {
-      //backlash compensation required due to direction change. Go as fast as possible to compensate for backlash
-      Serial.println("Backlash compensating");
-      myStepper.setSpeed(MAX_SPEED);
-      if (steps > 0) {
-        myStepper.step(backlashSteps * GEARBOX_MULTIPLIER);
-      } else {
-        myStepper.step(backlashSteps * -1 * GEARBOX_MULTIPLIER);
-      }
-      myStepper.setSpeed(currentSpeed);
-    }
+ * Apply the query arguments and start moving the stepper if needed. Missing arguments are REQUEST_ARG_ABSENT, which
+ * every check below ignores.
+ */
+static void interpretCommand(const FocuserRequest &request) {
+  int requestedPosition = motion.targetPosition();
+  bool sequenceLoaded = false;
+  if (request.maxSpeed > 0) {
+    maxSpeed = request.maxSpeed;
   }
-  //remember this direction for future movements.
-  if (steps < 0) {
-    previousDirection = -1;
-  } else {
-    previousDirection = 1;
+  if (request.acceleration >= 0) {
+    acceleration = request.acceleration;
+  }
+  if (request.speed > 0) {
+    currentSpeed = request.speed < maxSpeed ? request.speed : maxSpeed;
+  }
+  if (request.absolutePosition > 0) {
+    requestedPosition = request.absolutePosition;
+  }
+  if (request.backlashSteps >= 0) {
+    backlashSteps = request.backlashSteps;
+  }
+  if (request.alwaysApproach != REQUEST_STRATEGY_ABSENT) {
+    backlashStrategy = request.alwaysApproach;
+  }
+  //only while stopped, the steps of a running move are counted from where it started
+  if (request.syncPosition >= 0 && !motion.isMoving()) {
+    motion.setPosition(request.syncPosition);
+    requestedPosition = request.syncPosition;
+    sequenceLength = 0;
+    sequenceStep = 0;
+  }
+  if (request.hasSequence && loadSequence(request)) {
+    requestedPosition = sequence[0];
+    sequenceLoaded = true;
+  }
+  //The first leg of a new sequence always runs, even to where the focuser already is, to take up backlash the right way
+  if (requestedPosition != motion.targetPosition() || sequenceLoaded) {
+    Serial.print("moving to: ");
+    Serial.println(requestedPosition);
+    MoveRequest move = { requestedPosition, currentSpeed, maxSpeed, acceleration, backlashSteps, backlashStrategy };
+    motion.moveTo(move, sequenceApproach(requestedPosition));
+    moveCount = (moveCount + 1) & 0x7FFF;
   }
 }
-
-
@@ -0,0 +1,59 @@
+/**
+ * Position journal in EEPROM, so the focuser is where it thinks it is after a power cycle.
+ *
+ * A position is written each time the focuser comes to rest somewhere new, never while it moves, into the next of
+ * JOURNAL_SLOTS slots in a ring. Each slot is only written once every JOURNAL_SLOTS commits, so the EEPROM's rated
+ * 100,000 writes last for millions of moves. A slot holds a sequence number, the position, the boot count, a marker
+ * and a CRC-8, so a slot left half written by a power cut fails its check and the one before it is used.
+ * At boot the slot with the latest sequence number is restored and the boot is counted in a new slot.
+ */
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+
+/**
+ * Byte storage for the journal, the EEPROM on the device.
+ */
+class JournalStorage {
+  public:
+    virtual uint8_t read(uint16_t address) = 0;
+    //May skip the write if the byte already holds value, as EEPROM.update() does.
+    virtual void write(uint16_t address, uint8_t value) = 0;
+};
+
+//sequence u16, position u16, boot count u16, JOURNAL_MARKER, CRC-8 of the 7 bytes before it. Little endian.
+const uint16_t JOURNAL_SLOT_SIZE = 8;
+//512 bytes, half the Nano's EEPROM.
+const uint16_t JOURNAL_SLOTS = 64;
+const uint8_t JOURNAL_MARKER = 0x4A;
+
+class PositionJournal {
+  public:
+    PositionJournal(JournalStorage &storage, uint16_t start = 0);
+
+    //Restore the latest position, or take defaultPosition if there is none, and count this boot.
+    //Returns true if a position was restored.
+    bool begin(int defaultPosition);
+    //Journal position if it is not the last one journaled. Call only while the focuser is at rest.
+    void commit(int position);
+
+    int position() const { return lastPosition; }
+    //Boots since the journal was first written, this one included.
+    uint16_t bootCount() const { return boots; }
+    bool restored() const { return wasRestored; }
+
+  private:
+    void write(int position);
+    bool readSlot(uint16_t slot, uint16_t &sequence, uint16_t &position, uint16_t &bootCount);
+
+    JournalStorage &storage;
+    uint16_t start;
+    uint16_t nextSlot;
+    uint16_t nextSequence;
+    int lastPosition;
+    uint16_t boots;
+    bool wasRestored;
+};
+
+#endif
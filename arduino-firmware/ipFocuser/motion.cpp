@@ -0,0 +1,67 @@
+#include "motion.h"
+
+FocuserMotion::FocuserMotion(StepDriver &driver, int stepsPerRevolution, int gearboxMultiplier)
+  : driver(driver), stepsPerRevolution(stepsPerRevolution), gearboxMultiplier(gearboxMultiplier),
+    currentPosition(0), segmentStartPosition(0), target(0), acceleration(0), segmentIndex(0), hasPending(false) {
+  state.loadedDirection = 0;
+  plan.count = 0;
+}
+
+void FocuserMotion::setPosition(int position) {
+  currentPosition = position;
+  target = position;
+}
+
+void FocuserMotion::moveTo(const MoveRequest &request, int8_t approach) {
+  if (isMoving()) {
+    pending = request;
+    pendingApproach = approach;
+    hasPending = true;
+  } else {
+    start(request, approach);
+  }
+}
+
+/**
+ * Plan the move from where the focuser is and start its first segment.
+ */
+void FocuserMotion::start(const MoveRequest &request, int8_t approach) {
+  target = request.target;
+  acceleration = request.acceleration > 0 ? request.acceleration : 0;
+  planMove(currentPosition, request, approach, gearboxMultiplier, state, plan);
+  segmentIndex = 0;
+  if (plan.count > 0) {
+    startSegment();
+  }
+}
+
+void FocuserMotion::startSegment() {
+  PlanSegment &segment = plan.segments[segmentIndex];
+  segmentStartPosition = currentPosition;
+  driver.start(segment.direction, segment.steps, (uint32_t)segment.rpm * stepsPerRevolution / 60, acceleration);
+}
+
+void FocuserMotion::run() {
+  if (!isMoving()) {
+    return;
+  }
+  PlanSegment &segment = plan.segments[segmentIndex];
+  bool running = driver.isRunning();
+  if (segment.tracksPosition) {
+    currentPosition = segmentStartPosition - segment.direction * (int)(driver.stepsDone() / gearboxMultiplier);
+  }
+  if (running) {
+    return;
+  }
+  if (segment.tracksPosition) {
+    currentPosition = target;
+  }
+  if (++segmentIndex < plan.count) {
+    startSegment();
+    return;
+  }
+  if (hasPending) {
+    hasPending = false;
+    start(pending, pendingApproach);
+  }
+}
@@ -0,0 +1,64 @@
+/**
+ * Cooperative motion state machine for the focuser stepper.
+ *
+ * A move is planned up front by planMove() (see planner.h) as a short list of segments: the move itself plus any backlash
+ * compensation. Each segment is handed to a StepDriver, which generates the steps in the background, and loop() calls run() to follow progress and
+ * start the next segment, so the ethernet stack keeps running while the motor turns.
+ */
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdint.h>
+#include "planner.h"
+
+/**
+ * Generates the steps of one segment in the background, e.g. from a timer interrupt.
+ * Positive direction is CW and moves the focuser towards lower absolute positions.
+ */
+class StepDriver {
+  public:
+    //speed in steps per second, acceleration in steps per second per second (0 for none)
+    virtual void start(int8_t direction, int32_t steps, uint32_t speed, uint32_t acceleration) = 0;
+    virtual int32_t stepsDone() = 0;
+    virtual bool isRunning() = 0;
+};
+
+class FocuserMotion {
+  public:
+    FocuserMotion(StepDriver &driver, int stepsPerRevolution, int gearboxMultiplier);
+
+    void setPosition(int position);
+    //Start moving, or if a move is already running queue this one to start when it finishes. The latest queued request wins.
+    //approach is as for planMove(): 0 applies the request's backlash strategy, 1 (CW) or -1 (CCW) plans a leg of a move
+    //sequence approached that way.
+    void moveTo(const MoveRequest &request, int8_t approach = 0);
+    //Follow the driver and start the next segment when it is done. Call as often as possible.
+    void run();
+
+    bool isMoving() const { return segmentIndex < plan.count; }
+    int position() const { return currentPosition; }
+    int targetPosition() const { return hasPending ? pending.target : target; }
+
+  private:
+    void start(const MoveRequest &request, int8_t approach);
+    void startSegment();
+
+    StepDriver &driver;
+    int stepsPerRevolution;
+    int gearboxMultiplier;
+
+    int currentPosition;
+    int segmentStartPosition;
+    int target;
+    uint32_t acceleration;
+    PlannerState state;
+
+    MotionPlan plan;
+    uint8_t segmentIndex;
+
+    MoveRequest pending;
+    int8_t pendingApproach;
+    bool hasPending;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * Move planner shared by the firmware and the Indi driver.
+ *
+ * Turns a move request into the exact segments the motor runs: the move itself plus any backlash compensation, each
+ * with its direction, motor steps and speed. The firmware runs the plan through FocuserMotion, the driver plans the same
+ * move to know what the device will do with it without asking. Positive direction is CW and moves the focuser towards
+ * lower absolute positions.
+ * Header only, with no Arduino dependencies, so the firmware and the driver compile the same code.
+ */
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//How backlash is taken up outside a move sequence. The values are the direction every target is finally approached in.
+enum BacklashStrategy {
+  //Take up backlash only when the direction changes. For a zero backlash focuser set backlashSteps to 0 as well.
+  BACKLASH_ON_REVERSAL = 0,
+  //CCW moves go past the target and come back CW.
+  BACKLASH_APPROACH_CW = 1,
+  //CW moves go past the target and come back CCW. The final turn of an SCT focuser knob should be CCW to avoid
+  //mirror shift during long exposures, this also reduces image shift when using auto focus software.
+  BACKLASH_APPROACH_CCW = -1
+};
+
+struct MoveRequest {
+  int target;
+  int speed;          //rpm for the requested move
+  int backlashSpeed;  //rpm for backlash compensation moves
+  int acceleration;   //steps per second per second, 0 for none
+  int backlashSteps;
+  int8_t backlashStrategy;
+};
+
+struct PlanSegment {
+  int8_t direction;
+  int32_t steps;        //motor steps, the gearbox multiplier applied
+  int rpm;
+  bool tracksPosition;  //the move itself rather than backlash compensation
+};
+
+struct MotionPlan {
+  PlanSegment segments[3];
+  uint8_t count;
+};
+
+//Which way the gears were driven, carried from one plan to the next.
+struct PlannerState {
+  //Direction of the last segment, the side the backlash is taken up on. 0 at power on, when it is not known.
+  int8_t loadedDirection;
+};
+
+inline void addPlanSegment(MotionPlan &plan, int8_t direction, int32_t steps, int rpm, bool tracksPosition) {
+  if (steps <= 0 || rpm <= 0) {
+    return;
+  }
+  PlanSegment &segment = plan.segments[plan.count++];
+  segment.direction = direction;
+  segment.steps = steps;
+  segment.rpm = rpm;
+  segment.tracksPosition = tracksPosition;
+}
+
+/**
+ * Plan a move from position into plan, updating state for the next plan as if this one ran to the end.
+ * approach 0 applies the request's backlash strategy. 1 (CW) or -1 (CCW) plans a leg of a move sequence instead, as
+ * if the strategy was to approach that way, and even a leg to where the focuser already is takes up backlash left on
+ * the wrong side. So a sequence pays for backlash once, on its first leg, and every target in it is reached from the
+ * same side.
+ * The first backlashSteps driven against the way the gears are loaded only take up the slack. A target is approached:
+ *  - moving the approach way: slack on the other side is taken up first, then the move runs.
+ *  - moving against it: the move runs, goes past the target by backlashSteps and comes back, leaving the gears
+ *    loaded the approach way. Coming back is backlashSteps, or twice that if the gears were already loaded the way
+ *    of the move, as only then did going past really move the focuser.
+ *  - BACKLASH_ON_REVERSAL: slack is taken up first on a change of direction.
+ * Whenever backlash motion is applied, motor speed is set to backlashSpeed.
+ */
+inline void planMove(int position, const MoveRequest &request, int8_t approach, int gearboxMultiplier,
+                     PlannerState &state, MotionPlan &plan) {
+  plan.count = 0;
+  //long arithmetic, steps * gearboxMultiplier overflows an int on the AVR
+  int32_t steps = (int32_t)position - request.target;
+  int32_t backlash = request.backlashSteps > 0 ? (int32_t)request.backlashSteps * gearboxMultiplier : 0;
+  int8_t direction = steps > 0 ? 1 : steps < 0 ? -1 : 0;
+  int8_t way = approach != 0 ? approach : request.backlashStrategy;
+  if (direction == 0 && approach != 0 && state.loadedDirection == -approach) {
+    direction = -approach;
+  }
+  if (direction == 0) {
+    return;
+  }
+  int32_t moveSteps = steps * direction * gearboxMultiplier;
+  if (way == BACKLASH_ON_REVERSAL || direction == way) {
+    if (state.loadedDirection == -direction) {
+      addPlanSegment(plan, direction, backlash, request.backlashSpeed, false);
+    }
+    addPlanSegment(plan, direction, moveSteps, request.speed, true);
+  } else {
+    addPlanSegment(plan, direction, moveSteps, request.speed, true);
+    addPlanSegment(plan, direction, backlash, request.backlashSpeed, false);
+    addPlanSegment(plan, way, state.loadedDirection == direction ? 2 * backlash : backlash, request.backlashSpeed, false);
+  }
+  if (plan.count > 0) {
+    state.loadedDirection = plan.segments[plan.count - 1].direction;
+  }
+}
+
+/**
+ * The strategy named by text, which need not be NUL terminated: "CW", "CCW", or "", "none" or "false" for
+ * BACKLASH_ON_REVERSAL, in any case. "true" is CCW, what a boolean alwaysApproach always meant. Returns false, leaving
+ * strategy alone, for anything else, however long.
+ */
+inline bool backlashStrategyFromText(const char* text, size_t length, int8_t &strategy) {
+  char word[6];
+  if (length >= sizeof(word)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    word[i] = text[i] >= 'a' && text[i] <= 'z' ? text[i] - 'a' + 'A' : text[i];
+  }
+  word[length] = '\0';
+  const char* names[] = { "CW", "CCW", "TRUE", "", "NONE", "FALSE" };
+  const int8_t values[] = { BACKLASH_APPROACH_CW, BACKLASH_APPROACH_CCW, BACKLASH_APPROACH_CCW,
+                            BACKLASH_ON_REVERSAL, BACKLASH_ON_REVERSAL, BACKLASH_ON_REVERSAL };
+  for (uint8_t i = 0; i < sizeof(values); i++) {
+    const char* a = names[i];
+    const char* b = word;
+    while (*a && *a == *b) {
+      a++;
+      b++;
+    }
+    if (*a == *b) {
+      strategy = values[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include "ramp.h"
+#include <math.h>
+
+//OCR1A is 16 bits, and an interval that rounds to 0 ticks would end the move early
+static const uint32_t MAX_INTERVAL = 0xFFFFUL << 8;
+static const uint32_t MIN_INTERVAL = 1UL << 8;
+
+StepRamp::StepRamp()
+  : totalSteps(0), stepIndex(0), rampStep(0), cruising(true), interval(0), minInterval(0) {
+}
+
+uint32_t StepRamp::begin(int32_t steps, uint32_t speed, uint32_t acceleration, uint32_t timerHz) {
+  totalSteps = steps;
+  stepIndex = 0;
+  rampStep = 0;
+  minInterval = clampInterval(((uint64_t)timerHz << 8) / (speed > 0 ? speed : 1));
+  if (acceleration == 0) {
+    cruising = true;
+    interval = minInterval;
+  } else {
+    //first interval, with Austin's 0.676 correction for the error of the recurrence at n=1
+    cruising = false;
+    //clamped before the conversion, at low accelerations it is out of the range of a uint32_t
+    double first = 0.676 * timerHz * sqrt(2.0 / acceleration) * 256.0;
+    interval = first >= MAX_INTERVAL ? MAX_INTERVAL : clampInterval((uint32_t)first);
+    if (interval <= minInterval) {
+      interval = minInterval;
+      cruising = true;
+    }
+  }
+  return interval >> 8;
+}
+
+uint32_t StepRamp::nextInterval() {
+  stepIndex++;
+  int32_t remaining = totalSteps - stepIndex;
+  if (remaining <= 0) {
+    return 0;
+  }
+  if (!cruising && remaining == rampStep + 1) {
+    //the middle step of a move too short to reach speed with an even step count mirrors the one before it
+    rampStep = 1 - remaining;
+    return interval >> 8;
+  }
+  if (rampStep > 0 && remaining <= rampStep) {
+    //start decelerating as late as possible: it takes as many steps to stop as it took to get up to speed
+    rampStep = -remaining;
+  }
+  if (rampStep < 0) {
+    interval += (2 * interval) / (uint32_t)(-4 * rampStep - 1);
+    interval = clampInterval(interval);
+    rampStep++;
+  } else if (!cruising) {
+    rampStep++;
+    interval -= (2 * interval) / (uint32_t)(4 * rampStep + 1);
+    if (interval <= minInterval) {
+      interval = minInterval;
+      cruising = true;
+    }
+  }
+  return interval >> 8;
+}
+
+uint32_t StepRamp::clampInterval(uint32_t value) const {
+  return value > MAX_INTERVAL ? MAX_INTERVAL : value < MIN_INTERVAL ? MIN_INTERVAL : value;
+}
@@ -0,0 +1,35 @@
+/**
+ * Trapezoidal step timing, after David Austin's "Generate stepper-motor speed profiles in real time" (Embedded Systems
+ * Programming, January 2005). Each call to nextInterval() costs one 32 bit division, cheap enough to run from the step
+ * timer interrupt. Intervals are in timer ticks and kept in 24.8 fixed point between steps.
+ */
+#ifndef RAMP_H
+#define RAMP_H
+
+#include <stdint.h>
+
+class StepRamp {
+  public:
+    StepRamp();
+
+    //Plan a move of steps. speed in steps per second, acceleration in steps per second per second (0 for no ramp).
+    //Returns the interval before the first step.
+    uint32_t begin(int32_t steps, uint32_t speed, uint32_t acceleration, uint32_t timerHz);
+    //Interval between the step just taken and the next one, or 0 once all steps are done.
+    uint32_t nextInterval();
+
+    int32_t stepsDone() const { return stepIndex; }
+
+  private:
+    uint32_t clampInterval(uint32_t interval) const;
+
+    int32_t totalSteps;
+    int32_t stepIndex;
+    //>0 steps taken accelerating, <0 steps left decelerating
+    int32_t rampStep;
+    bool cruising;
+    uint32_t interval;
+    uint32_t minInterval;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "request.h"
+#include "planner.h"
+
+#include <string.h>
+
+//Request line so far: p is the next byte, end one past the last that may be read.
+struct Cursor {
+  const char* p;
+  const char* end;
+
+  //true at the end of the request line, the space before the HTTP version included
+  bool atEnd() const {
+    return p == end || *p == '\0' || *p == ' ' || *p == '\r' || *p == '\n';
+  }
+
+  bool skip(const char* text) {
+    size_t n = strlen(text);
+    if ((size_t)(end - p) < n || memcmp(p, text, n) != 0) {
+      return false;
+    }
+    p += n;
+    return true;
+  }
+};
+
+static bool endOfValue(const Cursor &c) {
+  return c.atEnd() || *c.p == '&';
+}
+
+//Read a number like atoi() does, saturating instead of overflowing. Anything after the digits is left for the caller.
+static int readInt(Cursor &c) {
+  bool negative = false;
+  if (!endOfValue(c) && (*c.p == '-' || *c.p == '+')) {
+    negative = *c.p++ == '-';
+  }
+  long value = 0;
+  while (!endOfValue(c) && *c.p >= '0' && *c.p <= '9') {
+    if (value < 32767) {
+      value = value * 10 + (*c.p - '0');
+    }
+    c.p++;
+  }
+  if (value > 32767) {
+    value = 32767;
+  }
+  return negative ? -(int)value : (int)value;
+}
+
+//The integer argument a key names, or 0 for keys that are not integers or not known.
+static int* intArg(const char* key, uint8_t length, FocuserRequest &request) {
+  switch (length) {
+    case 5:
+      return memcmp(key, "speed", 5) == 0 ? &request.speed : 0;
+    case 8:
+      return memcmp(key, "maxSpeed", 8) == 0 ? &request.maxSpeed : 0;
+    case 12:
+      if (memcmp(key, "acceleration", 12) == 0) {
+        return &request.acceleration;
+      }
+      return memcmp(key, "syncPosition", 12) == 0 ? &request.syncPosition : 0;
+    case 13:
+      return memcmp(key, "backlashSteps", 13) == 0 ? &request.backlashSteps : 0;
+    case 16:
+      return memcmp(key, "absolutePosition", 16) == 0 ? &request.absolutePosition : 0;
+  }
+  return 0;
+}
+
+//Comma separated positions. Entries that are not positive are skipped, as are any beyond REQUEST_MAX_SEQUENCE.
+static void readSequence(Cursor &c, FocuserRequest &request) {
+  request.hasSequence = true;
+  request.sequenceLength = 0;
+  while (!endOfValue(c)) {
+    int position = readInt(c);
+    if (position > 0 && request.sequenceLength < REQUEST_MAX_SEQUENCE) {
+      request.sequence[request.sequenceLength++] = position;
+    }
+    while (!endOfValue(c) && *c.p != ',') {
+      c.p++;
+    }
+    if (!endOfValue(c)) {
+      c.p++;
+    }
+  }
+}
+
+static void readQuery(Cursor &c, FocuserRequest &request) {
+  while (!c.atEnd()) {
+    if (*c.p == '&') {
+      c.p++;
+      c.skip("amp;");
+      continue;
+    }
+    const char* key = c.p;
+    while (!endOfValue(c) && *c.p != '=') {
+      c.p++;
+    }
+    uint8_t keyLength = c.p - key > 255 ? 255 : c.p - key;
+    if (endOfValue(c)) {
+      continue;
+    }
+    c.p++;
+    if (keyLength == 14 && memcmp(key, "alwaysApproach", 14) == 0) {
+      const char* value = c.p;
+      while (!endOfValue(c)) {
+        c.p++;
+      }
+      backlashStrategyFromText(value, c.p - value, request.alwaysApproach);
+      continue;
+    }
+    //an empty value leaves the argument absent, like a missing key
+    if (!endOfValue(c)) {
+      int* arg = intArg(key, keyLength, request);
+      if (arg) {
+        *arg = readInt(c);
+      } else if (keyLength == 8 && memcmp(key, "sequence", 8) == 0) {
+        readSequence(c, request);
+      }
+    }
+    while (!endOfValue(c)) {
+      c.p++;
+    }
+  }
+}
+
+void clearRequest(FocuserRequest &request) {
+  request.route = ROUTE_NOT_FOUND;
+  request.hasQuery = false;
+  request.speed = REQUEST_ARG_ABSENT;
+  request.absolutePosition = REQUEST_ARG_ABSENT;
+  request.backlashSteps = REQUEST_ARG_ABSENT;
+  request.maxSpeed = REQUEST_ARG_ABSENT;
+  request.acceleration = REQUEST_ARG_ABSENT;
+  request.syncPosition = REQUEST_ARG_ABSENT;
+  request.alwaysApproach = REQUEST_STRATEGY_ABSENT;
+  request.hasSequence = false;
+  request.sequenceLength = 0;
+}
+
+bool parseRequest(const char* data, uint16_t length, FocuserRequest &request) {
+  clearRequest(request);
+  Cursor c = { data, data + length };
+  if (!c.skip("GET ")) {
+    return false;
+  }
+  //Any path starting /focuser gets the status, as it always has
+  if (!c.skip("/focuser")) {
+    return true;
+  }
+  request.route = ROUTE_STATUS;
+  if (c.skip("/p")) {
+    if (c.atEnd()) {
+      request.route = ROUTE_COMPACT;
+    }
+  } else if (!c.atEnd() && *c.p == '?') {
+    c.p++;
+    request.hasQuery = true;
+    readQuery(c, request);
+  }
+  return true;
+}
@@ -0,0 +1,53 @@
+/**
+ * Single pass parser for the HTTP request line.
+ *
+ * The route and every query argument the focuser understands are picked out in one scan of the packet, straight into
+ * a FocuserRequest, without copying the request or allocating. Query arguments are separated by '&' or by the "&amp;"
+ * the Indi driver sends. Numbers are read the way atoi() reads them.
+ */
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include <stdint.h>
+
+//Most positions a sequence= argument can carry, further ones are ignored.
+const uint8_t REQUEST_MAX_SEQUENCE = 10;
+//Value of an integer argument that is missing from the query or has no value.
+const int REQUEST_ARG_ABSENT = -32768;
+//alwaysApproach when it is missing or names no strategy.
+const int8_t REQUEST_STRATEGY_ABSENT = -128;
+
+enum RequestRoute {
+  ROUTE_NOT_FOUND,
+  //GET /focuser, with or without a query
+  ROUTE_STATUS,
+  //GET /focuser/p, the compact status frame
+  ROUTE_COMPACT
+};
+
+struct FocuserRequest {
+  uint8_t route;
+  //true if the path was followed by a query, even an empty one
+  bool hasQuery;
+  int speed;
+  int absolutePosition;
+  int backlashSteps;
+  int maxSpeed;
+  int acceleration;
+  int syncPosition;
+  //alwaysApproach as a BacklashStrategy (see planner.h), which an empty value names too
+  int8_t alwaysApproach;
+  //sequence= positions in the order given, hasSequence is set even if the list was empty
+  bool hasSequence;
+  uint8_t sequenceLength;
+  int sequence[REQUEST_MAX_SEQUENCE];
+};
+
+//Reset request to no route and every argument absent.
+void clearRequest(FocuserRequest &request);
+
+//Parse the request starting at data, reading at most length bytes and stopping early at a NUL or the end of the line.
+//Returns false if it is not a GET request line, in which case route is ROUTE_NOT_FOUND.
+bool parseRequest(const char* data, uint16_t length, FocuserRequest &request);
+
+#endif
@@ -0,0 +1,43 @@
+#include "temperature.h"
+
+#include <math.h>
+
+//Readings this close to 0 or 1023 mean the thermistor is shorted or missing.
+const float READING_MARGIN = 8;
+
+int thermistorTenths(float reading) {
+  if (reading < READING_MARGIN || reading > 1023 - READING_MARGIN) {
+    return TEMPERATURE_NONE;
+  }
+  float ohms = THERMISTOR_SERIES_OHMS * reading / (1023 - reading);
+  float kelvin = 1 / (1 / (THERMISTOR_NOMINAL_C + 273.15f) + log(ohms / THERMISTOR_NOMINAL_OHMS) / THERMISTOR_BETA);
+  float tenths = (kelvin - 273.15f) * 10;
+  return tenths < 0 ? (int)(tenths - 0.5f) : (int)(tenths + 0.5f);
+}
+
+void formatTemperature(int tenths, char* out) {
+  if (tenths == TEMPERATURE_NONE) {
+    out[0] = 'n';
+    out[1] = 'u';
+    out[2] = 'l';
+    out[3] = 'l';
+    out[4] = '\0';
+    return;
+  }
+  char digits[6];
+  uint8_t count = 0;
+  unsigned value = tenths < 0 ? -tenths : tenths;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value || count < 2);
+  if (tenths < 0) {
+    *out++ = '-';
+  }
+  while (count > 1) {
+    *out++ = digits[--count];
+  }
+  *out++ = '.';
+  *out++ = digits[0];
+  *out = '\0';
+}
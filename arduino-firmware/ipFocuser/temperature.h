@@ -0,0 +1,29 @@
+/**
+ * Temperature from an NTC thermistor, for the driver's temperature compensation.
+ *
+ * The thermistor forms a divider with a fixed resistor: 5v -- series resistor -- analog pin -- thermistor -- GND.
+ * Readings are converted with the thermistor's beta equation and reported in the status as degrees C to one decimal.
+ */
+#ifndef TEMPERATURE_H
+#define TEMPERATURE_H
+
+#include <stdint.h>
+
+//10k at 25C, beta 3950, the common glass bead probe, with a 10k series resistor.
+const float THERMISTOR_NOMINAL_OHMS = 10000;
+const float THERMISTOR_NOMINAL_C = 25;
+const float THERMISTOR_BETA = 3950;
+const float THERMISTOR_SERIES_OHMS = 10000;
+//Tenths of a degree reported when no thermistor is connected.
+const int TEMPERATURE_NONE = -32768;
+//Longest text formatTemperature() writes, "-3276.7" and the NUL.
+const uint8_t TEMPERATURE_TEXT_SIZE = 8;
+
+//Tenths of a degree C for a 10 bit reading of the divider, averaged so it may have a fraction. TEMPERATURE_NONE if the
+//reading is at either end of the range, an open or shorted thermistor.
+int thermistorTenths(float reading);
+
+//Write tenths as a JSON value, e.g. "-3.5", or "null" for TEMPERATURE_NONE.
+void formatTemperature(int tenths, char* out);
+
+#endif
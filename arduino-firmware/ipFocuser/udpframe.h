@@ -0,0 +1,140 @@
+/**
+ * Datagrams of the UDP command and telemetry channel, a lighter alternative to HTTP for polls and small moves.
+ *
+ * Every datagram starts with a type byte and a 16 bit sequence number. A client numbers its commands and resends one
+ * until the reply carrying the same number arrives. Commands are absolute, and the focuser answers a repeated number
+ * with the reply it already sent, so a resent command never acts twice. Replies and telemetry carry the same status.
+ * While a client has sent a command in the last UDP_SUBSCRIPTION_MS the focuser also sends it telemetry, every
+ * UDP_TELEMETRY_MOVING_MS while moving, every UDP_TELEMETRY_IDLE_MS otherwise, and once more as soon as a move stops.
+ *
+ *   command:   type, seq (2)                                  UDP_STATUS
+ *              type, seq (2), target (2), backlashSteps (2)   UDP_MOVE, backlashSteps UDP_KEEP keeps the current setting
+ *              ... backlashStrategy                           UDP_MOVE with a BacklashStrategy (see planner.h), older
+ *                                                             firmware ignores it
+ *   status:    type, seq (2), absolutePosition (2), targetPosition (2), flags, speed (2), moveCount (2), sequenceStep
+ *
+ * Multi byte fields are little endian. A reply's type is the command's with UDP_REPLY set, telemetry is UDP_TELEMETRY
+ * with a sequence number of its own.
+ */
+#ifndef UDPFRAME_H
+#define UDPFRAME_H
+
+#include <stdint.h>
+
+const uint16_t UDP_FOCUSER_PORT = 4030;
+const uint16_t UDP_SUBSCRIPTION_MS = 30000;
+const uint16_t UDP_TELEMETRY_MOVING_MS = 100;
+const uint16_t UDP_TELEMETRY_IDLE_MS = 1000;
+
+const uint8_t UDP_STATUS = 0x01;
+const uint8_t UDP_MOVE = 0x02;
+const uint8_t UDP_TELEMETRY = 0x40;
+const uint8_t UDP_REPLY = 0x80;
+
+const uint8_t UDP_FLAG_MOVING = 0x01;
+const uint16_t UDP_KEEP = 0xFFFF;
+//backlashStrategy of a UDP_MOVE that keeps the current setting, and is sent without the byte.
+const int8_t UDP_KEEP_STRATEGY = 0x7F;
+
+const uint8_t UDP_COMMAND_SIZE = 3;
+const uint8_t UDP_MOVE_SIZE = 7;
+const uint8_t UDP_MOVE_STRATEGY_SIZE = 8;
+const uint8_t UDP_STATUS_SIZE = 13;
+
+struct UdpCommand {
+  uint8_t type;
+  uint16_t seq;
+  uint16_t target;
+  uint16_t backlashSteps;
+  int8_t backlashStrategy;
+};
+
+struct UdpStatus {
+  uint8_t type;
+  uint16_t seq;
+  uint16_t position;
+  uint16_t target;
+  uint8_t flags;
+  uint16_t speed;
+  uint16_t moveCount;
+  uint8_t sequenceStep;
+};
+
+inline void udpPut16(uint8_t* out, uint16_t value) {
+  out[0] = value & 0xFF;
+  out[1] = value >> 8;
+}
+
+inline uint16_t udpGet16(const uint8_t* in) {
+  return in[0] | (uint16_t)in[1] << 8;
+}
+
+//Returns the length of the datagram written to out, which needs UDP_MOVE_STRATEGY_SIZE bytes.
+inline uint8_t encodeUdpCommand(const UdpCommand &command, uint8_t* out) {
+  out[0] = command.type;
+  udpPut16(out + 1, command.seq);
+  if (command.type != UDP_MOVE) {
+    return UDP_COMMAND_SIZE;
+  }
+  udpPut16(out + 3, command.target);
+  udpPut16(out + 5, command.backlashSteps);
+  if (command.backlashStrategy == UDP_KEEP_STRATEGY) {
+    return UDP_MOVE_SIZE;
+  }
+  out[7] = (uint8_t) command.backlashStrategy;
+  return UDP_MOVE_STRATEGY_SIZE;
+}
+
+//Returns false for anything that is not a whole command of a known type.
+inline bool decodeUdpCommand(const uint8_t* in, uint16_t length, UdpCommand &command) {
+  if (length < UDP_COMMAND_SIZE) {
+    return false;
+  }
+  command.type = in[0];
+  command.seq = udpGet16(in + 1);
+  command.target = 0;
+  command.backlashSteps = UDP_KEEP;
+  command.backlashStrategy = UDP_KEEP_STRATEGY;
+  if (command.type == UDP_STATUS) {
+    return true;
+  }
+  if (command.type != UDP_MOVE || length < UDP_MOVE_SIZE) {
+    return false;
+  }
+  command.target = udpGet16(in + 3);
+  command.backlashSteps = udpGet16(in + 5);
+  if (length >= UDP_MOVE_STRATEGY_SIZE) {
+    command.backlashStrategy = (int8_t) in[7];
+  }
+  return true;
+}
+
+//Writes UDP_STATUS_SIZE bytes to out.
+inline uint8_t encodeUdpStatus(const UdpStatus &status, uint8_t* out) {
+  out[0] = status.type;
+  udpPut16(out + 1, status.seq);
+  udpPut16(out + 3, status.position);
+  udpPut16(out + 5, status.target);
+  out[7] = status.flags;
+  udpPut16(out + 8, status.speed);
+  udpPut16(out + 10, status.moveCount);
+  out[12] = status.sequenceStep;
+  return UDP_STATUS_SIZE;
+}
+
+inline bool decodeUdpStatus(const uint8_t* in, uint16_t length, UdpStatus &status) {
+  if (length < UDP_STATUS_SIZE || !(in[0] & (UDP_REPLY | UDP_TELEMETRY))) {
+    return false;
+  }
+  status.type = in[0];
+  status.seq = udpGet16(in + 1);
+  status.position = udpGet16(in + 3);
+  status.target = udpGet16(in + 5);
+  status.flags = in[7];
+  status.speed = udpGet16(in + 8);
+  status.moveCount = udpGet16(in + 10);
+  status.sequenceStep = in[12];
+  return true;
+}
+
+#endif
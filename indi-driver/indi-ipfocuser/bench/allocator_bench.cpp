@@ -0,0 +1,104 @@
+/*******************************************************************************
+  Steady state cost of parsing a device status response with gason: a fresh
+  JsonAllocator per response (how Handshake used to parse) against one
+  allocator over a member buffer that is reset() between responses.
+
+  malloc is counted by wrapping glibc's allocator, so the mallocs/parse column
+  shows whether the reused allocator really stays off the heap. It exits
+  non-zero if any parse after reset() called malloc, and runs as
+  allocator_test under ctest with fewer iterations.
+  Usage: allocator_bench [iterations]
+*******************************************************************************/
+#include "gason.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+
+static size_t mallocCount = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    mallocCount++;
+    return __libc_malloc(size);
+}
+#endif
+
+static const char response[] =
+    "{\"uptime\":\"05:14:12\", \"speed\": 112, \"temperature\": -3.25, \"temperatureCompensationOn\": false, "
+    "\"backlashSteps\": 200, \"absolutePosition\": 8000, \"maxPosition\": 100000, \"minPosition\": 10, "
+    "\"gearBoxMultiplier\": 10, \"moving\": false, \"targetPosition\": 8000, \"maxSpeed\": 280, \"acceleration\": 0}";
+
+static bool parse(JsonAllocator &allocator, char *buffer)
+{
+    memcpy(buffer, response, sizeof(response));
+    char *endptr;
+    JsonValue value;
+    return jsonParse(buffer, &endptr, &value, allocator) == JSON_OK && value.getTag() == JSON_OBJECT;
+}
+
+static void report(const char *label, double seconds, size_t mallocs, int iterations)
+{
+    printf("%-16s %7.1f ns/parse  %5.2f mallocs/parse\n", label, seconds * 1e9 / iterations,
+           (double)mallocs / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    char buffer[sizeof(response)];
+    bool ok = true;
+
+#ifndef __GLIBC__
+    printf("malloc counting needs glibc, mallocs/parse will read 0\n");
+#endif
+
+    size_t mallocs = mallocCount;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        JsonAllocator allocator;
+        ok &= parse(allocator, buffer);
+    }
+    report("fresh allocator", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+           mallocCount - mallocs, iterations);
+
+    char arena[1024];
+    JsonAllocator allocator(arena, sizeof(arena));
+    mallocs = mallocCount;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        allocator.reset();
+        ok &= parse(allocator, buffer);
+    }
+    size_t resetMallocs = mallocCount - mallocs;
+    report("buffer + reset", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+           resetMallocs, iterations);
+
+    // A buffer too small for the response: the first parse takes a zone from the heap, reset() keeps it
+    char small[64];
+    JsonAllocator spill(small, sizeof(small));
+    parse(spill, buffer);
+    mallocs = mallocCount;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        spill.reset();
+        ok &= parse(spill, buffer);
+    }
+    size_t spillMallocs = mallocCount - mallocs;
+    report("small + reset", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+           spillMallocs, iterations);
+
+    if (!ok)
+        fprintf(stderr, "a parse failed\n");
+    if (resetMallocs || spillMallocs)
+        fprintf(stderr, "parses after reset() called malloc %zu times\n", resetMallocs + spillMallocs);
+    return ok && !resetMallocs && !spillMallocs ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/*******************************************************************************
+  Latency benchmark for focuser status requests, comparing a fresh curl handle per
+  request (how the driver used to work) against one long lived handle with a share
+  object (how IpFocus works now).
+
+  Run the mock device first: python mock-focuser-device.py
+  Usage: curl_reuse_bench [url] [iterations]
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+
+static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    ((std::string*)userp)->append((char*)contents, size * nmemb);
+    return size * nmemb;
+}
+
+static void report(const char *label, std::vector<double> &samples)
+{
+    if (samples.empty())
+    {
+        printf("%-8s no successful requests\n", label);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double s : samples)
+        total += s;
+    printf("%-8s n=%zu mean=%.1fus p50=%.1fus p99=%.1fus\n", label, samples.size(), total / samples.size(),
+           samples[samples.size() / 2], samples[(samples.size() * 99) / 100]);
+}
+
+static bool perform(CURL *curl, const char *url, std::string &response)
+{
+    response.clear();
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    return curl_easy_perform(curl) == CURLE_OK;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *url = argc > 1 ? argv[1] : "http://localhost:8080/focuser";
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    std::string response;
+    std::vector<double> fresh, reused;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        CURL *curl = curl_easy_init();
+        bool ok = perform(curl, url, response);
+        curl_easy_cleanup(curl);
+        if (ok)
+            fresh.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    CURLSH *share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (perform(curl, url, response))
+            reused.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    curl_easy_cleanup(curl);
+    curl_share_cleanup(share);
+
+    printf("%s, %d requests each\n", url, iterations);
+    report("fresh", fresh);
+    report("reused", reused);
+
+    curl_global_cleanup();
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+  Throughput benchmark for gason jsonParse on multi-megabyte inputs: a pretty
+  printed state dump and a compact log of long message strings.
+
+  gason_bench uses the SIMD scanners picked at runtime, gason_bench_scalar is
+  the same program built with GASON_NO_SIMD. Compare the MB/s of the two.
+  Usage: gason_bench [megabytes] [iterations]
+*******************************************************************************/
+#include "gason.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static std::string stateDump(size_t bytes)
+{
+    std::string json = "[\n";
+    for (int i = 0; json.size() < bytes; i++)
+    {
+        if (i)
+            json += ",\n";
+        json += "    {\n"
+                "        \"uptime\": \"05:14:12\",\n"
+                "        \"speed\": 112,\n"
+                "        \"temperature\": -3.25,\n"
+                "        \"temperatureCompensationOn\": false,\n"
+                "        \"backlashSteps\": 200,\n"
+                "        \"absolutePosition\": " + std::to_string(8000 + i % 4000) + ",\n"
+                "        \"maxPosition\": 20000,\n"
+                "        \"minPosition\": 0,\n"
+                "        \"gearBoxMultiplier\": 10,\n"
+                "        \"moving\": true\n"
+                "    }";
+    }
+    return json + "\n]\n";
+}
+
+static std::string messageLog(size_t bytes)
+{
+    std::string json = "[";
+    for (int i = 0; json.size() < bytes; i++)
+    {
+        if (i)
+            json += ",";
+        json += "{\"t\":" + std::to_string(1500000000 + i) + ",\"level\":\"debug\",\"message\":\"Performing request "
+                "http://192.168.1.203:80/focuser?absolutePosition=" + std::to_string(i % 20000) +
+                "&backlashSteps=300&alwaysApproach=CCW, focuser replied with a \\\"moving\\\" status after a short wait\"}";
+    }
+    return json + "]";
+}
+
+static void run(const char *label, const std::string &input, int iterations)
+{
+    std::vector<char> buffer(input.size() + 1);
+    std::vector<double> seconds;
+    for (int i = 0; i < iterations; i++)
+    {
+        memcpy(buffer.data(), input.c_str(), input.size() + 1);
+        char *endptr;
+        JsonValue value;
+        JsonAllocator allocator;
+        auto start = std::chrono::steady_clock::now();
+        int status = jsonParse(buffer.data(), &endptr, &value, allocator);
+        seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        if (status != JSON_OK)
+        {
+            fprintf(stderr, "%s: %s at %zd\n", label, jsonStrError(status), endptr - buffer.data());
+            exit(1);
+        }
+    }
+    std::sort(seconds.begin(), seconds.end());
+    double megabytes = input.size() / (1024.0 * 1024.0);
+    printf("%-12s %6.1f MB  best %7.1f MB/s  median %7.1f MB/s\n", label, megabytes, megabytes / seconds.front(),
+           megabytes / seconds[seconds.size() / 2]);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 8;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+
+#ifdef GASON_NO_SIMD
+    printf("gason scanners: scalar\n");
+#else
+    printf("gason scanners: runtime selected\n");
+#endif
+    run("state dump", stateDump(megabytes << 20), iterations);
+    run("message log", messageLog(megabytes << 20), iterations);
+    return 0;
+}
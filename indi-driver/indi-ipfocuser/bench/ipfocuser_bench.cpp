@@ -0,0 +1,463 @@
+/*******************************************************************************
+  Benchmark suite for the driver hot paths:
+
+    - parsing real device status payloads with jsonParse, decodeFocuserStatus
+      and FocuserStatusStream
+    - building the move URL the way MoveAbsFocuser does
+    - recording a request into the statistics, timing it included
+    - status and move round trips through FocuserClient, as the driver makes
+      them, over CurlTransport and over SocketTransport, against a mock
+      device started in process (or a real device/mock given with --device)
+    - the same over UDP with UdpTransport, against the in process mock only
+
+  Every benchmark reports p50, p99, mean, min and max per operation, printed
+  as a table and written as JSON (default ipfocuser_bench.json) so runs from
+  different releases can be compared.
+
+  Usage: ipfocuser_bench [--output file.json] [--device http://host/focuser]
+                         [--round-trips n]
+*******************************************************************************/
+#include "curltransport.h"
+#include "focuserclient.h"
+#include "focuserstats.h"
+#include "focuserstatus.h"
+#include "focuserurl.h"
+#include "gason.h"
+#include "sockettransport.h"
+#include "udptransport.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Result
+{
+    std::string name;
+    size_t samples;
+    double p50, p99, mean, min, max;
+};
+
+static std::vector<Result> results;
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+static void record(const std::string &name, std::vector<double> samples)
+{
+    if (samples.empty())
+    {
+        printf("%-34s no samples\n", name.c_str());
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double sample : samples)
+        sum += sample;
+    Result result = {name, samples.size(), percentile(samples, 0.5), percentile(samples, 0.99), sum / samples.size(),
+                     samples.front(), samples.back()};
+    printf("%-34s p50 %10.1f  p99 %10.1f  mean %10.1f ns\n", name.c_str(), result.p50, result.p99, result.mean);
+    results.push_back(result);
+}
+
+/**
+ * Time batches of operations and record the per operation time of each batch, so that clock overhead
+ * does not swamp sub-microsecond operations.
+**/
+template <typename Operation>
+static void measure(const std::string &name, int batches, int batchSize, Operation operation)
+{
+    std::vector<double> samples;
+    for (int i = 0; i < batches / 10; i++)
+        operation();
+    for (int i = 0; i < batches; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < batchSize; n++)
+            operation();
+        samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / batchSize);
+    }
+    record(name, samples);
+}
+
+static bool writeJson(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return false;
+    fprintf(file, "{\n  \"unit\": \"ns\",\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"samples\": %zu, \"p50\": %.1f, \"p99\": %.1f, \"mean\": %.1f, \"min\": %.1f, \"max\": %.1f}%s\n",
+                r.name.c_str(), r.samples, r.p50, r.p99, r.mean, r.min, r.max, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+// Bodies exactly as the firmware emits them, idle and mid move, plus one with a temperature history appended.
+static const char IDLE_PAYLOAD[] =
+    "{\"uptime\":\"05:14:12\",\"speed\":100,\"temperature\":null,\"temperatureCompensationOn\":false,\"backlashSteps\":100,"
+    "\"absolutePosition\":10000,\"maxPosition\":20000,\"minPosition\":0,\"gearBoxMultiplier\":10,\"moving\":false,"
+    "\"targetPosition\":10000,\"maxSpeed\":280,\"acceleration\":0}";
+static const char MOVING_PAYLOAD[] =
+    "{\"uptime\":\"12:01:59\",\"speed\":280,\"temperature\":null,\"temperatureCompensationOn\":false,\"backlashSteps\":300,"
+    "\"absolutePosition\":13377,\"maxPosition\":20000,\"minPosition\":0,\"gearBoxMultiplier\":10,\"moving\":true,"
+    "\"targetPosition\":15000,\"maxSpeed\":560,\"acceleration\":2000}";
+
+// The compact frame served at /focuser/p for the same moving state.
+static const char COMPACT_PAYLOAD[] = "13377 15000 1 280 42 0";
+
+static std::string historyPayload()
+{
+    std::string json = MOVING_PAYLOAD;
+    json.pop_back();
+    json += ",\"temperatureHistory\":[";
+    for (int i = 0; i < 120; i++)
+        json += (i ? "," : "") + std::string("{\"t\":") + std::to_string(1500000000 + i * 60) + ",\"c\":" +
+                std::to_string(-3.25 + i * 0.01).substr(0, 5) + "}";
+    return json + "]}";
+}
+
+static void benchmarkParsers(const char *label, const std::string &payload)
+{
+    std::vector<char> buffer(payload.size() + 1);
+    char arena[16384];
+    JsonAllocator allocator(arena, sizeof(arena));
+    measure(std::string("jsonParse/") + label, 2000, 100, [&] {
+        memcpy(buffer.data(), payload.c_str(), payload.size() + 1);
+        char *endptr;
+        JsonValue value;
+        allocator.reset();
+        if (jsonParse(buffer.data(), &endptr, &value, allocator) != JSON_OK)
+            abort();
+    });
+
+    FocuserStatus status;
+    measure(std::string("decodeFocuserStatus/") + label, 2000, 100, [&] {
+        const char *endptr;
+        if (decodeFocuserStatus(payload.data(), payload.size(), &status, &endptr) != JSON_OK)
+            abort();
+    });
+
+    // Chunked the way a status response typically arrives over the device's small TCP window
+    FocuserStatusStream stream;
+    measure(std::string("FocuserStatusStream/") + label, 2000, 100, [&] {
+        stream.begin(&status);
+        for (size_t offset = 0; offset < payload.size(); offset += 512)
+            stream.feed(payload.data() + offset, std::min((size_t)512, payload.size() - offset));
+        if (stream.finish() != JSON_OK)
+            abort();
+    });
+}
+
+/**
+ * Minimal stand-in for the device: HTTP/1.0 with the connection closed after every response, like the firmware.
+ * A move reports moving for the next two status requests, then arrives. /focuser/p serves the compact frame.
+ * The UDP channel is served on the same port number, without telemetry.
+**/
+class MockDevice
+{
+public:
+    bool start()
+    {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (listener < 0 || bind(listener, (sockaddr *)&address, length) || listen(listener, 16) ||
+            getsockname(listener, (sockaddr *)&address, &length))
+            return false;
+        port = ntohs(address.sin_port);
+        udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (udpSocket < 0 || bind(udpSocket, (sockaddr *)&address, length))
+            return false;
+        thread = std::thread(&MockDevice::serve, this);
+        udpThread = std::thread(&MockDevice::serveUdp, this);
+        return true;
+    }
+
+    void stop()
+    {
+        running = false;
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        shutdown(udpSocket, SHUT_RDWR);
+        if (thread.joinable())
+            thread.join();
+        if (udpThread.joinable())
+            udpThread.join();
+        close(udpSocket);
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port) + "/focuser";
+    }
+
+    int udpPort() const
+    {
+        return port;
+    }
+
+private:
+    int listener = -1;
+    int port = 0;
+    std::atomic<bool> running{true};
+    std::thread thread;
+    int udpSocket = -1;
+    std::thread udpThread;
+    std::mutex stateMutex;
+    int position = 10000;
+    int target = 10000;
+    int pollsUntilArrived = 0;
+    int moves = 0;
+
+    void serve()
+    {
+        while (running)
+        {
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0)
+                break;
+            std::string request;
+            char buffer[1024];
+            ssize_t n;
+            while (request.find("\r\n\r\n") == std::string::npos && (n = recv(client, buffer, sizeof(buffer), 0)) > 0)
+                request.append(buffer, n);
+            std::string response = respond(request);
+            send(client, response.data(), response.size(), MSG_NOSIGNAL);
+            close(client);
+        }
+    }
+
+    void serveUdp()
+    {
+        uint8_t frame[64];
+        sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t n;
+        while (running && (n = recvfrom(udpSocket, frame, sizeof(frame), 0, (sockaddr *)&from, &fromLength)) > 0)
+        {
+            UdpCommand command;
+            if (!decodeUdpCommand(frame, n, command))
+                continue;
+            int shown;
+            bool moving = step(command.type == UDP_MOVE ? command.target : -1, shown);
+            UdpStatus status = {(uint8_t)(command.type | UDP_REPLY), command.seq, (uint16_t)shown, (uint16_t)target,
+                                (uint8_t)(moving ? UDP_FLAG_MOVING : 0), 100, (uint16_t)moves, 0};
+            sendto(udpSocket, frame, encodeUdpStatus(status, frame), 0, (sockaddr *)&from, fromLength);
+        }
+    }
+
+    // Start a move to newTarget, or count down a poll of the running move if newTarget is -1. Returns whether moving.
+    bool step(int newTarget, int &shown)
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (newTarget >= 0)
+        {
+            target = newTarget;
+            pollsUntilArrived = 2;
+            moves++;
+        }
+        else if (pollsUntilArrived > 0 && --pollsUntilArrived == 0)
+            position = target;
+        bool moving = position != target;
+        shown = moving ? position + (target - position) / (pollsUntilArrived + 1) : position;
+        return moving;
+    }
+
+    std::string respond(const std::string &request)
+    {
+        size_t query = request.find("absolutePosition=");
+        bool isMove = query != std::string::npos && query < request.find("\r\n");
+        int shown;
+        bool moving = step(isMove ? atoi(request.c_str() + query + strlen("absolutePosition=")) : -1, shown);
+        char body[512];
+        if (request.compare(0, 15, "GET /focuser/p ") == 0)
+        {
+            snprintf(body, sizeof(body), "HTTP/1.0 200 OK\r\n\r\n%d %d %d 100 %d 0", shown, target, moving ? 1 : 0, moves);
+            return body;
+        }
+        snprintf(body, sizeof(body),
+                 "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nPragma: no-cache\r\n\r\n"
+                 "{\"uptime\":\"05:14:12\",\"speed\":100,\"temperature\":null,\"temperatureCompensationOn\":false,"
+                 "\"backlashSteps\":100,\"absolutePosition\":%d,\"maxPosition\":20000,\"minPosition\":0,"
+                 "\"gearBoxMultiplier\":10,\"moving\":%s,\"targetPosition\":%d,\"maxSpeed\":280,\"acceleration\":0}",
+                 shown, moving ? "true" : "false", target);
+        return body;
+    }
+};
+
+/**
+ * Status requests, compact polls and moves through a FocuserClient on transport, recorded under
+ * roundtrip/<prefix>status, roundtrip/<prefix>status-compact and roundtrip/<prefix>move.
+**/
+static void benchmarkRoundTrips(const char *prefix, FocuserTransport &transport, const std::string &endpoint, int count)
+{
+    FocuserClient client(transport);
+    if (!client.setEndpoint(endpoint.c_str()))
+        return;
+    std::vector<double> statusSamples, compactSamples, moveSamples;
+    int failures = 0;
+    FocuserStatus status;
+    for (int i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (client.status(status, 10000))
+            statusSamples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        else
+            failures++;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (client.poll(status, 10000))
+            compactSamples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        else
+            failures++;
+    }
+
+    // A move as PerformMove runs it, minus the poll interval: the move request, then compact polls until it stops
+    for (int i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = client.move(9000 + (i % 2) * 2000, "100", "CCW", status, 10000);
+        for (int polls = 0; ok && status.has(FOCUSER_STATUS_moving) && status.moving && polls < 100; polls++)
+            ok = client.poll(status, 10000);
+        if (ok)
+            moveSamples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        else
+            failures++;
+    }
+
+    record(std::string("roundtrip/") + prefix + "status", statusSamples);
+    record(std::string("roundtrip/") + prefix + "status-compact", compactSamples);
+    record(std::string("roundtrip/") + prefix + "move", moveSamples);
+    if (failures)
+        printf("%d round trips failed over %s: %s\n", failures, prefix[0] ? "sockets" : "curl", client.error());
+}
+
+/**
+ * The same status polls and moves over UDP, as PerformMove runs them when the device answers there.
+**/
+static void benchmarkUdpRoundTrips(int port, int count)
+{
+    UdpTransport udp;
+    if (!udp.open("127.0.0.1", port))
+        return;
+    std::vector<double> statusSamples, moveSamples;
+    int failures = 0;
+    UdpStatus reply;
+    for (int i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (udp.request(UDP_STATUS, 0, UDP_KEEP, UDP_KEEP_STRATEGY, reply, 4))
+            statusSamples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        else
+            failures++;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = udp.request(UDP_MOVE, 9000 + (i % 2) * 2000, 100, UDP_KEEP_STRATEGY, reply, 4);
+        for (int polls = 0; ok && (reply.flags & UDP_FLAG_MOVING) && polls < 100; polls++)
+            ok = udp.request(UDP_STATUS, 0, UDP_KEEP, UDP_KEEP_STRATEGY, reply, 4);
+        if (ok)
+            moveSamples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        else
+            failures++;
+    }
+
+    record("roundtrip/udp-status", statusSamples);
+    record("roundtrip/udp-move", moveSamples);
+    if (failures)
+        printf("%d UDP round trips failed\n", failures);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output = "ipfocuser_bench.json";
+    std::string device;
+    int roundTrips = 500;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--output"))
+            output = argv[i + 1];
+        else if (!strcmp(argv[i], "--device"))
+            device = argv[i + 1];
+        else if (!strcmp(argv[i], "--round-trips"))
+            roundTrips = atoi(argv[i + 1]);
+    }
+
+    benchmarkParsers("idle", IDLE_PAYLOAD);
+    benchmarkParsers("moving", MOVING_PAYLOAD);
+    benchmarkParsers("history", historyPayload());
+
+    FocuserStatus compactStatus;
+    measure("decodeCompactStatus/moving", 2000, 100, [&] {
+        const char *endptr;
+        if (decodeCompactStatus(COMPACT_PAYLOAD, sizeof(COMPACT_PAYLOAD) - 1, &compactStatus, &endptr) != JSON_OK)
+            abort();
+    });
+
+    uint32_t ticks = 0;
+    FocuserUrl url;
+    measure("buildMoveUrl", 2000, 100, [&] {
+        if (!buildMoveUrl(url, "http://192.168.1.203:80/focuser", 10000 + (ticks++ & 1023), "100", "CCW"))
+            abort();
+    });
+
+    // What the driver adds to every request to keep its statistics
+    FocuserStats stats;
+    measure("FocuserStats/request", 2000, 100, [&] {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        stats.count(COUNTER_REQUESTS);
+        stats.httpRequest.record(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    });
+
+    MockDevice mock;
+    if (device.empty())
+    {
+        if (!mock.start())
+        {
+            fprintf(stderr, "could not start the mock device\n");
+            return 1;
+        }
+        device = mock.url();
+    }
+    {
+        CurlTransport curl;
+        SocketTransport sockets;
+        benchmarkRoundTrips("", curl, device, roundTrips);
+        benchmarkRoundTrips("socket-", sockets, device, roundTrips);
+    }
+    if (device == mock.url())
+        benchmarkUdpRoundTrips(mock.udpPort(), roundTrips);
+    mock.stop();
+
+    if (!writeJson(output))
+    {
+        fprintf(stderr, "could not write %s\n", output);
+        return 1;
+    }
+    printf("results written to %s\n", output);
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*******************************************************************************
+  Scaling benchmark for one driver process running many focusers, against
+  the mock focuser farm.
+
+  For 1, 2, 4 ... N focusers, one thread per focuser polls its status as
+  fast as it answers, the way the I/O workers of IpFocus do while moving, for
+  --seconds each. It is done twice: with every request on the shared
+  CurlMulti, as the driver does, and with each thread blocking in its own
+  curl_easy_perform, as N single focuser processes would. Aggregate requests
+  a second, p50 and p99 latency and failures are printed for each.
+
+  Then the largest run is repeated with a faulty peer next to the healthy
+  focusers: one focuser that accepts connections but never answers (a local
+  listener, so it hangs on every request until its timeout) and, with
+  --power-port, the farm's first focuser being power cycled throughout. The
+  healthy focusers' latency should not move.
+
+  Start the farm first: mock-focuser-farm --focusers 32 --port 8080
+  Usage: multi_focuser_bench [--port FIRST] [--focusers N] [--seconds S]
+                             [--power-port P]
+*******************************************************************************/
+#include "curlmulti.h"
+#include "focuserstats.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+
+// The driver's timeout for a status request while moving is in the seconds, the hung peer's is kept short to hit it often.
+#define REQUEST_TIMEOUT_MS 2000
+#define HUNG_TIMEOUT_MS 500
+// The power cycled focuser is polled like the driver probes a booting device.
+#define PROBE_TIMEOUT_MS 1000
+#define POWER_CYCLE_MS 1000
+
+typedef std::chrono::steady_clock Clock;
+
+struct Run
+{
+    LatencyHistogram latency;
+    std::atomic<unsigned long> failures;
+
+    Run() : failures(0)
+    {
+    }
+};
+
+static size_t DiscardCallback(char *, size_t size, size_t nmemb, void *)
+{
+    return size * nmemb;
+}
+
+static CURL *newHandle(const std::string &url, long timeoutMs)
+{
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardCallback);
+    return curl;
+}
+
+// Poll url until the deadline, recording into run when given.
+static void pollFocuser(CurlMulti *multi, std::string url, long timeoutMs, Clock::time_point deadline, Run *run)
+{
+    CURL *curl = newHandle(url, timeoutMs);
+    while (Clock::now() < deadline)
+    {
+        Clock::time_point start = Clock::now();
+        CURLcode result = multi ? multi->perform(curl) : curl_easy_perform(curl);
+        if (!run)
+            continue;
+        if (result == CURLE_OK)
+            run->latency.record(std::chrono::duration<double>(Clock::now() - start).count());
+        else
+            run->failures++;
+    }
+    curl_easy_cleanup(curl);
+}
+
+static void powerCycle(std::string url, Clock::time_point deadline)
+{
+    CURL *curl = newHandle("", REQUEST_TIMEOUT_MS);
+    for (bool on = false; Clock::now() < deadline; on = !on)
+    {
+        curl_easy_setopt(curl, CURLOPT_URL, (url + (on ? "/on" : "/off")).c_str());
+        curl_easy_perform(curl);
+        std::this_thread::sleep_for(std::chrono::milliseconds(POWER_CYCLE_MS));
+    }
+    // Leave it on for the next run
+    curl_easy_setopt(curl, CURLOPT_URL, (url + "/on").c_str());
+    curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+}
+
+// A device that accepts connections and never answers. Returns its port, the listening socket in fd.
+static int openHungDevice(int &fd)
+{
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd < 0 || bind(fd, (sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 64) != 0 ||
+        getsockname(fd, (sockaddr *)&address, &length) != 0)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+static std::string focuserUrl(int port)
+{
+    return "http://127.0.0.1:" + std::to_string(port) + "/focuser";
+}
+
+/**
+ * Poll focusers farm focusers, from firstHealthy on, for seconds. A hung peer is polled too when hungPort is
+ * set, and the farm's first focuser power cycled when powerPort is.
+**/
+static void runFocusers(CurlMulti *multi, int port, int firstHealthy, int focusers, double seconds, int hungPort,
+                        int powerPort, Run &run)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::microseconds((long long)(seconds * 1e6));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < focusers; i++)
+        threads.push_back(std::thread(pollFocuser, multi, focuserUrl(port + firstHealthy + i), REQUEST_TIMEOUT_MS,
+                                      deadline, &run));
+    if (hungPort)
+        threads.push_back(std::thread(pollFocuser, multi, focuserUrl(hungPort), HUNG_TIMEOUT_MS, deadline, (Run *)NULL));
+    if (powerPort)
+    {
+        threads.push_back(std::thread(pollFocuser, multi, focuserUrl(port), PROBE_TIMEOUT_MS, deadline, (Run *)NULL));
+        threads.push_back(std::thread(powerCycle, "http://127.0.0.1:" + std::to_string(powerPort) + "/power/0",
+                                      deadline));
+    }
+    for (auto &thread : threads)
+        thread.join();
+}
+
+static void report(const char *mode, int focusers, double seconds, Run &run)
+{
+    printf("%-8s %9d %12.0f %9.2f %9.2f %9lu\n", mode, focusers, run.latency.count() / seconds,
+           run.latency.percentile(0.5) * 1e3, run.latency.percentile(0.99) * 1e3, run.failures.load());
+}
+
+int main(int argc, char *argv[])
+{
+    int port = 8080, maxFocusers = 16, powerPort = 0;
+    double seconds = 2;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--port"))
+            port = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--focusers"))
+            maxFocusers = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--seconds"))
+            seconds = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--power-port"))
+            powerPort = atoi(argv[i + 1]);
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    CurlMulti multi;
+
+    printf("%-8s %9s %12s %9s %9s %9s\n", "mode", "focusers", "requests/s", "p50 ms", "p99 ms", "failures");
+    for (int focusers = 1; focusers <= maxFocusers; focusers *= 2)
+    {
+        Run shared, separate;
+        runFocusers(&multi, port, 0, focusers, seconds, 0, 0, shared);
+        report("multi", focusers, seconds, shared);
+        runFocusers(NULL, port, 0, focusers, seconds, 0, 0, separate);
+        report("easy", focusers, seconds, separate);
+    }
+
+    // The power cycled focuser is the farm's first, so the healthy ones start after it
+    int healthyFrom = powerPort ? 1 : 0;
+    int healthy = maxFocusers - healthyFrom;
+    int hungFd;
+    int hungPort = openHungDevice(hungFd);
+    if (!hungPort || healthy < 1)
+    {
+        fprintf(stderr, "cannot set up the faulty peer\n");
+        return 1;
+    }
+    printf("\nhealthy focusers next to a hung one%s:\n", powerPort ? " and one being power cycled" : "");
+    Run quiet, faulty;
+    runFocusers(&multi, port, healthyFrom, healthy, seconds, 0, 0, quiet);
+    report("alone", healthy, seconds, quiet);
+    runFocusers(&multi, port, healthyFrom, healthy, seconds, hungPort, powerPort, faulty);
+    report("faulty", healthy, seconds, faulty);
+
+    close(hungFd);
+    curl_global_cleanup();
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*******************************************************************************
+  Throughput and accuracy benchmark for JSON number parsing: the original gason
+  string2double, jsonParseNumber and the C library strtod, on integers like
+  absolutePosition, short fractions like temperature and full 17 digit doubles.
+
+  The mismatch column counts results that differ from strtod in any bit.
+  Usage: number_bench [count] [iterations]
+*******************************************************************************/
+#include "jsonnumber.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// gason's string2double before jsonParseNumber, kept here as the baseline
+static double legacyString2double(const char *s, const char **endptr)
+{
+    char ch = *s;
+    if (ch == '-')
+        ++s;
+
+    double result = 0;
+    while (isdigit(*s))
+        result = (result * 10) + (*s++ - '0');
+
+    if (*s == '.')
+    {
+        ++s;
+        double fraction = 1;
+        while (isdigit(*s))
+        {
+            fraction *= 0.1;
+            result += (*s++ - '0') * fraction;
+        }
+    }
+
+    if (*s == 'e' || *s == 'E')
+    {
+        ++s;
+        double base = 10;
+        if (*s == '+')
+            ++s;
+        else if (*s == '-')
+        {
+            ++s;
+            base = 0.1;
+        }
+        unsigned int exponent = 0;
+        while (isdigit(*s))
+            exponent = (exponent * 10) + (*s++ - '0');
+        double power = 1;
+        for (; exponent; exponent >>= 1, base *= base)
+            if (exponent & 1)
+                power *= base;
+        result *= power;
+    }
+
+    *endptr = s;
+    return ch == '-' ? -result : result;
+}
+
+static double parseLegacy(const char *s, const char **endptr)
+{
+    return legacyString2double(s, endptr);
+}
+
+static double parseNew(const char *s, const char **endptr)
+{
+    return jsonParseNumber(s, nullptr, endptr);
+}
+
+static double parseStrtod(const char *s, const char **endptr)
+{
+    return strtod(s, (char **)endptr);
+}
+
+// All numbers of a data set in one buffer, separated by commas like a JSON array
+static std::string dataSet(int kind, size_t count)
+{
+    std::mt19937_64 random(kind + 1);
+    std::string text;
+    char buffer[64];
+    for (size_t i = 0; i < count; i++)
+    {
+        switch (kind)
+        {
+        case 0:
+            snprintf(buffer, sizeof(buffer), "%d", (int)(random() % 40000));
+            break;
+        case 1:
+            snprintf(buffer, sizeof(buffer), "%.2f", (int)(random() % 8000 - 4000) / 100.0);
+            break;
+        default:
+            snprintf(buffer, sizeof(buffer), "%.17g", (random() >> 11) / 9007199254740992.0 * 1000);
+            break;
+        }
+        text += buffer;
+        text += ',';
+    }
+    return text;
+}
+
+static void run(const char *label, double (*parse)(const char *, const char **), const std::string &input,
+                size_t count, int iterations)
+{
+    std::vector<double> seconds;
+    size_t mismatches = 0;
+    double sum = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        const char *s = input.c_str();
+        for (size_t n = 0; n < count; n++)
+        {
+            sum += parse(s, &s);
+            ++s;
+        }
+        seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    const char *s = input.c_str();
+    for (size_t n = 0; n < count; n++)
+    {
+        const char *stop;
+        double value = parse(s, &stop);
+        double reference = strtod(s, nullptr);
+        if (memcmp(&value, &reference, sizeof(value)))
+            mismatches++;
+        s = stop + 1;
+    }
+
+    std::sort(seconds.begin(), seconds.end());
+    printf("  %-14s %8.1f Mnum/s  %7.1f MB/s  mismatches %zu  checksum %g\n", label, count / seconds.front() / 1e6,
+           input.size() / seconds.front() / (1024.0 * 1024.0), mismatches, sum);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+    const char *names[] = {"integers", "temperatures", "17 digits"};
+
+    for (int kind = 0; kind < 3; kind++)
+    {
+        std::string input = dataSet(kind, count);
+        printf("%s\n", names[kind]);
+        run("string2double", parseLegacy, input, count, iterations);
+        run("jsonParseNumber", parseNew, input, count, iterations);
+        run("strtod", parseStrtod, input, count, iterations);
+    }
+    return 0;
+}
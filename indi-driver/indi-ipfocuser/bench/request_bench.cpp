@@ -0,0 +1,167 @@
+/*******************************************************************************
+  Benchmark for the firmware's request parsing: the single pass parseRequest
+  against what loop() did before it, an Arduino String copy of the packet and
+  one EtherCard findKeyVal rescan per query argument.
+
+  Both run on the host over the requests the driver sends, and the mismatch
+  count at the end, requests where the two disagree on the route or any
+  argument, should be 0; the exit status is 1 if it is not.
+  Usage: request_bench [iterations]
+*******************************************************************************/
+#include "request.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static const char *REQUESTS[] = {
+    "GET /focuser HTTP/1.1\r\nHost: 192.168.1.203\r\nAccept: */*\r\n\r\n",
+    "GET /focuser/p HTTP/1.1\r\nHost: 192.168.1.203\r\nAccept: */*\r\n\r\n",
+    "GET /focuser?absolutePosition=13377&amp;backlashSteps=100&amp;alwaysApproach=true HTTP/1.1\r\nHost: "
+    "192.168.1.203\r\nAccept: */*\r\n\r\n",
+    "GET /focuser?sequence=9000,9100,9200,9300,9400,9500,9600&amp;backlashSteps=100 HTTP/1.1\r\nHost: "
+    "192.168.1.203\r\nAccept: */*\r\n\r\n",
+    "GET /focuser?acceleration=2000&maxSpeed=560&speed=560 HTTP/1.1\r\nHost: 192.168.1.203\r\nAccept: */*\r\n\r\n",
+};
+
+// EtherCard's findKeyVal, as the firmware called it with a 30 byte value buffer
+static uint8_t findKeyVal(const char *str, char *strbuf, uint8_t maxlen, const char *key)
+{
+    uint8_t found = 0;
+    uint8_t i = 0;
+    const char *kp = key;
+    while (*str && *str != ' ' && *str != '\n' && found == 0)
+    {
+        if (*str == *kp)
+        {
+            kp++;
+            if (*kp == '\0')
+            {
+                str++;
+                kp = key;
+                if (*str == '=')
+                    found = 1;
+            }
+        }
+        else
+            kp = key;
+        str++;
+    }
+    if (found == 1)
+    {
+        while (*str && *str != ' ' && *str != '\n' && *str != '&' && i < maxlen - 1)
+        {
+            *strbuf = *str;
+            i++;
+            str++;
+            strbuf++;
+        }
+        *strbuf = '\0';
+    }
+    return i;
+}
+
+static int getIntArg(const char *data, const char *key)
+{
+    char temp[30];
+    if (findKeyVal(data + 7, temp, sizeof temp, key) > 0)
+        return atoi(temp);
+    return REQUEST_ARG_ABSENT;
+}
+
+// The parsing loop() and interpretCommandFromQueryString() used to do, results in a FocuserRequest to compare
+static void legacyParse(const char *packet, FocuserRequest &request)
+{
+    // new String(data) on the device
+    std::string copy(packet);
+    const char *data = copy.c_str();
+    memset(&request, 0, sizeof(request));
+    request.route = copy.compare(0, 15, "GET /focuser/p ") == 0 ? ROUTE_COMPACT
+                    : copy.compare(0, 12, "GET /focuser") == 0  ? ROUTE_STATUS
+                                                                : ROUTE_NOT_FOUND;
+    request.hasQuery = request.route == ROUTE_STATUS && data[12] == '?';
+    request.speed = request.absolutePosition = request.backlashSteps = REQUEST_ARG_ABSENT;
+    request.maxSpeed = request.acceleration = request.syncPosition = REQUEST_ARG_ABSENT;
+    if (!request.hasQuery)
+        return;
+    request.speed = getIntArg(data, "speed");
+    request.absolutePosition = getIntArg(data, "absolutePosition");
+    request.backlashSteps = getIntArg(data, "backlashSteps");
+    request.maxSpeed = getIntArg(data, "maxSpeed");
+    request.acceleration = getIntArg(data, "acceleration");
+    request.syncPosition = getIntArg(data, "syncPosition");
+    char list[64];
+    if (findKeyVal(data + 7, list, sizeof list, "sequence") > 0)
+    {
+        request.hasSequence = true;
+        for (const char *p = list; *p && request.sequenceLength < REQUEST_MAX_SEQUENCE;)
+        {
+            int position = atoi(p);
+            if (position > 0)
+                request.sequence[request.sequenceLength++] = position;
+            while (*p && *p != ',')
+                p++;
+            if (*p == ',')
+                p++;
+        }
+    }
+}
+
+static void newParse(const char *packet, FocuserRequest &request)
+{
+    parseRequest(packet, strlen(packet), request);
+}
+
+static bool sameArgs(const FocuserRequest &a, const FocuserRequest &b)
+{
+    return a.route == b.route && a.hasQuery == b.hasQuery && a.speed == b.speed &&
+           a.absolutePosition == b.absolutePosition && a.backlashSteps == b.backlashSteps && a.maxSpeed == b.maxSpeed &&
+           a.acceleration == b.acceleration && a.syncPosition == b.syncPosition &&
+           a.sequenceLength == b.sequenceLength &&
+           std::equal(a.sequence, a.sequence + a.sequenceLength, b.sequence);
+}
+
+static void run(const char *label, void (*parse)(const char *, FocuserRequest &), int iterations)
+{
+    const size_t count = sizeof(REQUESTS) / sizeof(REQUESTS[0]);
+    std::vector<double> seconds;
+    long checksum = 0;
+    FocuserRequest request;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < 100000; n++)
+        {
+            parse(REQUESTS[n % count], request);
+            checksum += request.absolutePosition + request.sequenceLength;
+        }
+        seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::sort(seconds.begin(), seconds.end());
+    printf("  %-14s %8.1f ns/request  checksum %ld\n", label, seconds.front() / 100000 * 1e9, checksum);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+    run("findKeyVal", legacyParse, iterations);
+    run("parseRequest", newParse, iterations);
+
+    size_t mismatches = 0;
+    for (size_t n = 0; n < sizeof(REQUESTS) / sizeof(REQUESTS[0]); n++)
+    {
+        FocuserRequest legacy, parsed;
+        legacyParse(REQUESTS[n], legacy);
+        newParse(REQUESTS[n], parsed);
+        if (!sameArgs(legacy, parsed))
+            mismatches++;
+    }
+    printf("mismatches %zu\n", mismatches);
+    return mismatches ? 1 : 0;
+}
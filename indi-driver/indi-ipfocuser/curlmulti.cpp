@@ -0,0 +1,136 @@
+/*******************************************************************************
+  Shared curl multi handle. See curlmulti.h.
+*******************************************************************************/
+#include "curlmulti.h"
+
+#include <algorithm>
+
+// Longest the thread sleeps in curl_multi_poll, curl wakes it sooner for its own timeouts and for new transfers.
+#define POLL_MS 1000
+
+CurlMulti::CurlMulti() : waiting(0), exiting(false)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    multi = curl_multi_init();
+    thread = std::thread(&CurlMulti::run, this);
+}
+
+CurlMulti::~CurlMulti()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        finished.notify_all();
+    }
+    curl_multi_wakeup(multi);
+    thread.join();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return waiting == 0; });
+    }
+    curl_multi_cleanup(multi);
+    curl_global_cleanup();
+}
+
+CURLcode CurlMulti::perform(CURL *easy)
+{
+    Transfer transfer = {easy, CURLE_OK, false};
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, &transfer);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (exiting)
+        return CURLE_ABORTED_BY_CALLBACK;
+    pending.push_back(&transfer);
+    curl_multi_wakeup(multi);
+    waiting++;
+    finished.wait(lock, [this, &transfer] {
+        // Once exiting, a transfer not yet added is taken back here, one the thread added is aborted by it
+        if (exiting && !transfer.done)
+        {
+            std::vector<Transfer *>::iterator queued = std::find(pending.begin(), pending.end(), &transfer);
+            if (queued != pending.end())
+            {
+                pending.erase(queued);
+                transfer.result = CURLE_ABORTED_BY_CALLBACK;
+                transfer.done = true;
+            }
+        }
+        return transfer.done;
+    });
+    if (--waiting == 0 && exiting)
+        finished.notify_all();
+    return transfer.result;
+}
+
+/**
+ * On the way out, take every transfer off the multi handle and wake its thread with CURLE_ABORTED_BY_CALLBACK, so
+ * nothing is left blocked in perform or in the multi handle when it is cleaned up.
+**/
+void CurlMulti::abortTransfers()
+{
+    for (size_t i = 0; i < inFlight.size(); i++)
+        curl_multi_remove_handle(multi, inFlight[i]->easy);
+    std::lock_guard<std::mutex> lock(mutex);
+    inFlight.insert(inFlight.end(), pending.begin(), pending.end());
+    pending.clear();
+    for (size_t i = 0; i < inFlight.size(); i++)
+    {
+        inFlight[i]->result = CURLE_ABORTED_BY_CALLBACK;
+        inFlight[i]->done = true;
+    }
+    inFlight.clear();
+    finished.notify_all();
+}
+
+/**
+ * Add new transfers, let curl make progress on all of them, hand back the finished ones, and sleep until there is
+ * more to do.
+**/
+void CurlMulti::run()
+{
+    std::vector<Transfer *> adding;
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (exiting)
+                break;
+            adding.swap(pending);
+        }
+        for (size_t i = 0; i < adding.size(); i++)
+        {
+            CURLMcode code = curl_multi_add_handle(multi, adding[i]->easy);
+            if (code != CURLM_OK)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                adding[i]->result = CURLE_FAILED_INIT;
+                adding[i]->done = true;
+                finished.notify_all();
+            }
+            else
+                inFlight.push_back(adding[i]);
+        }
+        adding.clear();
+
+        int running;
+        curl_multi_perform(multi, &running);
+        CURLMsg *message;
+        int queued;
+        while ((message = curl_multi_info_read(multi, &queued)))
+        {
+            if (message->msg != CURLMSG_DONE)
+                continue;
+            CURL *easy = message->easy_handle;
+            CURLcode result = message->data.result;
+            Transfer *transfer;
+            curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&transfer);
+            curl_multi_remove_handle(multi, easy);
+            inFlight.erase(std::find(inFlight.begin(), inFlight.end(), transfer));
+            std::lock_guard<std::mutex> lock(mutex);
+            transfer->result = result;
+            transfer->done = true;
+            finished.notify_all();
+        }
+        curl_multi_poll(multi, NULL, 0, POLL_MS, NULL);
+    }
+    abortTransfers();
+}
@@ -0,0 +1,55 @@
+/*******************************************************************************
+  One curl multi handle for every focuser the driver runs.
+
+  Each device's I/O worker keeps its own easy handle and its blocking,
+  step by step logic, but hands every transfer to the shared multi handle,
+  which a single thread drives. Transfers from different devices run side by
+  side, so a device that hangs until its timeout, or is being power cycled,
+  holds up only its own worker. Handles added to one multi handle share its
+  DNS and connection caches.
+*******************************************************************************/
+
+#ifndef CURLMULTI_H
+#define CURLMULTI_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+
+class CurlMulti
+{
+public:
+    CurlMulti();
+    ~CurlMulti();
+
+    // Run the transfer set up on easy, blocking the calling thread until it completes, like curl_easy_perform.
+    // Returns CURLE_ABORTED_BY_CALLBACK if the multi handle is destroyed first.
+    CURLcode perform(CURL *easy);
+
+private:
+    struct Transfer
+    {
+        CURL *easy;
+        CURLcode result;
+        bool done;
+    };
+
+    CURLM *multi;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable finished;
+    // Transfers waiting to be added to the multi handle, which only its thread touches.
+    std::vector<Transfer *> pending;
+    // Transfers added to the multi handle and not finished, only touched by its thread.
+    std::vector<Transfer *> inFlight;
+    // Threads blocked in perform, which the destructor waits out before the mutex goes.
+    int waiting;
+    bool exiting;
+
+    void run();
+    void abortTransfers();
+};
+
+#endif
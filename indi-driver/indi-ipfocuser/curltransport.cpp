@@ -0,0 +1,60 @@
+/*******************************************************************************
+  FocuserTransport on libcurl. See curltransport.h.
+*******************************************************************************/
+#include "curltransport.h"
+#include "curlmulti.h"
+
+#include <string.h>
+
+struct SinkTarget
+{
+    BodySink sink;
+    void *context;
+};
+
+static size_t SinkWriteCallback(char *contents, size_t size, size_t nmemb, void *userp)
+{
+    SinkTarget *target = (SinkTarget *)userp;
+    if (target->sink)
+        target->sink(contents, size * nmemb, target->context);
+    return size * nmemb;
+}
+
+CurlTransport::CurlTransport(CurlMulti *multi) : multi(multi)
+{
+    errorText[0] = '\0';
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    curl = curl_easy_init();
+    if (curl)
+    {
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, SinkWriteCallback);
+    }
+}
+
+CurlTransport::~CurlTransport()
+{
+    if (curl)
+        curl_easy_cleanup(curl);
+    curl_global_cleanup();
+}
+
+TransportResult CurlTransport::get(const char *url, long timeoutMs, BodySink sink, void *context)
+{
+    if (!curl)
+    {
+        strcpy(errorText, "curl could not be initialised");
+        return TRANSPORT_FAILED;
+    }
+    SinkTarget target = {sink, context};
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &target);
+    CURLcode res = multi ? multi->perform(curl) : curl_easy_perform(curl);
+    if (res == CURLE_OK)
+        return TRANSPORT_OK;
+    strncpy(errorText, curl_easy_strerror(res), sizeof(errorText) - 1);
+    errorText[sizeof(errorText) - 1] = '\0';
+    return res == CURLE_OPERATION_TIMEDOUT ? TRANSPORT_TIMEOUT : TRANSPORT_FAILED;
+}
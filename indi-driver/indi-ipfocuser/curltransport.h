@@ -0,0 +1,39 @@
+/*******************************************************************************
+  FocuserTransport on one long lived curl easy handle, which keeps its
+  connection and DNS caches between requests.
+
+  Given a CurlMulti the transfers run on it, side by side with those of
+  other transports sharing it, and only the calling thread waits. Otherwise
+  they run on the calling thread with curl_easy_perform.
+*******************************************************************************/
+
+#ifndef CURLTRANSPORT_H
+#define CURLTRANSPORT_H
+
+#include "focusertransport.h"
+
+#include <curl/curl.h>
+
+class CurlMulti;
+
+class CurlTransport : public FocuserTransport
+{
+public:
+    explicit CurlTransport(CurlMulti *multi = NULL);
+    ~CurlTransport();
+
+    TransportResult get(const char *url, long timeoutMs, BodySink sink, void *context) override;
+    const char *error() const override {
+        return errorText;
+    }
+
+private:
+    CURL *curl;
+    CurlMulti *multi;
+    char errorText[CURL_ERROR_SIZE];
+
+    CurlTransport(const CurlTransport &);
+    CurlTransport &operator=(const CurlTransport &);
+};
+
+#endif
@@ -0,0 +1,138 @@
+/*******************************************************************************
+  Focuser device HTTP API client. See focuserclient.h.
+*******************************************************************************/
+#include "focuserclient.h"
+#include "gason.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char POLL_PATH[] = "/p";
+
+FocuserClient::FocuserClient(FocuserTransport &transport)
+    : transport(transport), pollLength(0), pollIsJson(false), lastResult(TRANSPORT_OK)
+{
+    errorText[0] = '\0';
+}
+
+bool FocuserClient::setEndpoint(const char *endpoint)
+{
+    endpointUrl.clear();
+    endpointUrl.append(endpoint);
+    pollUrl.clear();
+    pollUrl.append(endpoint).append(POLL_PATH, sizeof(POLL_PATH) - 1);
+    // A move sequence must still fit after it
+    if (!pollUrl.ok() || endpointUrl.size() > FOCUSER_URL_CAPACITY / 2)
+    {
+        snprintf(errorText, sizeof(errorText), "Endpoint is too long: %.64s...", endpoint);
+        return false;
+    }
+    return true;
+}
+
+void FocuserClient::StatusSink(const char *data, size_t length, void *context)
+{
+    ((FocuserStatusStream *)context)->feed(data, length);
+}
+
+void FocuserClient::PollSink(const char *data, size_t length, void *context)
+{
+    FocuserClient *client = (FocuserClient *)context;
+    if (client->pollLength == 0 && !client->pollIsJson && length > 0 && data[0] == '{')
+        client->pollIsJson = true;
+    if (client->pollIsJson)
+    {
+        client->stream.feed(data, length);
+        return;
+    }
+    // Anything longer is not a compact frame, keeping one byte too many makes sure it fails to decode
+    size_t room = sizeof(client->pollBody) - client->pollLength;
+    size_t n = length < room ? length : room;
+    memcpy(client->pollBody + client->pollLength, data, n);
+    client->pollLength += n;
+}
+
+bool FocuserClient::perform(const char *url, long timeoutMs, BodySink sink, void *context)
+{
+    lastResult = transport.get(url, timeoutMs, sink, context);
+    if (lastResult == TRANSPORT_OK)
+        return true;
+    snprintf(errorText, sizeof(errorText), "%s", transport.error());
+    return false;
+}
+
+/**
+ * Check that a status response streamed in completely and decoded.
+**/
+bool FocuserClient::finishStatus()
+{
+    int result = stream.finish();
+    if (result != JSON_OK)
+    {
+        snprintf(errorText, sizeof(errorText), "%s at %zu", jsonStrError(result), stream.offset());
+        return false;
+    }
+    return true;
+}
+
+bool FocuserClient::request(const FocuserUrl &url, FocuserStatus &status, long timeoutMs)
+{
+    if (!url.ok())
+    {
+        snprintf(errorText, sizeof(errorText), "Request is too long: %.64s...", url.c_str());
+        lastResult = TRANSPORT_OK;
+        return false;
+    }
+    stream.begin(&status);
+    return perform(url.c_str(), timeoutMs, StatusSink, &stream) && finishStatus();
+}
+
+bool FocuserClient::status(FocuserStatus &status, long timeoutMs)
+{
+    stream.begin(&status);
+    return perform(endpointUrl.c_str(), timeoutMs, StatusSink, &stream) && finishStatus();
+}
+
+bool FocuserClient::poll(FocuserStatus &status, long timeoutMs)
+{
+    pollLength = 0;
+    pollIsJson = false;
+    stream.begin(&status);
+    if (!perform(pollUrl.c_str(), timeoutMs, PollSink, this))
+        return false;
+    if (pollIsJson)
+        return finishStatus();
+    const char *endptr;
+    int result = decodeCompactStatus(pollBody, pollLength, &status, &endptr);
+    if (result != JSON_OK)
+    {
+        snprintf(errorText, sizeof(errorText), "%s at %zd", jsonStrError(result), endptr - pollBody);
+        return false;
+    }
+    return true;
+}
+
+bool FocuserClient::move(uint32_t target, const char *backlashSteps, const char *approach, FocuserStatus &status,
+                         long timeoutMs)
+{
+    buildMoveUrl(url, endpointUrl.c_str(), target, backlashSteps, approach);
+    return request(url, status, timeoutMs);
+}
+
+bool FocuserClient::loadSequence(const uint32_t *targets, size_t count, const char *backlashSteps, FocuserStatus &status,
+                                 long timeoutMs)
+{
+    buildSequenceUrl(url, endpointUrl.c_str(), targets, count, backlashSteps);
+    return request(url, status, timeoutMs);
+}
+
+bool FocuserClient::sync(uint32_t position, long timeoutMs)
+{
+    buildSyncUrl(url, endpointUrl.c_str(), position);
+    return perform(url.c_str(), timeoutMs, NULL, NULL);
+}
+
+bool FocuserClient::get(const char *url, long timeoutMs)
+{
+    return perform(url, timeoutMs, NULL, NULL);
+}
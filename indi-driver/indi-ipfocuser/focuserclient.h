@@ -0,0 +1,84 @@
+/*******************************************************************************
+  Client for one focuser device's HTTP API, without INDI.
+
+  Requests are built in place and responses decoded into a FocuserStatus as
+  they arrive, so a request allocates nothing beyond what the transport
+  does. Any FocuserTransport will do: CurlTransport, SocketTransport, or
+  either wrapped in a RecordingTransport. Calls block until the device has
+  answered or timeoutMs has passed, and return false if it did not answer or
+  the answer does not decode, error() then saying why.
+
+  A client is used from one thread at a time, give each focuser its own.
+*******************************************************************************/
+
+#ifndef FOCUSERCLIENT_H
+#define FOCUSERCLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "focuserstatus.h"
+#include "focusertransport.h"
+#include "focuserurl.h"
+
+// Longest compact status frame kept, "absolutePosition targetPosition moving speed moveCount sequenceStep".
+#define COMPACT_STATUS_CAPACITY 80
+
+class FocuserClient
+{
+public:
+    explicit FocuserClient(FocuserTransport &transport);
+
+    // The device's API, e.g. "http://192.168.1.203:80/focuser". Returns false if it is too long to build requests on.
+    bool setEndpoint(const char *endpoint);
+    const char *endpoint() const {
+        return endpointUrl.c_str();
+    }
+
+    // The full status.
+    bool status(FocuserStatus &status, long timeoutMs);
+    // The compact status the device serves for following a move, only the fields decodeCompactStatus sets.
+    bool poll(FocuserStatus &status, long timeoutMs);
+    // Start a move to target. The device answers at once with its full status, it moves in the background.
+    // backlashSteps and approach are sent as given, NULL leaves the device's setting alone.
+    bool move(uint32_t target, const char *backlashSteps, const char *approach, FocuserStatus &status, long timeoutMs);
+    // Load targets as a move sequence and start the move to the first. Moves to later targets continue it.
+    bool loadSequence(const uint32_t *targets, size_t count, const char *backlashSteps, FocuserStatus &status,
+                      long timeoutMs);
+    // Tell the device it is at position, without moving.
+    bool sync(uint32_t position, long timeoutMs);
+    // Send a request built elsewhere, e.g. with buildMoveUrl, and decode the full status it answers with.
+    bool request(const FocuserUrl &url, FocuserStatus &status, long timeoutMs);
+    // GET any URL, such as a power switch's, discarding the response.
+    bool get(const char *url, long timeoutMs);
+
+    // Why the last call that returned false failed.
+    const char *error() const {
+        return errorText;
+    }
+    // How the transport ended the last request. TRANSPORT_OK if the device answered, even if the answer was no good.
+    TransportResult transportResult() const {
+        return lastResult;
+    }
+
+private:
+    FocuserTransport &transport;
+    FocuserUrl endpointUrl;
+    FocuserUrl pollUrl;
+    FocuserUrl url;
+    FocuserStatusStream stream;
+    // A compact frame as it arrives. A response starting with '{', from firmware without the compact endpoint, is
+    // decoded by stream instead.
+    char pollBody[COMPACT_STATUS_CAPACITY];
+    size_t pollLength;
+    bool pollIsJson;
+    char errorText[160];
+    TransportResult lastResult;
+
+    bool perform(const char *url, long timeoutMs, BodySink sink, void *context);
+    bool finishStatus();
+    static void StatusSink(const char *data, size_t length, void *context);
+    static void PollSink(const char *data, size_t length, void *context);
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*******************************************************************************
+  Runtime statistics for the driver. See focuserstats.h.
+*******************************************************************************/
+#include "focuserstats.h"
+
+#include <time.h>
+
+// Bucket i >= 8 holds [(4 + i % 4) << (i / 4 - 2), (5 + i % 4) << (i / 4 - 2)) microseconds, below 4 us each has its own.
+static int bucketIndex(uint64_t us)
+{
+    if (us < 4)
+        return us;
+    int exponent = 63 - __builtin_clzll(us);
+    int index = exponent * 4 + ((us >> (exponent - 2)) & 3);
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+static uint64_t bucketUpperEdge(int index)
+{
+    if (index < 4)
+        return index + 1;
+    int exponent = index / 4;
+    return (uint64_t)(5 + index % 4) << (exponent - 2);
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(double seconds)
+{
+    uint64_t us = seconds > 0 ? (uint64_t)(seconds * 1e6) : 0;
+    buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t seen = maxMicroseconds.load(std::memory_order_relaxed);
+    while (us > seen && !maxMicroseconds.compare_exchange_weak(seen, us, std::memory_order_relaxed));
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        buckets[i].store(0, std::memory_order_relaxed);
+    maxMicroseconds.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        total += buckets[i].load(std::memory_order_relaxed);
+    return total;
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+    uint32_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        total += counts[i] = buckets[i].load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+    // The sample of rank ceil(p * total), counting from 1
+    uint64_t rank = (uint64_t)(p * total + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            // The top bucket is open ended, and no percentile is above the largest sample
+            double edge = i == HISTOGRAM_BUCKETS - 1 ? max() : bucketUpperEdge(i) / 1e6;
+            return edge < max() ? edge : max();
+        }
+    }
+    return max();
+}
+
+double LatencyHistogram::max() const
+{
+    return maxMicroseconds.load(std::memory_order_relaxed) / 1e6;
+}
+
+FocuserStats::FocuserStats()
+{
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        counters[i].store(0, std::memory_order_relaxed);
+}
+
+void FocuserStats::reset()
+{
+    httpRequest.reset();
+    udpRequest.reset();
+    move.reset();
+    handshake.reset();
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        counters[i].store(0, std::memory_order_relaxed);
+}
+
+static void writeHistogram(FILE *fp, const char *name, const LatencyHistogram &histogram)
+{
+    fprintf(fp, "\"%s\":{\"count\":%llu,\"p50\":%.6f,\"p90\":%.6f,\"p99\":%.6f,\"max\":%.6f},", name,
+            (unsigned long long)histogram.count(), histogram.percentile(0.5), histogram.percentile(0.9),
+            histogram.percentile(0.99), histogram.max());
+}
+
+bool FocuserStats::writeJson(FILE *fp) const
+{
+    fprintf(fp, "{\"time\":%lld,", (long long)time(NULL));
+    writeHistogram(fp, "httpRequest", httpRequest);
+    writeHistogram(fp, "udpRequest", udpRequest);
+    writeHistogram(fp, "move", move);
+    writeHistogram(fp, "handshake", handshake);
+    fprintf(fp, "\"counters\":{");
+    static const char *names[] = {
+#define XX(name, label) #name,
+        FOCUSER_COUNTERS(XX)
+#undef XX
+    };
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        fprintf(fp, "%s\"%s\":%u", i ? "," : "", names[i], get((FocuserCounter)i));
+    fprintf(fp, "}}\n");
+    return !ferror(fp);
+}
@@ -0,0 +1,81 @@
+/*******************************************************************************
+  Runtime statistics for the driver: latency histograms and event counters.
+
+  Recording is a relaxed atomic increment or two, so any thread can record
+  without locks and the statistics can stay on in production. Readers see
+  each value as of some recent moment, which is all a statistics display
+  needs.
+
+  Histograms bucket durations logarithmically, four buckets per power of two
+  from 1 us up, so a percentile is reported as the upper edge of its bucket:
+  never low, and at most 25% high.
+*******************************************************************************/
+
+#ifndef FOCUSERSTATS_H
+#define FOCUSERSTATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+
+#define HISTOGRAM_BUCKETS 160
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(double seconds);
+    void reset();
+
+    uint64_t count() const;
+    // Seconds, 0 while empty. p from 0 to 1.
+    double percentile(double p) const;
+    double max() const;
+
+private:
+    std::atomic<uint32_t> buckets[HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> maxMicroseconds;
+};
+
+// XX(name, label)
+#define FOCUSER_COUNTERS(XX)                                   \
+    XX(REQUESTS, "Requests")                                   \
+    XX(REQUEST_FAILURES, "Failed requests")                    \
+    XX(TIMEOUTS, "Timeouts")                                   \
+    XX(RETRIES, "Retries")                                     \
+    XX(UDP_FALLBACKS, "UDP fallbacks to HTTP")                 \
+    XX(MOVE_TIMEOUTS, "Moves timed out")                       \
+    XX(POWER_CYCLES, "Power cycles")                           \
+    XX(RECOVERY_FAILURES, "Failed recoveries")
+
+enum FocuserCounter {
+#define XX(name, label) COUNTER_##name,
+    FOCUSER_COUNTERS(XX)
+#undef XX
+    COUNTER_COUNT
+};
+
+struct FocuserStats
+{
+    LatencyHistogram httpRequest;
+    LatencyHistogram udpRequest;
+    LatencyHistogram move;
+    LatencyHistogram handshake;
+    std::atomic<uint32_t> counters[COUNTER_COUNT];
+
+    FocuserStats();
+
+    void count(FocuserCounter counter, uint32_t n = 1) {
+        counters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+    uint32_t get(FocuserCounter counter) const {
+        return counters[counter].load(std::memory_order_relaxed);
+    }
+    void reset();
+    // Append the statistics as one line of JSON, stamped with the wall clock time.
+    bool writeJson(FILE *fp) const;
+};
+
+#endif
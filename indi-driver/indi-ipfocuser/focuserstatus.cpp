@@ -0,0 +1,559 @@
+/*******************************************************************************
+  Schema-driven decoder for the focuser device status JSON. See focuserstatus.h.
+*******************************************************************************/
+#include "focuserstatus.h"
+#include "gason.h"
+#include "jsonnumber.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+enum FieldType {
+    FIELD_INT,
+    FIELD_NUMBER,
+    FIELD_BOOL,
+    FIELD_UPTIME
+};
+
+struct FieldDescriptor {
+    const char *key;
+    size_t keyLength;
+    FieldType type;
+    size_t offset;
+};
+
+const FieldDescriptor fields[] = {
+#define XX(key, type) {#key, sizeof(#key) - 1, FIELD_##type, offsetof(FocuserStatus, key)},
+    FOCUSER_STATUS_SCHEMA(XX)
+#undef XX
+};
+
+/*
+ * Perfect hash: FNV-1a over the key with a seed chosen so that no two schema keys share a slot.
+ * If adding a field trips the static_assert below, bump the seed until it passes.
+ */
+#define STATUS_HASH_SEED 7u
+#define STATUS_HASH_BITS 6
+#define STATUS_HASH_SLOTS (1 << STATUS_HASH_BITS)
+
+constexpr uint32_t hashStep(uint32_t hash, char c) {
+    return (hash ^ (uint8_t)c) * 16777619u;
+}
+
+constexpr uint32_t hashKey(const char *key, uint32_t hash = 2166136261u + STATUS_HASH_SEED) {
+    return *key ? hashKey(key + 1, hashStep(hash, *key)) : hash;
+}
+
+constexpr uint32_t hashSlot(uint32_t hash) {
+    return hash >> (32 - STATUS_HASH_BITS);
+}
+
+constexpr const char *schemaKeys[] = {
+#define XX(key, type) #key,
+    FOCUSER_STATUS_SCHEMA(XX)
+#undef XX
+};
+
+constexpr bool slotIsUnique(int field, int other = 0) {
+    return other == FOCUSER_STATUS_FIELD_COUNT ||
+           ((other == field || hashSlot(hashKey(schemaKeys[other])) != hashSlot(hashKey(schemaKeys[field]))) && slotIsUnique(field, other + 1));
+}
+
+constexpr bool schemaHashIsPerfect(int field = 0) {
+    return field == FOCUSER_STATUS_FIELD_COUNT || (slotIsUnique(field) && schemaHashIsPerfect(field + 1));
+}
+
+static_assert(schemaHashIsPerfect(), "focuser status keys collide in the perfect hash, change STATUS_HASH_SEED");
+
+constexpr int8_t fieldForSlot(uint32_t slot, int field = 0) {
+    return field == FOCUSER_STATUS_FIELD_COUNT ? -1 : hashSlot(hashKey(schemaKeys[field])) == slot ? field : fieldForSlot(slot, field + 1);
+}
+
+#define SLOT4(n) fieldForSlot(n), fieldForSlot(n + 1), fieldForSlot(n + 2), fieldForSlot(n + 3)
+#define SLOT16(n) SLOT4(n), SLOT4(n + 4), SLOT4(n + 8), SLOT4(n + 12)
+const int8_t slotTable[STATUS_HASH_SLOTS] = {SLOT16(0), SLOT16(16), SLOT16(32), SLOT16(48)};
+#undef SLOT16
+#undef SLOT4
+
+int lookupField(uint32_t hash, const char *key, size_t length) {
+    int candidate = slotTable[hashSlot(hash)];
+    if (candidate >= 0 && fields[candidate].keyLength == length && !memcmp(fields[candidate].key, key, length))
+        return candidate;
+    return -1;
+}
+
+inline bool isspace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool isdigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool isdelim(char c) {
+    return c == ',' || c == '}' || c == ']' || isspace(c);
+}
+
+class Decoder {
+public:
+    Decoder(const char *json, size_t length, FocuserStatus *status) : s(json), end(json + length), status(status) {}
+
+    int decode(const char **endptr);
+    int readValue(int field);
+
+private:
+    const char *s;
+    const char *end;
+    FocuserStatus *status;
+
+    void skipSpace() {
+        while (s < end && isspace(*s))
+            ++s;
+    }
+    bool consume(char c) {
+        skipSpace();
+        if (s < end && *s == c) {
+            ++s;
+            return true;
+        }
+        return false;
+    }
+    bool literal(const char *word, size_t length) {
+        if ((size_t)(end - s) < length || memcmp(s, word, length))
+            return false;
+        s += length;
+        return s == end || isdelim(*s);
+    }
+
+    int readKey(int *field);
+    int skipString(const char **start, const char **stop);
+    int readNumber(double *number, bool *integral);
+    int skipContainer();
+    void store(int field, double number, bool integral);
+    void storeBool(int field, bool value);
+    void storeUptime(int field, const char *start, const char *stop);
+};
+
+int Decoder::decode(const char **endptr) {
+    int result = JSON_OK;
+    if (!consume('{'))
+        result = JSON_UNEXPECTED_CHARACTER;
+    else if (!consume('}')) {
+        do {
+            int field;
+            if ((result = readKey(&field)) != JSON_OK)
+                break;
+            if (!consume(':')) {
+                result = JSON_UNEXPECTED_CHARACTER;
+                break;
+            }
+            skipSpace();
+            if ((result = readValue(field)) != JSON_OK)
+                break;
+        } while (consume(','));
+        if (result == JSON_OK && !consume('}'))
+            result = JSON_UNEXPECTED_CHARACTER;
+    }
+    *endptr = s;
+    return result;
+}
+
+/**
+ * Read a quoted key, hashing it as it goes, and resolve it to a schema field or -1.
+**/
+int Decoder::readKey(int *field) {
+    *field = -1;
+    if (!consume('"'))
+        return JSON_UNQUOTED_KEY;
+    const char *start = s;
+    uint32_t hash = 2166136261u + STATUS_HASH_SEED;
+    while (s < end && *s != '"' && *s != '\\')
+        hash = hashStep(hash, *s++);
+    if (s < end && *s == '\\') {
+        // Schema keys are plain identifiers, an escaped key can only be one we don't know.
+        s = start - 1;
+        return skipString(&start, &start);
+    }
+    if (s == end)
+        return JSON_BAD_STRING;
+    size_t length = s++ - start;
+    *field = lookupField(hash, start, length);
+    return JSON_OK;
+}
+
+int Decoder::readValue(int field) {
+    if (s == end)
+        return JSON_BREAKING_BAD;
+    switch (*s) {
+    case '"': {
+        const char *start, *stop;
+        int result = skipString(&start, &stop);
+        if (result == JSON_OK && field >= 0 && fields[field].type == FIELD_UPTIME)
+            storeUptime(field, start, stop);
+        return result;
+    }
+    case 't':
+        if (!literal("true", 4))
+            return JSON_BAD_IDENTIFIER;
+        storeBool(field, true);
+        return JSON_OK;
+    case 'f':
+        if (!literal("false", 5))
+            return JSON_BAD_IDENTIFIER;
+        storeBool(field, false);
+        return JSON_OK;
+    case 'n':
+        if (!literal("null", 4))
+            return JSON_BAD_IDENTIFIER;
+        if (field >= 0 && fields[field].type == FIELD_NUMBER)
+            store(field, NAN, false);
+        return JSON_OK;
+    case '{':
+    case '[':
+        return skipContainer();
+    default: {
+        double number;
+        bool integral;
+        int result = readNumber(&number, &integral);
+        if (result == JSON_OK)
+            store(field, number, integral);
+        return result;
+    }
+    }
+}
+
+/**
+ * Step over a quoted string, s must be at the opening quote. start and stop bound the raw contents.
+**/
+int Decoder::skipString(const char **start, const char **stop) {
+    *start = ++s;
+    while (s < end && *s != '"') {
+        if (*s == '\\' && ++s == end)
+            break;
+        ++s;
+    }
+    if (s == end)
+        return JSON_BAD_STRING;
+    *stop = s++;
+    return JSON_OK;
+}
+
+/**
+ * Integers, which is nearly everything the device sends, come back exact; fractions such as the
+ * temperature are rounded correctly by jsonParseNumber without copying the token.
+**/
+int Decoder::readNumber(double *number, bool *integral) {
+    const char *stop;
+    *number = jsonParseNumber(s, end, &stop);
+    if (stop == s || (stop < end && !isdelim(*stop)))
+        return JSON_BAD_NUMBER;
+    *integral = true;
+    for (const char *p = s; p < stop; ++p)
+        if (*p == '.' || *p == 'e' || *p == 'E')
+            *integral = false;
+    s = stop;
+    return JSON_OK;
+}
+
+/**
+ * Skip a nested object or array belonging to a key we don't use.
+**/
+int Decoder::skipContainer() {
+    int depth = 0;
+    while (s < end) {
+        switch (*s) {
+        case '"': {
+            const char *start, *stop;
+            int result = skipString(&start, &stop);
+            if (result != JSON_OK)
+                return result;
+            continue;
+        }
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0) {
+                ++s;
+                return JSON_OK;
+            }
+            break;
+        }
+        ++s;
+    }
+    return JSON_MISMATCH_BRACKET;
+}
+
+void Decoder::store(int field, double number, bool integral) {
+    if (field < 0)
+        return;
+    char *target = (char *)status + fields[field].offset;
+    switch (fields[field].type) {
+    case FIELD_INT:
+        if (!integral || number < INT32_MIN || number > INT32_MAX)
+            return;
+        *(int32_t *)target = (int32_t)number;
+        break;
+    case FIELD_NUMBER:
+        *(double *)target = number;
+        break;
+    default:
+        return;
+    }
+    status->present |= 1u << field;
+}
+
+void Decoder::storeBool(int field, bool value) {
+    if (field < 0 || fields[field].type != FIELD_BOOL)
+        return;
+    *(bool *)((char *)status + fields[field].offset) = value;
+    status->present |= 1u << field;
+}
+
+void Decoder::storeUptime(int field, const char *start, const char *stop) {
+    uint32_t seconds = 0;
+    uint32_t part = 0;
+    for (const char *p = start; p < stop; ++p) {
+        if (isdigit(*p))
+            part = part * 10 + (*p - '0');
+        else if (*p == ':') {
+            seconds = (seconds + part) * 60;
+            part = 0;
+        } else
+            return;
+    }
+    *(uint32_t *)((char *)status + fields[field].offset) = seconds + part;
+    status->present |= 1u << field;
+}
+
+} // namespace
+
+int decodeFocuserStatus(const char *json, size_t length, FocuserStatus *status, const char **endptr) {
+    status->present = 0;
+    Decoder decoder(json, length, status);
+    return decoder.decode(endptr);
+}
+
+int decodeCompactStatus(const char *frame, size_t length, FocuserStatus *status, const char **endptr) {
+    static const FocuserStatusField order[] = {
+        FOCUSER_STATUS_absolutePosition, FOCUSER_STATUS_targetPosition, FOCUSER_STATUS_moving,
+        FOCUSER_STATUS_speed, FOCUSER_STATUS_moveCount, FOCUSER_STATUS_sequenceStep
+    };
+    const char *s = frame;
+    const char *end = frame + length;
+    while (s < end && isspace(*s))
+        ++s;
+    if (s < end && *s == '{')
+        return decodeFocuserStatus(s, end - s, status, endptr);
+
+    status->present = 0;
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        if (i && (s == end || *s++ != ' ')) {
+            *endptr = s;
+            return JSON_BAD_NUMBER;
+        }
+        bool negative = s < end && *s == '-';
+        const char *digits = s + negative;
+        // Ten digits fit in 64 bits whatever they are, the range is checked once they are read, as for JSON
+        int64_t value = 0;
+        for (s = digits; s < end && isdigit(*s) && s - digits < 10; ++s)
+            value = value * 10 + (*s - '0');
+        if (negative)
+            value = -value;
+        if (s == digits || (s < end && isdigit(*s)) || value < INT32_MIN || value > INT32_MAX) {
+            *endptr = digits;
+            return JSON_BAD_NUMBER;
+        }
+        FocuserStatusField field = order[i];
+        if (field == FOCUSER_STATUS_moving)
+            status->moving = value != 0;
+        else
+            *(int32_t *)((char *)status + fields[field].offset) = (int32_t)value;
+        status->present |= 1u << field;
+    }
+    while (s < end && isspace(*s))
+        ++s;
+    *endptr = s;
+    return s == end ? JSON_OK : JSON_BAD_NUMBER;
+}
+
+void FocuserStatusStream::begin(FocuserStatus *target) {
+    status = target;
+    status->present = 0;
+    state = EXPECT_OBJECT;
+    error = JSON_OK;
+    consumed = 0;
+    field = -1;
+    depth = 0;
+    tokenLength = 0;
+    tokenOverflow = false;
+}
+
+int FocuserStatusStream::feed(const char *data, size_t length) {
+    if (state == DONE || state == FAILED)
+        return error;
+    for (const char *s = data; s < data + length; ++s) {
+        char c = *s;
+        switch (state) {
+        case EXPECT_OBJECT:
+            if (c == '{')
+                state = EXPECT_FIRST_KEY;
+            else if (!isspace(c))
+                fail(JSON_UNEXPECTED_CHARACTER);
+            break;
+        case EXPECT_FIRST_KEY:
+        case EXPECT_KEY:
+            if (c == '"') {
+                tokenLength = 0;
+                tokenOverflow = false;
+                state = IN_KEY;
+            } else if (c == '}' && state == EXPECT_FIRST_KEY)
+                state = DONE;
+            else if (!isspace(c))
+                fail(JSON_UNQUOTED_KEY);
+            break;
+        case IN_KEY:
+            if (c == '"') {
+                endKey();
+                state = EXPECT_COLON;
+            } else if (c == '\\') {
+                // Schema keys are plain identifiers, an escaped key can only be one we don't know.
+                tokenOverflow = true;
+                state = IN_KEY_ESCAPE;
+            } else
+                append(c);
+            break;
+        case IN_KEY_ESCAPE:
+            state = IN_KEY;
+            break;
+        case EXPECT_COLON:
+            if (c == ':')
+                state = EXPECT_VALUE;
+            else if (!isspace(c))
+                fail(JSON_UNEXPECTED_CHARACTER);
+            break;
+        case EXPECT_VALUE:
+            if (isspace(c))
+                break;
+            tokenLength = 0;
+            tokenOverflow = false;
+            if (c == '{' || c == '[') {
+                depth = 1;
+                state = IN_CONTAINER;
+            } else {
+                append(c);
+                state = c == '"' ? IN_STRING : IN_SCALAR;
+            }
+            break;
+        case IN_STRING:
+            append(c);
+            if (c == '"')
+                endValue();
+            else if (c == '\\')
+                state = IN_STRING_ESCAPE;
+            break;
+        case IN_STRING_ESCAPE:
+            append(c);
+            state = IN_STRING;
+            break;
+        case IN_SCALAR:
+            if (!isdelim(c)) {
+                append(c);
+                break;
+            }
+            endValue();
+            // The delimiter that ended the value belongs to the object
+            if (state == EXPECT_COMMA)
+                expectComma(c);
+            break;
+        case IN_CONTAINER:
+            if (c == '"')
+                state = IN_CONTAINER_STRING;
+            else if (c == '{' || c == '[')
+                ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0)
+                state = EXPECT_COMMA;
+            break;
+        case IN_CONTAINER_STRING:
+            if (c == '"')
+                state = IN_CONTAINER;
+            else if (c == '\\')
+                state = IN_CONTAINER_ESCAPE;
+            break;
+        case IN_CONTAINER_ESCAPE:
+            state = IN_CONTAINER_STRING;
+            break;
+        case EXPECT_COMMA:
+            expectComma(c);
+            break;
+        case DONE:
+        case FAILED:
+            break;
+        }
+        if (state == DONE || state == FAILED) {
+            // Anything after the closing brace is ignored, like decodeFocuserStatus does
+            consumed += s - data + (state == DONE);
+            return error;
+        }
+    }
+    consumed += length;
+    return error;
+}
+
+int FocuserStatusStream::finish() {
+    if (state != DONE && state != FAILED)
+        fail(JSON_BREAKING_BAD);
+    return error;
+}
+
+void FocuserStatusStream::fail(int code) {
+    error = code;
+    state = FAILED;
+}
+
+void FocuserStatusStream::expectComma(char c) {
+    if (c == ',')
+        state = EXPECT_KEY;
+    else if (c == '}')
+        state = DONE;
+    else if (!isspace(c))
+        fail(JSON_UNEXPECTED_CHARACTER);
+}
+
+void FocuserStatusStream::append(char c) {
+    if (tokenLength < sizeof(token))
+        token[tokenLength++] = c;
+    else
+        tokenOverflow = true;
+}
+
+void FocuserStatusStream::endKey() {
+    field = -1;
+    if (tokenOverflow)
+        return;
+    uint32_t hash = 2166136261u + STATUS_HASH_SEED;
+    for (size_t i = 0; i < tokenLength; i++)
+        hash = hashStep(hash, token[i]);
+    field = lookupField(hash, token, tokenLength);
+}
+
+/**
+ * A complete value is in token: decode it exactly as decodeFocuserStatus would.
+ * Only strings can be longer than the token buffer, and only ones we are skipping anyway.
+**/
+void FocuserStatusStream::endValue() {
+    state = EXPECT_COMMA;
+    if (tokenOverflow) {
+        if (token[0] != '"')
+            fail(JSON_BAD_NUMBER);
+        return;
+    }
+    Decoder decoder(token, tokenLength, status);
+    int result = decoder.readValue(field);
+    if (result != JSON_OK)
+        fail(result);
+}
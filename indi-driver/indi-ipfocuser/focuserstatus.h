@@ -0,0 +1,141 @@
+/*******************************************************************************
+  Typed view of the focuser device status JSON.
+
+  The schema below is the single list of fields the driver understands. The
+  decoder scans a response in place and stores each known field straight into
+  a FocuserStatus, dispatching keys through a perfect hash that is checked for
+  collisions at compile time. No DOM is built and nothing is copied.
+
+  FocuserStatusStream does the same for a response that arrives in pieces,
+  such as the chunks handed to a curl write callback.
+
+  decodeCompactStatus reads the short frame the device serves for polling
+  while it moves, into the same FocuserStatus.
+*******************************************************************************/
+
+#ifndef FOCUSERSTATUS_H
+#define FOCUSERSTATUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XX(key, type). Types: INT (int32_t), NUMBER (double, null allowed), BOOL, UPTIME ("hh:mm:ss" as seconds).
+#define FOCUSER_STATUS_SCHEMA(XX)            \
+    XX(uptime, UPTIME)                       \
+    XX(speed, INT)                           \
+    XX(temperature, NUMBER)                  \
+    XX(temperatureCompensationOn, BOOL)      \
+    XX(backlashSteps, INT)                   \
+    XX(absolutePosition, INT)                \
+    XX(maxPosition, INT)                     \
+    XX(minPosition, INT)                     \
+    XX(gearBoxMultiplier, INT)               \
+    XX(moving, BOOL)                         \
+    XX(targetPosition, INT)                  \
+    XX(maxSpeed, INT)                        \
+    XX(acceleration, INT)                    \
+    XX(sequenceStep, INT)                    \
+    XX(sequenceLength, INT)                  \
+    XX(moveCount, INT)                       \
+    XX(bootCount, INT)                       \
+    XX(positionRestored, BOOL)
+
+#define FOCUSER_STATUS_CTYPE_INT int32_t
+#define FOCUSER_STATUS_CTYPE_NUMBER double
+#define FOCUSER_STATUS_CTYPE_BOOL bool
+#define FOCUSER_STATUS_CTYPE_UPTIME uint32_t
+
+enum FocuserStatusField {
+#define XX(key, type) FOCUSER_STATUS_##key,
+    FOCUSER_STATUS_SCHEMA(XX)
+#undef XX
+    FOCUSER_STATUS_FIELD_COUNT
+};
+
+struct FocuserStatus
+{
+#define XX(key, type) FOCUSER_STATUS_CTYPE_##type key;
+    FOCUSER_STATUS_SCHEMA(XX)
+#undef XX
+    // Bit per FocuserStatusField, set when the field was present with a value of the right type.
+    uint32_t present;
+
+    bool has(FocuserStatusField field) const {
+        return present & (1u << field);
+    }
+};
+
+static_assert(FOCUSER_STATUS_FIELD_COUNT <= 32, "FocuserStatus::present has one bit per field");
+
+/**
+ * Decode a status response into status. Unknown keys are skipped, whatever their value.
+ * Returns JSON_OK or one of the gason JsonErrno codes, with endptr pointing at the offending character.
+**/
+int decodeFocuserStatus(const char *json, size_t length, FocuserStatus *status, const char **endptr);
+
+/**
+ * Decode a compact status frame, "absolutePosition targetPosition moving speed moveCount sequenceStep" in decimal with
+ * single spaces, into status. Only those fields are set. A response starting with '{' comes from firmware without the
+ * compact endpoint, which serves the full status for any /focuser path, and is decoded with decodeFocuserStatus.
+ * Returns JSON_OK, JSON_BAD_NUMBER for a malformed, missing or out of int32_t range field, with endptr pointing at it.
+**/
+int decodeCompactStatus(const char *frame, size_t length, FocuserStatus *status, const char **endptr);
+
+/**
+ * Resumable decoder for a status response delivered in chunks. Each known field is stored as soon as its
+ * value is complete, so nothing is buffered beyond the current key or scalar value, and unknown values of
+ * any size, like a temperature history, are skipped as they stream past.
+ * Call begin(), feed() every chunk in order, then finish().
+**/
+class FocuserStatusStream
+{
+public:
+    void begin(FocuserStatus *status);
+    // Returns JSON_OK, or the first error found so far; once an error is found further chunks are ignored.
+    int feed(const char *data, size_t length);
+    // Returns JSON_OK if a complete object was seen, JSON_BREAKING_BAD if the response stopped short.
+    int finish();
+    // Offset into the whole response of the character the decoder stopped at.
+    size_t offset() const {
+        return consumed;
+    }
+
+private:
+    enum State {
+        EXPECT_OBJECT,
+        EXPECT_FIRST_KEY,
+        EXPECT_KEY,
+        IN_KEY,
+        IN_KEY_ESCAPE,
+        EXPECT_COLON,
+        EXPECT_VALUE,
+        IN_STRING,
+        IN_STRING_ESCAPE,
+        IN_SCALAR,
+        IN_CONTAINER,
+        IN_CONTAINER_STRING,
+        IN_CONTAINER_ESCAPE,
+        EXPECT_COMMA,
+        DONE,
+        FAILED
+    };
+
+    FocuserStatus *status = nullptr;
+    State state = EXPECT_OBJECT;
+    int error = 0;
+    size_t consumed = 0;
+    int field = -1;
+    int depth = 0;
+    // Current key or value, including the quotes of a string. Longer tokens are only ever ones we skip.
+    char token[64];
+    size_t tokenLength = 0;
+    bool tokenOverflow = false;
+
+    void fail(int code);
+    void expectComma(char c);
+    void append(char c);
+    void endKey();
+    void endValue();
+};
+
+#endif
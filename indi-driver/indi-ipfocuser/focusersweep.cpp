@@ -0,0 +1,42 @@
+/*******************************************************************************
+  Autofocus sweep planning. See focusersweep.h.
+*******************************************************************************/
+#include "focusersweep.h"
+
+#include <algorithm>
+#include <functional>
+
+/**
+ * Any other order has at least one step between samples against the approach direction, and with it an overshoot, so
+ * increasing order is the cheapest that approaches every sample CCW, and decreasing order every sample CW. Travel is the
+ * same as any monotonic order: to the first sample, then across the range once. Taking up backlash only on reversal
+ * the samples are visited in increasing order too, which reverses at most once.
+**/
+SweepPlan planSweep(const std::vector<uint32_t> &samples, uint32_t position, const MotionModel &model,
+                    int8_t strategy)
+{
+    SweepPlan plan;
+    plan.samples = samples;
+    if (strategy == BACKLASH_APPROACH_CW)
+        std::sort(plan.samples.begin(), plan.samples.end(), std::greater<uint32_t>());
+    else
+        std::sort(plan.samples.begin(), plan.samples.end());
+    plan.samples.erase(std::unique(plan.samples.begin(), plan.samples.end()), plan.samples.end());
+
+    plan.plannedSeconds = 0;
+    uint32_t from = position;
+    for (uint32_t sample : plan.samples)
+    {
+        plan.plannedSeconds += model.predictSeconds(from, sample);
+        from = sample;
+    }
+
+    plan.givenOrderSeconds = 0;
+    from = position;
+    for (uint32_t sample : samples)
+    {
+        plan.givenOrderSeconds += model.predictSeconds(from, sample);
+        from = sample;
+    }
+    return plan;
+}
@@ -0,0 +1,35 @@
+/*******************************************************************************
+  Autofocus sweep planning.
+
+  When the device always approaches one way, every move the other way
+  overshoots by the backlash and comes back, so a sweep visited in the order
+  a client lists it pays that overshoot on every sample reached the wrong way.
+  Visiting the samples in the approach direction, increasing position for
+  CCW and decreasing for CW, reaches each one the right way round with no
+  overshoot at all, after a single pre-positioning move to the first.
+*******************************************************************************/
+
+#ifndef FOCUSERSWEEP_H
+#define FOCUSERSWEEP_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "motionmodel.h"
+
+struct SweepPlan
+{
+    std::vector<uint32_t> samples;  // in traversal order, duplicates removed
+    double plannedSeconds;          // motion time of the planned traversal
+    double givenOrderSeconds;       // motion time visiting the samples as given, one move each
+};
+
+/**
+ * Order samples for a sweep starting at position so every sample is approached the way strategy, a BacklashStrategy,
+ * approaches targets, and predict both traversals.
+**/
+SweepPlan planSweep(const std::vector<uint32_t> &samples, uint32_t position, const MotionModel &model,
+                    int8_t strategy);
+
+#endif
@@ -0,0 +1,163 @@
+/*******************************************************************************
+  Binary trace of device exchanges. See focusertrace.h.
+*******************************************************************************/
+#include "focusertrace.h"
+
+#include <string.h>
+
+static const char TRACE_MAGIC[8] = { 'I', 'P', 'F', 'T', 'R', 'A', 'C', 'E' };
+
+static void put(uint8_t *p, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = value >> (8 * i);
+}
+
+static uint64_t get(const uint8_t *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)p[i] << (8 * i);
+    return value;
+}
+
+TraceWriter::TraceWriter() : opened(false), fp(NULL)
+{
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const char *path)
+{
+    close();
+    std::lock_guard<std::mutex> lock(mutex);
+    fp = fopen(path, "ab");
+    if (!fp)
+        return false;
+    uint8_t version = TRACE_VERSION;
+    // Where an append stream starts out is up to the C library, so go to the end to see if the file is new
+    if (fseek(fp, 0, SEEK_END) == 0 && ftell(fp) == 0 &&
+        (fwrite(TRACE_MAGIC, sizeof(TRACE_MAGIC), 1, fp) != 1 || fwrite(&version, 1, 1, fp) != 1))
+    {
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+    sessionStart = Clock::now();
+    TraceRecord session;
+    session.kind = TRACE_SESSION;
+    session.result = TRACE_OK;
+    session.time = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::system_clock::now().time_since_epoch()).count();
+    session.latencyUs = 0;
+    session.timeoutMs = 0;
+    if (!write(session, NULL, 0, NULL, 0))
+    {
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+    opened = true;
+    return true;
+}
+
+void TraceWriter::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    opened = false;
+    if (fp)
+        fclose(fp);
+    fp = NULL;
+}
+
+void TraceWriter::record(TraceKind kind, TraceResult result, Clock::time_point start, Clock::time_point end,
+                         long timeoutMs, const void *request, size_t requestLength, const void *response,
+                         size_t responseLength)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fp)
+        return;
+    TraceRecord header;
+    header.kind = kind;
+    header.result = result;
+    header.time = start > sessionStart ?
+                  std::chrono::duration_cast<std::chrono::microseconds>(start - sessionStart).count() : 0;
+    header.latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    header.timeoutMs = timeoutMs;
+    if (requestLength > 0xFFFF)
+        requestLength = 0xFFFF;
+    if ((uint64_t)responseLength > 0xFFFFFFFF)
+        responseLength = 0xFFFFFFFF;
+    write(header, request, requestLength, response, responseLength);
+}
+
+/**
+ * Append a record and flush it, so what the device did last is on disk even if the driver is killed. Called locked.
+**/
+bool TraceWriter::write(const TraceRecord &header, const void *request, size_t requestLength, const void *response,
+                        size_t responseLength)
+{
+    uint8_t bytes[TRACE_RECORD_HEADER_SIZE];
+    bytes[0] = header.kind;
+    bytes[1] = header.result;
+    put(bytes + 2, requestLength, 2);
+    put(bytes + 4, responseLength, 4);
+    put(bytes + 8, header.time, 8);
+    put(bytes + 16, header.latencyUs, 4);
+    put(bytes + 20, header.timeoutMs, 4);
+    bool ok = fwrite(bytes, sizeof(bytes), 1, fp) == 1;
+    if (ok && requestLength)
+        ok = fwrite(request, requestLength, 1, fp) == 1;
+    if (ok && responseLength)
+        ok = fwrite(response, responseLength, 1, fp) == 1;
+    return fflush(fp) == 0 && ok;
+}
+
+TraceReader::TraceReader() : fp(NULL)
+{
+}
+
+TraceReader::~TraceReader()
+{
+    if (fp)
+        fclose(fp);
+}
+
+bool TraceReader::open(const char *path)
+{
+    if (fp)
+        fclose(fp);
+    fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+    char magic[sizeof(TRACE_MAGIC) + 1];
+    if (fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+        magic[sizeof(TRACE_MAGIC)] != TRACE_VERSION)
+    {
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool TraceReader::next(TraceRecord &record)
+{
+    uint8_t bytes[TRACE_RECORD_HEADER_SIZE];
+    if (!fp || fread(bytes, sizeof(bytes), 1, fp) != 1)
+        return false;
+    record.kind = bytes[0];
+    record.result = bytes[1];
+    size_t requestLength = get(bytes + 2, 2);
+    size_t responseLength = get(bytes + 4, 4);
+    record.time = get(bytes + 8, 8);
+    record.latencyUs = get(bytes + 16, 4);
+    record.timeoutMs = get(bytes + 20, 4);
+    record.request.resize(requestLength);
+    record.response.resize(responseLength);
+    return (!requestLength || fread(&record.request[0], requestLength, 1, fp) == 1) &&
+           (!responseLength || fread(&record.response[0], responseLength, 1, fp) == 1);
+}
@@ -0,0 +1,103 @@
+/*******************************************************************************
+  Binary trace of the driver's exchanges with the device, for replaying a
+  night offline with ipfocuser_replay.
+
+  A trace file starts with the 8 bytes "IPFTRACE" and a version byte, then
+  holds records, each a 24 byte little endian header followed by the request
+  and response bytes:
+
+    kind u8, result u8, request length u16, response length u32,
+    time u64, latency u32, timeout u32
+
+  Every time tracing starts a TRACE_SESSION record is appended, its time the
+  wall clock in microseconds since the epoch. The times of the exchanges
+  after it are microseconds since that session started, taken when the
+  request was sent. HTTP records hold the URL and the body, UDP records the
+  command and reply datagrams with sequence number 0, and no reply if none
+  came. Files are only ever appended to, so a trace survives the driver
+  crashing or the device hanging, up to the last exchange.
+*******************************************************************************/
+
+#ifndef FOCUSERTRACE_H
+#define FOCUSERTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+#define TRACE_VERSION 1
+#define TRACE_RECORD_HEADER_SIZE 24
+
+enum TraceKind {
+    TRACE_SESSION = 0,
+    TRACE_HTTP = 1,
+    TRACE_UDP = 2
+};
+
+enum TraceResult {
+    TRACE_OK = 0,
+    TRACE_FAILED = 1,
+    TRACE_TIMEOUT = 2
+};
+
+struct TraceRecord
+{
+    uint8_t kind;
+    uint8_t result;
+    uint64_t time;
+    uint32_t latencyUs;
+    uint32_t timeoutMs;
+    std::string request;
+    std::string response;
+};
+
+class TraceWriter
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TraceWriter();
+    ~TraceWriter();
+
+    // Append to the trace at path, creating it if need be, starting a new session. Returns false if it cannot be written.
+    bool open(const char *path);
+    void close();
+    // Lock free, so callers can skip collecting what they would record.
+    bool isOpen() const {
+        return opened.load(std::memory_order_relaxed);
+    }
+
+    // Append an exchange that started at start and ended at end. Thread safe. Does nothing unless open.
+    void record(TraceKind kind, TraceResult result, Clock::time_point start, Clock::time_point end, long timeoutMs,
+                const void *request, size_t requestLength, const void *response, size_t responseLength);
+
+private:
+    std::mutex mutex;
+    std::atomic<bool> opened;
+    FILE *fp;
+    Clock::time_point sessionStart;
+
+    bool write(const TraceRecord &header, const void *request, size_t requestLength, const void *response,
+               size_t responseLength);
+};
+
+class TraceReader
+{
+public:
+    TraceReader();
+    ~TraceReader();
+
+    // Returns false if path cannot be read or is not a trace.
+    bool open(const char *path);
+    // The next record, false at the end of the trace. A record cut short, by a crash while writing it, ends the trace.
+    bool next(TraceRecord &record);
+
+private:
+    FILE *fp;
+};
+
+#endif
@@ -0,0 +1,38 @@
+/*******************************************************************************
+  How FocuserClient talks HTTP to the device.
+
+  A transport runs one GET at a time and hands the body on as it arrives, so
+  a status response can be decoded without being buffered. Any response
+  counts as an answer, whatever its status code: the device's error
+  responses have no body, which then fails to decode. Implementations are
+  CurlTransport, on libcurl, and SocketTransport, a small HTTP/1.1 client of
+  its own. RecordingTransport wraps either to keep statistics and a trace.
+*******************************************************************************/
+
+#ifndef FOCUSERTRANSPORT_H
+#define FOCUSERTRANSPORT_H
+
+#include <stddef.h>
+
+enum TransportResult {
+    TRANSPORT_OK = 0,
+    TRANSPORT_FAILED = 1,
+    TRANSPORT_TIMEOUT = 2
+};
+
+// Receives the body of a response piece by piece.
+typedef void (*BodySink)(const char *data, size_t length, void *context);
+
+class FocuserTransport
+{
+public:
+    virtual ~FocuserTransport() {
+    }
+
+    // GET url, taking no longer than timeoutMs, handing the body to sink. A NULL sink discards the body.
+    virtual TransportResult get(const char *url, long timeoutMs, BodySink sink, void *context) = 0;
+    // What went wrong with the last get that did not return TRANSPORT_OK.
+    virtual const char *error() const = 0;
+};
+
+#endif
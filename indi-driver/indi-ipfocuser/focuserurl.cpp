@@ -0,0 +1,77 @@
+/*******************************************************************************
+  Request URLs for the focuser device HTTP API. See focuserurl.h.
+*******************************************************************************/
+#include "focuserurl.h"
+
+#include <string.h>
+
+static const char QUERY_POSITION[] = "?absolutePosition=";
+static const char QUERY_BACKLASH[] = "&backlashSteps=";
+static const char QUERY_APPROACH[] = "&alwaysApproach=";
+static const char QUERY_SEQUENCE[] = "?sequence=";
+static const char QUERY_SYNC[] = "?syncPosition=";
+
+FocuserUrl &FocuserUrl::append(const char *s, size_t n)
+{
+    if (n >= sizeof(text) - length)
+    {
+        n = sizeof(text) - 1 - length;
+        overflow = true;
+    }
+    memcpy(text + length, s, n);
+    length += n;
+    text[length] = '\0';
+    return *this;
+}
+
+FocuserUrl &FocuserUrl::append(const char *s)
+{
+    return append(s, strlen(s));
+}
+
+FocuserUrl &FocuserUrl::append(uint32_t n)
+{
+    char digits[10];
+    size_t count = 0;
+    do
+    {
+        digits[sizeof(digits) - ++count] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    return append(digits + sizeof(digits) - count, count);
+}
+
+bool buildMoveUrl(FocuserUrl &url, const char *endpoint, uint32_t targetTicks, const char *backlashSteps,
+                  const char *approachDirection)
+{
+    url.clear();
+    url.append(endpoint).append(QUERY_POSITION, sizeof(QUERY_POSITION) - 1).append(targetTicks);
+    if (backlashSteps)
+        url.append(QUERY_BACKLASH, sizeof(QUERY_BACKLASH) - 1).append(backlashSteps);
+    if (approachDirection)
+        url.append(QUERY_APPROACH, sizeof(QUERY_APPROACH) - 1).append(approachDirection);
+    return url.ok();
+}
+
+bool buildSequenceUrl(FocuserUrl &url, const char *endpoint, const uint32_t *targets, size_t count,
+                      const char *backlashSteps)
+{
+    url.clear();
+    url.append(endpoint).append(QUERY_SEQUENCE, sizeof(QUERY_SEQUENCE) - 1);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i)
+            url.append(",", 1);
+        url.append(targets[i]);
+    }
+    if (backlashSteps)
+        url.append(QUERY_BACKLASH, sizeof(QUERY_BACKLASH) - 1).append(backlashSteps);
+    return url.ok();
+}
+
+bool buildSyncUrl(FocuserUrl &url, const char *endpoint, uint32_t ticks)
+{
+    url.clear();
+    url.append(endpoint).append(QUERY_SYNC, sizeof(QUERY_SYNC) - 1).append(ticks);
+    return url.ok();
+}
@@ -0,0 +1,73 @@
+/*******************************************************************************
+  Request URLs for the focuser device HTTP API.
+
+  URLs are built in place in a FocuserUrl, which holds its text inline, so
+  building a request allocates nothing and a built request can be handed
+  between threads by value.
+*******************************************************************************/
+
+#ifndef FOCUSERURL_H
+#define FOCUSERURL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Room for an endpoint of a couple of hundred characters with a full move sequence, the firmware holds up to 10 targets.
+#define FOCUSER_URL_CAPACITY 320
+
+class FocuserUrl
+{
+public:
+    FocuserUrl() {
+        clear();
+    }
+
+    void clear() {
+        length = 0;
+        overflow = false;
+        text[0] = '\0';
+    }
+    FocuserUrl &append(const char *s, size_t n);
+    FocuserUrl &append(const char *s);
+    // n in decimal.
+    FocuserUrl &append(uint32_t n);
+
+    const char *c_str() const {
+        return text;
+    }
+    size_t size() const {
+        return length;
+    }
+    bool empty() const {
+        return length == 0;
+    }
+    // False if anything appended did not fit. The text is then cut short, and must not be sent.
+    bool ok() const {
+        return !overflow;
+    }
+
+private:
+    char text[FOCUSER_URL_CAPACITY];
+    size_t length;
+    bool overflow;
+};
+
+/**
+ * The move request for targetTicks into url. backlashSteps and approachDirection are passed through as the user typed
+ * them, either may be NULL to leave the device's setting alone. Returns false if the URL does not fit.
+**/
+bool buildMoveUrl(FocuserUrl &url, const char *endpoint, uint32_t targetTicks, const char *backlashSteps,
+                  const char *approachDirection);
+
+/**
+ * Load targets into the device as a move sequence and move to the first. Later targets are reached with buildMoveUrl.
+**/
+bool buildSequenceUrl(FocuserUrl &url, const char *endpoint, const uint32_t *targets, size_t count,
+                      const char *backlashSteps);
+
+/**
+ * Tell the device it is at ticks without moving, e.g. after a power cycle reset its position.
+**/
+bool buildSyncUrl(FocuserUrl &url, const char *endpoint, uint32_t ticks);
+
+#endif
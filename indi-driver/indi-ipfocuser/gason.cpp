@@ -22,7 +22,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "gason.h"
+#include "jsonnumber.h"
 #include <stdlib.h>
+#include <string.h>
+
+#if !defined(GASON_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define GASON_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 #define JSON_ZONE_SIZE 4096
 #define JSON_STACK_SIZE 32
@@ -39,17 +46,44 @@ const char *jsonStrError(int err) {
     }
 }
 
+JsonAllocator::JsonAllocator(void *buffer, size_t size) {
+    uintptr_t start = ((uintptr_t)buffer + 7) & ~(uintptr_t)7;
+    size_t skip = start - (uintptr_t)buffer;
+    if (size < skip + sizeof(Zone) + 8)
+        return;
+    fixed = (Zone *)start;
+    fixed->next = nullptr;
+    fixed->used = sizeof(Zone);
+    fixed->size = (size - skip) & ~(size_t)7;
+    head = fixed;
+}
+
+JsonAllocator::Zone *JsonAllocator::obtain(size_t size) {
+    for (Zone **it = &spare; *it; it = &(*it)->next) {
+        if ((*it)->size >= size) {
+            Zone *zone = *it;
+            *it = zone->next;
+            return zone;
+        }
+    }
+    size_t zoneSize = size <= JSON_ZONE_SIZE ? JSON_ZONE_SIZE : size;
+    Zone *zone = (Zone *)malloc(zoneSize);
+    if (zone != nullptr)
+        zone->size = zoneSize;
+    return zone;
+}
+
 void *JsonAllocator::allocate(size_t size) {
     size = (size + 7) & ~7;
 
-    if (head && head->used + size <= JSON_ZONE_SIZE) {
+    if (head && head->used + size <= head->size) {
         char *p = (char *)head + head->used;
         head->used += size;
         return p;
     }
 
     size_t allocSize = sizeof(Zone) + size;
-    Zone *zone = (Zone *)malloc(allocSize <= JSON_ZONE_SIZE ? JSON_ZONE_SIZE : allocSize);
+    Zone *zone = obtain(allocSize);
     if (zone == nullptr)
         return nullptr;
     zone->used = allocSize;
@@ -63,12 +97,29 @@ void *JsonAllocator::allocate(size_t size) {
     return (char *)zone + sizeof(Zone);
 }
 
-void JsonAllocator::deallocate() {
+void JsonAllocator::reset() {
     while (head) {
         Zone *next = head->next;
-        free(head);
+        if (head != fixed) {
+            head->next = spare;
+            spare = head;
+        }
         head = next;
     }
+    if (fixed) {
+        fixed->next = nullptr;
+        fixed->used = sizeof(Zone);
+        head = fixed;
+    }
+}
+
+void JsonAllocator::deallocate() {
+    reset();
+    while (spare) {
+        Zone *next = spare->next;
+        free(spare);
+        spare = next;
+    }
 }
 
 static inline bool isspace(char c) {
@@ -87,56 +138,126 @@ static inline bool isxdigit(char c) {
     return (c >= '0' && c <= '9') || ((c & ~' ') >= 'A' && (c & ~' ') <= 'F');
 }
 
-static inline int char2int(char c) {
-    if (c <= '9')
-        return c - '0';
-    return (c & ~' ') - 'A' + 10;
+static inline bool isstringspecial(char c) {
+    return c == '"' || c == '\\' || (unsigned char)c < ' ' || c == '\x7F';
 }
 
-static double string2double(char *s, char **endptr) {
-    char ch = *s;
-    if (ch == '-')
+/*
+ * Bulk scanners used to skip runs of whitespace and of ordinary string characters.
+ * Both stop at the terminating NUL, so the SIMD versions only ever load aligned blocks
+ * that contain at least one byte of the input and can never fault past its end.
+ */
+static char *skipSpaceScalar(char *s) {
+    while (isspace(*s))
         ++s;
+    return s;
+}
 
-    double result = 0;
-    while (isdigit(*s))
-        result = (result * 10) + (*s++ - '0');
-
-    if (*s == '.') {
+static char *scanStringScalar(char *s) {
+    while (!isstringspecial(*s))
         ++s;
+    return s;
+}
 
-        double fraction = 1;
-        while (isdigit(*s)) {
-            fraction *= 0.1;
-            result += (*s++ - '0') * fraction;
-        }
-    }
+#ifdef GASON_X86_SIMD
+static inline __m128i spaceMask128(__m128i x) {
+    // ' ' or '\t'..'\r', the range test is done unsigned via min
+    __m128i t = _mm_sub_epi8(x, _mm_set1_epi8('\t'));
+    __m128i range = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8('\r' - '\t')), t);
+    return _mm_or_si128(range, _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')));
+}
 
-    if (*s == 'e' || *s == 'E') {
-        ++s;
+static inline __m128i specialMask128(__m128i x) {
+    // '"', '\\', DEL or a control character (including the terminating NUL)
+    __m128i control = _mm_cmpeq_epi8(_mm_and_si128(x, _mm_set1_epi8((char)0xE0)), _mm_setzero_si128());
+    __m128i quote = _mm_cmpeq_epi8(x, _mm_set1_epi8('"'));
+    __m128i backslash = _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'));
+    __m128i del = _mm_cmpeq_epi8(x, _mm_set1_epi8('\x7F'));
+    return _mm_or_si128(_mm_or_si128(control, quote), _mm_or_si128(backslash, del));
+}
 
-        double base = 10;
-        if (*s == '+')
-            ++s;
-        else if (*s == '-') {
-            ++s;
-            base = 0.1;
-        }
+__attribute__((no_sanitize_address)) static char *skipSpaceSse2(char *s) {
+    uintptr_t offset = (uintptr_t)s & 15;
+    const __m128i *p = (const __m128i *)(s - offset);
+    unsigned int stop = ~_mm_movemask_epi8(spaceMask128(_mm_load_si128(p))) & (0xFFFFu << offset) & 0xFFFF;
+    while (!stop)
+        stop = ~_mm_movemask_epi8(spaceMask128(_mm_load_si128(++p))) & 0xFFFF;
+    return (char *)p + __builtin_ctz(stop);
+}
 
-        unsigned int exponent = 0;
-        while (isdigit(*s))
-            exponent = (exponent * 10) + (*s++ - '0');
+__attribute__((no_sanitize_address)) static char *scanStringSse2(char *s) {
+    uintptr_t offset = (uintptr_t)s & 15;
+    const __m128i *p = (const __m128i *)(s - offset);
+    unsigned int stop = _mm_movemask_epi8(specialMask128(_mm_load_si128(p))) & (0xFFFFu << offset);
+    while (!stop)
+        stop = _mm_movemask_epi8(specialMask128(_mm_load_si128(++p)));
+    return (char *)p + __builtin_ctz(stop);
+}
 
-        double power = 1;
-        for (; exponent; exponent >>= 1, base *= base)
-            if (exponent & 1)
-                power *= base;
+__attribute__((target("avx2"))) static inline __m256i spaceMask256(__m256i x) {
+    __m256i t = _mm256_sub_epi8(x, _mm256_set1_epi8('\t'));
+    __m256i range = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8('\r' - '\t')), t);
+    return _mm256_or_si256(range, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')));
+}
 
-        result *= power;
-    }
+__attribute__((target("avx2"))) static inline __m256i specialMask256(__m256i x) {
+    __m256i control = _mm256_cmpeq_epi8(_mm256_and_si256(x, _mm256_set1_epi8((char)0xE0)), _mm256_setzero_si256());
+    __m256i quote = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('"'));
+    __m256i backslash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'));
+    __m256i del = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\x7F'));
+    return _mm256_or_si256(_mm256_or_si256(control, quote), _mm256_or_si256(backslash, del));
+}
 
-    *endptr = s;
-    return ch == '-' ? -result : result;
+__attribute__((target("avx2"), no_sanitize_address)) static char *skipSpaceAvx2(char *s) {
+    uintptr_t offset = (uintptr_t)s & 31;
+    const __m256i *p = (const __m256i *)(s - offset);
+    unsigned int stop = ~(unsigned int)_mm256_movemask_epi8(spaceMask256(_mm256_load_si256(p))) & (0xFFFFFFFFu << offset);
+    while (!stop)
+        stop = ~(unsigned int)_mm256_movemask_epi8(spaceMask256(_mm256_load_si256(++p)));
+    return (char *)p + __builtin_ctz(stop);
+}
+
+__attribute__((target("avx2"), no_sanitize_address)) static char *scanStringAvx2(char *s) {
+    uintptr_t offset = (uintptr_t)s & 31;
+    const __m256i *p = (const __m256i *)(s - offset);
+    unsigned int stop = (unsigned int)_mm256_movemask_epi8(specialMask256(_mm256_load_si256(p))) & (0xFFFFFFFFu << offset);
+    while (!stop)
+        stop = (unsigned int)_mm256_movemask_epi8(specialMask256(_mm256_load_si256(++p)));
+    return (char *)p + __builtin_ctz(stop);
+}
+#endif
+
+typedef char *(*JsonScanner)(char *);
+
+struct JsonScanners {
+    JsonScanner skipSpace;
+    JsonScanner scanString;
+};
+
+static JsonScanners selectScanners() {
+#ifdef GASON_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return JsonScanners{skipSpaceAvx2, scanStringAvx2};
+    if (__builtin_cpu_supports("sse2"))
+        return JsonScanners{skipSpaceSse2, scanStringSse2};
+#endif
+    return JsonScanners{skipSpaceScalar, scanStringScalar};
+}
+
+static const JsonScanners scanners = selectScanners();
+
+static inline int char2int(char c) {
+    if (c <= '9')
+        return c - '0';
+    return (c & ~' ') - 'A' + 10;
+}
+
+static inline double string2double(char *s, char **endptr) {
+    const char *end;
+    double result = jsonParseNumber(s, nullptr, &end);
+    *endptr = (char *)end;
+    return result;
 }
 
 static inline JsonNode *insertAfter(JsonNode *tail, JsonNode *node) {
@@ -169,7 +290,11 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
     while (*s) {
         while (isspace(*s)) {
             ++s;
-            if (!*s) break;
+            // A single space is the common case, longer runs such as indentation go to the bulk scanner
+            if (isspace(*s)) {
+                s = scanners.skipSpace(s + 1);
+                break;
+            }
         }
         *endptr = s++;
         switch (**endptr) {
@@ -197,6 +322,16 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
         case '"':
             o = JsonValue(JSON_STRING, s);
             for (char *it = s; *s; ++it, ++s) {
+                if (!isstringspecial(*s)) {
+                    // Move the whole run of ordinary characters at once, in place only once an escape has shortened the string
+                    char *run = scanners.scanString(s);
+                    if (it != s)
+                        memmove(it, s, run - s);
+                    it += run - s;
+                    s = run;
+                    if (!*s)
+                        break;
+                }
                 int c = *it = *s;
                 if (c == '\\') {
                     c = *++s;
@@ -321,6 +456,8 @@ int jsonParse(char *s, char **endptr, JsonValue *value, JsonAllocator &allocator
             separator = true;
             continue;
         case '\0':
+            // end of input after whitespace, step back so the loop condition sees the terminator rather than the byte after it
+            s = *endptr;
             continue;
         default:
             return JSON_UNEXPECTED_CHARACTER;
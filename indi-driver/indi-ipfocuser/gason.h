@@ -134,24 +134,36 @@ class JsonAllocator {
     struct Zone {
         Zone *next;
         size_t used;
+        size_t size;
     } *head = nullptr;
+    Zone *spare = nullptr;
+    Zone *fixed = nullptr;
+
+    Zone *obtain(size_t size);
 
 public:
     JsonAllocator() = default;
+    // Serve allocations from buffer first, e.g. a stack or member array. It is never freed and must outlive the allocator.
+    JsonAllocator(void *buffer, size_t size);
     JsonAllocator(const JsonAllocator &) = delete;
     JsonAllocator &operator=(const JsonAllocator &) = delete;
-    JsonAllocator(JsonAllocator &&x) : head(x.head) {
-        x.head = nullptr;
+    JsonAllocator(JsonAllocator &&x) : head(x.head), spare(x.spare), fixed(x.fixed) {
+        x.head = x.spare = x.fixed = nullptr;
     }
     JsonAllocator &operator=(JsonAllocator &&x) {
+        deallocate();
         head = x.head;
-        x.head = nullptr;
+        spare = x.spare;
+        fixed = x.fixed;
+        x.head = x.spare = x.fixed = nullptr;
         return *this;
     }
     ~JsonAllocator() {
         deallocate();
     }
     void *allocate(size_t size);
+    // Invalidate everything allocated so far but keep the zones, so parsing a similar document again needs no malloc.
+    void reset();
     void deallocate();
 };
 
@@ -4,51 +4,110 @@
 
 *******************************************************************************/
 #include "ipfocuser.h"
+#include "curlmulti.h"
+#include "focuserstatus.h"
 #include "gason.h"
 
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
 #include <math.h>
 #include <string.h>
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <connectionplugins/connectiontcp.h>
 
-#include <curl/curl.h>
+// Most focusers the driver runs at once, see CreateFocusers.
+#define MAX_FOCUSERS 32
 
-// We declare an auto pointer to ipFocus.
-std::unique_ptr<IpFocus> ipFocus(new IpFocus());
+// Every focuser's requests run on this one multi handle. Declared first, so it outlives them.
+static CurlMulti curlMulti;
+
+/**
+ * One IpFocus per focuser, IPFOCUSER_DEVICES of them (default 1). A single focuser keeps the default name, or the one
+ * given by indiserver, more are named "IP Focuser 1", "IP Focuser 2" and so on. Each has its own properties, config
+ * and I/O worker, they share the event loop and curlMulti.
+**/
+static std::vector<std::unique_ptr<IpFocus>> CreateFocusers()
+{
+    const char *devices = getenv("IPFOCUSER_DEVICES");
+    int count = devices ? atoi(devices) : 1;
+    count = std::max(1, std::min(count, MAX_FOCUSERS));
+    std::vector<std::unique_ptr<IpFocus>> focusers;
+    for (int i = 0; i < count; i++)
+    {
+        std::string name = "IP Focuser " + std::to_string(i + 1);
+        focusers.emplace_back(new IpFocus(curlMulti, count > 1 ? name.c_str() : NULL));
+    }
+    return focusers;
+}
+
+static std::vector<std::unique_ptr<IpFocus>> focusers = CreateFocusers();
 
 #define SIM_SEEING  0
 #define SIM_FWHM    1
 
+// How often the INDI event loop collects move updates from the I/O worker.
+#define COMPLETION_POLL_MS 250
+// How often the I/O worker polls the device for progress while it is moving.
+#define MOVE_POLL_MS 500
+// HTTP timeouts for requests to the device. It answers at once, moves run in the background.
+#define REQUEST_TIMEOUT_MS 10000
+#define MIN_REQUEST_TIMEOUT_MS 2000
+// A booting device does not answer at all, so probes give up quickly and rely on the backoff.
+#define PROBE_TIMEOUT_MS 1000
+#define POWER_REQUEST_TIMEOUT_MS 10000
+// How often the I/O worker checks on a move over UDP, using telemetry when a recent one has arrived.
+#define UDP_MOVE_POLL_MS 100
+#define UDP_ATTEMPTS 4
+// Telemetry is sent every 100 ms while moving. Older than this it is asked for instead.
+#define UDP_TELEMETRY_MAX_AGE_MS 250
+// Targets loaded into the device at once when a sweep is detected, the firmware holds up to 10.
+#define SWEEP_SEQUENCE_LENGTH 10
+// How often TimerHit publishes the statistics, when anything was recorded since.
+#define STATS_PUBLISH_MS 5000
+#define STATS_TAB "Statistics"
+// How often the idle I/O worker reads the temperature. The device averages it over 1.6 s.
+#define TEMPERATURE_POLL_MS 30000
+#define COMPENSATION_TAB "Temperature"
+
 void ISPoll(void *p);
 
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
+// Whether a client message for dev, null meaning every device, is for focuser.
+static bool IsFor(const char *dev, const std::unique_ptr<IpFocus> &focuser)
 {
-    ((std::string*)userp)->append((char*)contents, size * nmemb);
-    return size * nmemb;
+    return dev == NULL || !strcmp(dev, focuser->getDeviceName());
 }
 
 void ISGetProperties(const char *dev)
 {
-    ipFocus->ISGetProperties(dev);
+    for (auto &focuser : focusers)
+        if (IsFor(dev, focuser))
+            focuser->ISGetProperties(dev);
 }
 
 void ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int num)
 {
-    ipFocus->ISNewSwitch(dev, name, states, names, num);
+    for (auto &focuser : focusers)
+        if (IsFor(dev, focuser))
+            focuser->ISNewSwitch(dev, name, states, names, num);
 }
 
 void ISNewText(	const char *dev, const char *name, char *texts[], char *names[], int num)
 {
-    ipFocus->ISNewText(dev, name, texts, names, num);
+    for (auto &focuser : focusers)
+        if (IsFor(dev, focuser))
+            focuser->ISNewText(dev, name, texts, names, num);
 }
 
 void ISNewNumber(const char *dev, const char *name, double values[], char *names[], int num)
 {
-    ipFocus->ISNewNumber(dev, name, values, names, num);
+    for (auto &focuser : focusers)
+        if (IsFor(dev, focuser))
+            focuser->ISNewNumber(dev, name, values, names, num);
 }
 
 void ISNewBLOB (const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[], char *names[], int n)
@@ -65,18 +124,24 @@ void ISNewBLOB (const char *dev, const char *name, int sizes[], int blobsizes[],
 
 void ISSnoopDevice (XMLEle *root)
 {
-    ipFocus->ISSnoopDevice(root);
+    for (auto &focuser : focusers)
+        focuser->ISSnoopDevice(root);
 }
 
-IpFocus::IpFocus()
+IpFocus::IpFocus(CurlMulti &transfers, const char *name) : curlTransport(&transfers), transport(curlTransport, stats, trace),
+    client(transport), droppedUpdates(0), workerExit(false), statsPublishedTotal(0), devicePosition(0), lastMoveId(0), lastTargetTicks(0), moveInProgress(false), lastMoveDelta(0), sweepNext(0),
+    lastMoveModelled(0), lastMovePredicted(0), lastMoveFromRest(false), temperature(NAN), sweepIndex(0), sweepActive(false), sweepMoveId(0)
 {
     SetCapability(FOCUSER_CAN_ABS_MOVE | FOCUSER_CAN_REL_MOVE);
+
     setSupportedConnections(CONNECTION_TCP);
+    if (name)
+        setDeviceName(name);
 }
 
 IpFocus::~IpFocus()
 {
-    //dtor
+    StopWorker();
 }
 
 const char * IpFocus::getDefaultName()
@@ -102,6 +167,66 @@ bool IpFocus::initProperties()
     IUFillTextVector(&PowerOffEndpointP, PowerOffEndpointT, 1, getDeviceName(), "POWEROFF_ENDPOINT", "Power Off", OPTIONS_TAB, IP_RW, 5, IPS_IDLE);
     IUFillText(&PowerOnEndpointT[0], "POWERON_ENDPOINT", "Power On URL", "http://192.168.2.225:8080/power/focuser/on");
     IUFillTextVector(&PowerOnEndpointP, PowerOnEndpointT, 1, getDeviceName(), "POWERON_ENDPOINT", "Power On", OPTIONS_TAB, IP_RW, 5, IPS_IDLE);
+    CopyPowerEndpoints();
+
+    /* Autofocus sweep: samples are visited in increasing position so each is approached CCW, waiting DWELL seconds at each */
+    IUFillText(&SweepSamplesT[0], "SWEEP_SAMPLES", "Sample positions", "");
+    IUFillTextVector(&SweepSamplesP, SweepSamplesT, 1, getDeviceName(), "FOCUS_SWEEP", "Sweep", MAIN_CONTROL_TAB, IP_RW, 0, IPS_IDLE);
+    IUFillNumber(&SweepDwellN[0], "SWEEP_DWELL", "Dwell (s)", "%.1f", 0, 3600, 1, 0);
+    IUFillNumberVector(&SweepDwellNP, SweepDwellN, 1, getDeviceName(), "FOCUS_SWEEP_DWELL", "Sweep Dwell", MAIN_CONTROL_TAB, IP_RW, 0, IPS_IDLE);
+    IUFillNumber(&SweepTimeN[0], "SWEEP_PREDICTED", "Predicted (s)", "%.1f", 0, 1e6, 0, 0);
+    IUFillNumber(&SweepTimeN[1], "SWEEP_ACTUAL", "Actual (s)", "%.1f", 0, 1e6, 0, 0);
+    IUFillNumber(&SweepTimeN[2], "SWEEP_GIVEN_ORDER", "Given order (s)", "%.1f", 0, 1e6, 0, 0);
+    IUFillNumberVector(&SweepTimeNP, SweepTimeN, 3, getDeviceName(), "FOCUS_SWEEP_TIME", "Sweep Time", MAIN_CONTROL_TAB, IP_RO, 0, IPS_IDLE);
+
+    /* Time left in the current move, predicted by the motion model */
+    IUFillNumber(&EtaN[0], "ETA_SECONDS", "ETA (s)", "%.1f", 0, 1e6, 0, 0);
+    IUFillNumberVector(&EtaNP, EtaN, 1, getDeviceName(), "FOCUS_ETA", "Move ETA", MAIN_CONTROL_TAB, IP_RO, 0, IPS_IDLE);
+
+    /* UDP port for polls and plain moves, 0 for HTTP only. Firmware without it is detected on connect and HTTP used */
+    IUFillNumber(&UdpPortN[0], "UDP_PORT", "UDP port", "%.0f", 0, 65535, 1, UDP_FOCUSER_PORT);
+    IUFillNumberVector(&UdpPortNP, UdpPortN, 1, getDeviceName(), "UDP_SETTINGS", "UDP", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    /* Statistics since the driver started or they were reset, optionally appended to a file as a line of JSON */
+    FillHistogramProperty(&HttpLatencyNP, HttpLatencyN, "STATS_HTTP_LATENCY", "HTTP Requests", "ms");
+    FillHistogramProperty(&UdpLatencyNP, UdpLatencyN, "STATS_UDP_LATENCY", "UDP Requests", "ms");
+    FillHistogramProperty(&MoveDurationNP, MoveDurationN, "STATS_MOVE_DURATION", "Moves", "s");
+    FillHistogramProperty(&HandshakeTimeNP, HandshakeTimeN, "STATS_HANDSHAKE_TIME", "Handshakes", "ms");
+    static const char *counterNames[][2] = {
+#define XX(name, label) { #name, label },
+        FOCUSER_COUNTERS(XX)
+#undef XX
+    };
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        IUFillNumber(&CountersN[i], counterNames[i][0], counterNames[i][1], "%.0f", 0, 1e9, 0, 0);
+    IUFillNumberVector(&CountersNP, CountersN, COUNTER_COUNT, getDeviceName(), "STATS_COUNTERS", "Counters", STATS_TAB, IP_RO, 0, IPS_IDLE);
+    IUFillText(&StatsFileT[0], "STATS_FILE", "File", "");
+    IUFillTextVector(&StatsFileTP, StatsFileT, 1, getDeviceName(), "STATS_FILE", "Dump To", STATS_TAB, IP_RW, 0, IPS_IDLE);
+    IUFillSwitch(&StatsActionS[0], "STATS_DUMP", "Dump", ISS_OFF);
+    IUFillSwitch(&StatsActionS[1], "STATS_RESET", "Reset", ISS_OFF);
+    IUFillSwitchVector(&StatsActionSP, StatsActionS, 2, getDeviceName(), "STATS_ACTION", "Statistics", STATS_TAB, IP_RW, ISR_ATMOST1, 0, IPS_IDLE);
+
+    /* Temperature compensation: the focuser follows the focus drift the model predicts from the last position chosen,
+       once it amounts to TC_STEP steps. Autofocus results, reported with TC_AUTOFOCUS_DONE, teach the model the slope */
+    IUFillNumber(&TemperatureN[0], "TEMPERATURE", "Celsius", "%.1f", -100, 100, 0, 0);
+    IUFillNumberVector(&TemperatureNP, TemperatureN, 1, getDeviceName(), "FOCUS_TEMPERATURE", "Temperature", MAIN_CONTROL_TAB, IP_RO, 0, IPS_IDLE);
+    IUFillSwitch(&CompensationS[0], "TC_ON", "On", ISS_OFF);
+    IUFillSwitch(&CompensationS[1], "TC_OFF", "Off", ISS_ON);
+    IUFillSwitchVector(&CompensationSP, CompensationS, 2, getDeviceName(), "FOCUS_TC", "Compensation", COMPENSATION_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+    IUFillNumber(&CompensationSettingsN[0], "TC_STEP", "Move after (steps)", "%.0f", 1, 10000, 10, 50);
+    IUFillNumber(&CompensationSettingsN[1], "TC_PRIOR_SLOPE", "Prior slope (steps/C)", "%.1f", -10000, 10000, 1, 0);
+    IUFillNumberVector(&CompensationSettingsNP, CompensationSettingsN, 2, getDeviceName(), "FOCUS_TC_SETTINGS", "Settings", COMPENSATION_TAB, IP_RW, 0, IPS_IDLE);
+    IUFillSwitch(&CompensationSampleS[0], "TC_AUTOFOCUS_DONE", "At best focus", ISS_OFF);
+    IUFillSwitchVector(&CompensationSampleSP, CompensationSampleS, 1, getDeviceName(), "FOCUS_TC_SAMPLE", "Autofocus Result", COMPENSATION_TAB, IP_RW, ISR_ATMOST1, 0, IPS_IDLE);
+    IUFillNumber(&CompensationModelN[0], "TC_SLOPE", "Slope (steps/C)", "%.1f", -1e6, 1e6, 0, 0);
+    IUFillNumber(&CompensationModelN[1], "TC_RESULTS", "Results fitted", "%.0f", 0, 1e6, 0, 0);
+    IUFillNumber(&CompensationModelN[2], "TC_SPREAD", "Temperature spread (C)", "%.1f", 0, 1e3, 0, 0);
+    IUFillNumber(&CompensationModelN[3], "TC_DRIFT", "Drift not followed (steps)", "%.0f", -1e6, 1e6, 0, 0);
+    IUFillNumberVector(&CompensationModelNP, CompensationModelN, 4, getDeviceName(), "FOCUS_TC_MODEL", "Model", COMPENSATION_TAB, IP_RO, 0, IPS_IDLE);
+
+    /* Binary trace of every exchange with the device, appended to while set, see focusertrace.h and ipfocuser_replay */
+    IUFillText(&TraceFileT[0], "TRACE_FILE", "File", "");
+    IUFillTextVector(&TraceFileTP, TraceFileT, 1, getDeviceName(), "TRACE_FILE", "Trace", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
 
     /* Relative and absolute movement settings which are not set on connect*/
     FocusRelPosN[0].min = 0.;
@@ -125,18 +250,68 @@ bool IpFocus::updateProperties()
         defineProperty(&AlwaysApproachDirectionP);
         defineProperty(&PowerOffEndpointP);
         defineProperty(&PowerOnEndpointP);
+        defineProperty(&SweepSamplesP);
+        defineProperty(&SweepDwellNP);
+        defineProperty(&SweepTimeNP);
+        defineProperty(&EtaNP);
+        defineProperty(&UdpPortNP);
+        defineProperty(&HttpLatencyNP);
+        defineProperty(&UdpLatencyNP);
+        defineProperty(&MoveDurationNP);
+        defineProperty(&HandshakeTimeNP);
+        defineProperty(&CountersNP);
+        defineProperty(&StatsFileTP);
+        defineProperty(&StatsActionSP);
+        defineProperty(&TraceFileTP);
+        defineProperty(&TemperatureNP);
+        defineProperty(&CompensationSP);
+        defineProperty(&CompensationSettingsNP);
+        defineProperty(&CompensationSampleSP);
+        defineProperty(&CompensationModelNP);
+        PublishCompensationModel();
+        PublishStats(true);
     }
     else
     {
         deleteProperty(BacklashStepsP.name);
         deleteProperty(AlwaysApproachDirectionP.name);
+        deleteProperty(SweepSamplesP.name);
+        deleteProperty(SweepDwellNP.name);
+        deleteProperty(SweepTimeNP.name);
+        deleteProperty(EtaNP.name);
+        deleteProperty(UdpPortNP.name);
+        deleteProperty(HttpLatencyNP.name);
+        deleteProperty(UdpLatencyNP.name);
+        deleteProperty(MoveDurationNP.name);
+        deleteProperty(HandshakeTimeNP.name);
+        deleteProperty(CountersNP.name);
+        deleteProperty(StatsFileTP.name);
+        deleteProperty(StatsActionSP.name);
+        deleteProperty(TraceFileTP.name);
+        deleteProperty(TemperatureNP.name);
+        deleteProperty(CompensationSP.name);
+        deleteProperty(CompensationSettingsNP.name);
+        deleteProperty(CompensationSampleSP.name);
+        deleteProperty(CompensationModelNP.name);
     }
 
     return true;
 }
 
 bool IpFocus::Connect() {
-  return Handshake();
+  if (!Handshake())
+    return false;
+  StartWorker();
+  SetTimer(COMPLETION_POLL_MS);
+  return true;
+}
+
+bool IpFocus::Disconnect() {
+  StopWorker();
+  udp.close();
+  if (StatsFileT[0].text[0])
+    DumpStats();
+  return INDI::Focuser::Disconnect();
 }
 /**
  * Connect and set position values from focuser device response.
@@ -144,71 +319,67 @@ bool IpFocus::Connect() {
 bool IpFocus::Handshake()
 {
     DEBUG(INDI::Logger::DBG_SESSION, "***** connecting ******");
-    APIEndPoint = std::string("http://") + std::string(tcpConnection->host()) + std::string(":80") + std::string("/focuser"); //FIXME: for some reason std::to_string(tcpConnection->getPortFD()) returns 127. So hard code 80 for now.
-    DEBUGF(INDI::Logger::DBG_SESSION, "API endpoint %s", APIEndPoint.c_str());
-    CURL *curl;
-    CURLcode res;
-    std::string readBuffer;
-
-    curl = curl_easy_init();
-    if(curl)
-    {
-        curl_easy_setopt(curl, CURLOPT_URL, APIEndPoint.c_str());
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L); //10 sec timeout
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        DEBUG(INDI::Logger::DBG_DEBUG, "***** performing curl ******");
-        res = curl_easy_perform(curl);
-        /* Check for errors */
-        if(res != CURLE_OK)
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string endpoint = std::string("http://") + std::string(tcpConnection->host()) + std::string(":80") + std::string("/focuser"); //FIXME: for some reason std::to_string(tcpConnection->getPortFD()) returns 127. So hard code 80 for now.
+    DEBUGF(INDI::Logger::DBG_SESSION, "API endpoint %s", endpoint.c_str());
+    if (!client.setEndpoint(endpoint.c_str()))
+    {
+        DEBUGF(INDI::Logger::DBG_ERROR, "%s", client.error());
+        return false;
+    }
+    FocuserStatus status;
+
+    DEBUG(INDI::Logger::DBG_DEBUG, "***** performing request ******");
+    if (!client.status(status, REQUEST_TIMEOUT_MS))
+    {
+        if (client.transportResult() != TRANSPORT_OK)
         {
-            DEBUGF(INDI::Logger::DBG_ERROR, "Connecttion to FOCUSER failed:%s",curl_easy_strerror(res));
+            DEBUGF(INDI::Logger::DBG_ERROR, "Comms failed.:%s", client.error());
             DEBUG(INDI::Logger::DBG_ERROR, "Is the HTTP API endpoint correct? Set it in the options tab. Can you ping the focuser?");
-            return false;
-        }
-        /* always cleanup */
-        curl_easy_cleanup(curl);
-
-        char srcBuffer[readBuffer.size()];
-        strncpy(srcBuffer, readBuffer.c_str(), readBuffer.size());
-        char *source = srcBuffer;
-        // do not forget terminate source string with 0
-        char *endptr;
-        DEBUG(INDI::Logger::DBG_DEBUG, "***** completed curl ******");
-        DEBUGF(INDI::Logger::DBG_DEBUG, "Focuser response %s", readBuffer.c_str());
-        JsonValue value;
-        JsonAllocator allocator;
-        int status = jsonParse(source, &endptr, &value, allocator);
-        //DEBUGF(INDI::Logger::DBG_DEBUG, "Focuser response %s", readBuffer.c_str());
-        if (status != JSON_OK)
-        {
-            DEBUGF(INDI::Logger::DBG_ERROR, "%s at %zd", jsonStrError(status), endptr - source);
-            DEBUGF(INDI::Logger::DBG_DEBUG, "%s", readBuffer.c_str());
-            return false;
         }
+        else
+            DEBUGF(INDI::Logger::DBG_ERROR, "%s", client.error());
+        return false;
+    }
+    DEBUG(INDI::Logger::DBG_DEBUG, "***** completed request ******");
 
-        JsonIterator it;
-        for (it = begin(value); it!= end(value); ++it)
-        {
-            DEBUGF(INDI::Logger::DBG_DEBUG, "iterating %s", it->key);
-            if (!strcmp(it->key, "absolutePosition"))
-            {
-                DEBUGF(INDI::Logger::DBG_DEBUG, "Setting absolute position from response %g", it->value.toNumber());
-                FocusAbsPosN[0].value = it->value.toNumber();
-            }
-            if (!strcmp(it->key, "maxPosition"))
-            {
-                DEBUGF(INDI::Logger::DBG_DEBUG, "Setting max position from response %g", it->value.toNumber());
-                FocusAbsPosN[0].max = it->value.toNumber();
-            }
-            if (!strcmp(it->key, "minPosition"))
-            {
-                DEBUGF(INDI::Logger::DBG_DEBUG, "Setting min position from response %g", it->value.toNumber());
-                FocusAbsPosN[0].min = it->value.toNumber();
-            }
-        }
+    if (status.has(FOCUSER_STATUS_absolutePosition))
+    {
+        DEBUGF(INDI::Logger::DBG_DEBUG, "Setting absolute position from response %d", status.absolutePosition);
+        FocusAbsPosN[0].value = status.absolutePosition;
+    }
+    if (status.has(FOCUSER_STATUS_maxPosition))
+    {
+        DEBUGF(INDI::Logger::DBG_DEBUG, "Setting max position from response %d", status.maxPosition);
+        FocusAbsPosN[0].max = status.maxPosition;
     }
+    if (status.has(FOCUSER_STATUS_minPosition))
+    {
+        DEBUGF(INDI::Logger::DBG_DEBUG, "Setting min position from response %d", status.minPosition);
+        FocusAbsPosN[0].min = status.minPosition;
+    }
+    if (status.has(FOCUSER_STATUS_bootCount))
+        DEBUGF(INDI::Logger::DBG_SESSION, "Focuser boot %d, %s", status.bootCount,
+               status.has(FOCUSER_STATUS_positionRestored) && status.positionRestored ?
+               "position restored from its journal" : "no journaled position, it started at its default");
+    UpdateKinematics(&status);
+    motionModel.forgetDirection();
+    OpenUdp();
+    // Focus may have been changed by hand while disconnected, so there is nothing to compensate from until a move
+    temperatureModel.endSession();
+    temperature = status.has(FOCUSER_STATUS_temperature) ? status.temperature : NAN;
+    TemperatureN[0].value = isnan(temperature) ? 0 : temperature;
+    TemperatureNP.s = isnan(temperature) ? IPS_IDLE : IPS_OK;
+
+    // A power cycled or freshly flashed device has no sequence loaded
+    lastTargetTicks = FocusAbsPosN[0].value;
+    devicePosition = FocusAbsPosN[0].value;
+    lastMoveDelta = 0;
+    sweepTargets.clear();
+    sweepNext = 0;
+    sweepActive = false;
 
+    stats.handshake.record(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
     return true;
 }
 
@@ -219,8 +390,13 @@ bool IpFocus::ISNewText (const char *dev, const char *name, char *texts[], char
         if(strcmp(name,"BACKLASH_APPROACH_SETTINGS")==0)
         {
             IUUpdateText(&AlwaysApproachDirectionP, texts, names, n);
+            int8_t strategy;
+            if (!backlashStrategyFromText(AlwaysApproachDirection[0].text, strlen(AlwaysApproachDirection[0].text), strategy))
+                DEBUGF(INDI::Logger::DBG_WARNING, "The focuser ignores an approach direction of %s, use CW, CCW or leave it blank",
+                       AlwaysApproachDirection[0].text);
             AlwaysApproachDirectionP.s = IPS_OK;
             IDSetText(&AlwaysApproachDirectionP, NULL);
+            UpdateKinematics(NULL);
             return true;
         }
         if(strcmp(name,"BACKLASH_STEPS_SETTINGS")==0)
@@ -228,6 +404,46 @@ bool IpFocus::ISNewText (const char *dev, const char *name, char *texts[], char
             IUUpdateText(&BacklashStepsP, texts, names, n);
             BacklashStepsP.s = IPS_OK;
             IDSetText(&BacklashStepsP, NULL);
+            UpdateKinematics(NULL);
+            return true;
+        }
+        if(strcmp(name,"POWEROFF_ENDPOINT")==0 || strcmp(name,"POWERON_ENDPOINT")==0)
+        {
+            ITextVectorProperty *property = strcmp(name,"POWEROFF_ENDPOINT")==0 ? &PowerOffEndpointP : &PowerOnEndpointP;
+            IUUpdateText(property, texts, names, n);
+            CopyPowerEndpoints();
+            property->s = IPS_OK;
+            IDSetText(property, NULL);
+            return true;
+        }
+        if(strcmp(name,"STATS_FILE")==0)
+        {
+            IUUpdateText(&StatsFileTP, texts, names, n);
+            StatsFileTP.s = IPS_OK;
+            IDSetText(&StatsFileTP, NULL);
+            return true;
+        }
+        if(strcmp(name,"TRACE_FILE")==0)
+        {
+            IUUpdateText(&TraceFileTP, texts, names, n);
+            TraceFileTP.s = IPS_IDLE;
+            trace.close();
+            if (TraceFileT[0].text[0])
+            {
+                TraceFileTP.s = trace.open(TraceFileT[0].text) ? IPS_OK : IPS_ALERT;
+                if (TraceFileTP.s == IPS_OK)
+                    DEBUGF(INDI::Logger::DBG_SESSION, "Tracing device exchanges to %s", TraceFileT[0].text);
+                else
+                    DEBUGF(INDI::Logger::DBG_ERROR, "Cannot write the trace to %s: %s", TraceFileT[0].text, strerror(errno));
+            }
+            IDSetText(&TraceFileTP, NULL);
+            return true;
+        }
+        if(strcmp(name,"FOCUS_SWEEP")==0)
+        {
+            IUUpdateText(&SweepSamplesP, texts, names, n);
+            SweepSamplesP.s = StartSweep(SweepSamplesT[0].text) ? IPS_BUSY : IPS_ALERT;
+            IDSetText(&SweepSamplesP, NULL);
             return true;
         }
 
@@ -236,6 +452,92 @@ bool IpFocus::ISNewText (const char *dev, const char *name, char *texts[], char
     return INDI::Focuser::ISNewText(dev,name,texts,names,n);
 }
 
+bool IpFocus::ISNewNumber (const char *dev, const char *name, double values[], char *names[], int n)
+{
+    if(strcmp(dev,getDeviceName())==0)
+    {
+        if(strcmp(name,"FOCUS_SWEEP_DWELL")==0)
+        {
+            IUUpdateNumber(&SweepDwellNP, values, names, n);
+            SweepDwellNP.s = IPS_OK;
+            IDSetNumber(&SweepDwellNP, NULL);
+            return true;
+        }
+        if(strcmp(name,"UDP_SETTINGS")==0)
+        {
+            IUUpdateNumber(&UdpPortNP, values, names, n);
+            UdpPortNP.s = IPS_OK;
+            IDSetNumber(&UdpPortNP, NULL);
+            DEBUG(INDI::Logger::DBG_SESSION, "The UDP port is used from the next connect");
+            return true;
+        }
+        if(strcmp(name,"FOCUS_TC_SETTINGS")==0)
+        {
+            IUUpdateNumber(&CompensationSettingsNP, values, names, n);
+            CompensationSettingsNP.s = IPS_OK;
+            IDSetNumber(&CompensationSettingsNP, NULL);
+            temperatureModel.setPriorSlope(CompensationSettingsN[1].value);
+            PublishCompensationModel();
+            Compensate();
+            return true;
+        }
+    }
+
+    return INDI::Focuser::ISNewNumber(dev,name,values,names,n);
+}
+
+bool IpFocus::ISNewSwitch (const char *dev, const char *name, ISState *states, char *names[], int n)
+{
+    if(strcmp(dev,getDeviceName())==0)
+    {
+        if(strcmp(name,"STATS_ACTION")==0)
+        {
+            IUUpdateSwitch(&StatsActionSP, states, names, n);
+            int action = IUFindOnSwitchIndex(&StatsActionSP);
+            StatsActionSP.s = IPS_OK;
+            if (action == 0)
+                StatsActionSP.s = DumpStats() ? IPS_OK : IPS_ALERT;
+            else if (action == 1)
+            {
+                stats.reset();
+                PublishStats(true);
+            }
+            StatsActionS[0].s = StatsActionS[1].s = ISS_OFF;
+            IDSetSwitch(&StatsActionSP, NULL);
+            return true;
+        }
+        if(strcmp(name,"FOCUS_TC")==0)
+        {
+            IUUpdateSwitch(&CompensationSP, states, names, n);
+            CompensationSP.s = CompensationS[0].s == ISS_ON ? IPS_OK : IPS_IDLE;
+            IDSetSwitch(&CompensationSP, NULL);
+            Compensate();
+            return true;
+        }
+        if(strcmp(name,"FOCUS_TC_SAMPLE")==0)
+        {
+            CompensationSampleS[0].s = ISS_OFF;
+            CompensationSampleSP.s = IPS_ALERT;
+            if (isnan(temperature))
+                DEBUG(INDI::Logger::DBG_ERROR, "No temperature to go with the autofocus result, is a thermistor connected?");
+            else if (moveInProgress)
+                DEBUG(INDI::Logger::DBG_ERROR, "Report the autofocus result once the focuser has stopped");
+            else
+            {
+                temperatureModel.observe(FocusAbsPosN[0].value, temperature);
+                CompensationSampleSP.s = IPS_OK;
+                DEBUGF(INDI::Logger::DBG_SESSION, "Best focus %.0f at %.1f C, slope now %.1f steps/C", FocusAbsPosN[0].value,
+                       temperature, temperatureModel.slope());
+                PublishCompensationModel();
+            }
+            IDSetSwitch(&CompensationSampleSP, NULL);
+            return true;
+        }
+    }
+
+    return INDI::Focuser::ISNewSwitch(dev,name,states,names,n);
+}
+
 IPState IpFocus::MoveFocuser(FocusDirection dir, int speed, uint16_t duration)
 {
     IDLog("REL-MOVE Speed: %i\n", speed);
@@ -245,64 +547,869 @@ IPState IpFocus::MoveFocuser(FocusDirection dir, int speed, uint16_t duration)
 
 IPState IpFocus::MoveAbsFocuser(uint32_t targetTicks)
 {
-    DEBUGF(INDI::Logger::DBG_SESSION, "Focuser is moving to requested position %ld", targetTicks);
-    DEBUGF(INDI::Logger::DBG_DEBUG, "Current Ticks: %.f Target Ticks: %ld", FocusAbsPosN[0].value, targetTicks);
+    DEBUGF(INDI::Logger::DBG_SESSION, "Focuser is moving to requested position %u", targetTicks);
+    DEBUGF(INDI::Logger::DBG_DEBUG, "Current Ticks: %.f Target Ticks: %u", FocusAbsPosN[0].value, targetTicks);
 
-    // //holy crap is it really this hard to build a string in c++
-    std::string queryStringPosn = "?absolutePosition=";
-    std::string queryStringBacklash = "&amp;backlashSteps=";
-    std::string queryStringApproachDir = "&amp;alwaysApproach=";
-    auto str = APIEndPoint + queryStringPosn + std::to_string(targetTicks) + queryStringBacklash + BacklashSteps[0].text + queryStringApproachDir + AlwaysApproachDirection[0].text;
-    char* getRequestUrl = new char[str.size() + 1];  // +1 char for '\0' terminator
-    strcpy(getRequestUrl, str.c_str());
-    //end holy crap!!!!
+    if (sweepActive)
+    {
+        DEBUG(INDI::Logger::DBG_SESSION, "Sweep abandoned for a requested move");
+        EndSweep(IPS_ALERT);
+    }
+    FocuserUrl url;
+    MoveUrl(targetTicks, url);
+    return QueueMove(targetTicks, url);
+}
 
-    bool result = SendGetRequest(getRequestUrl);
-    if (result == false) {
-       PowerCycle();
-       result = SendGetRequest(getRequestUrl);
+/**
+ * Hand a move to the I/O worker. Any move but a temperature compensation one is a position chosen at the current
+ * temperature, which compensation then works from.
+**/
+IPState IpFocus::QueueMove(uint32_t targetTicks, const FocuserUrl &url, bool compensation)
+{
+    // A move queued behind a running one starts from wherever that one gets to, it is predicted but not learned from.
+    uint32_t from = moveInProgress ? lastTargetTicks : FocusAbsPosN[0].value;
+    MoveCommand command;
+    command.id = lastMoveId + 1;
+    command.targetTicks = targetTicks;
+    command.url = url;
+    // SequenceUrl leaves the first target as the one just loaded, moving to any later one goes past it
+    command.loadsSequence = sweepNext == 1 && !sweepTargets.empty() && sweepTargets[0] == targetTicks;
+    command.timeoutSeconds = motionModel.timeoutSeconds(from, targetTicks);
+    // Sent like the HTTP move sends them, a blank setting keeps what the device has. Read here rather than on the
+    // worker, which must not touch the properties the INDI thread updates.
+    int backlash = atoi(BacklashSteps[0].text);
+    command.backlashSteps = BacklashSteps[0].text[0] && backlash >= 0 ? backlash : UDP_KEEP;
+    command.backlashStrategy = UDP_KEEP_STRATEGY;
+    backlashStrategyFromText(AlwaysApproachDirection[0].text, strlen(AlwaysApproachDirection[0].text),
+                             command.backlashStrategy);
+    if (!commandQueue.push(command))
+    {
+        DEBUG(INDI::Logger::DBG_ERROR, "Focuser command queue is full, move rejected");
+        return IPS_ALERT;
+    }
+    lastMoveFromRest = !moveInProgress;
+    lastMoveModelled = motionModel.modelSeconds(from, targetTicks);
+    lastMovePredicted = motionModel.predictSeconds(from, targetTicks);
+    lastMoveQueued = std::chrono::steady_clock::now();
+    MotionPlan plan;
+    motionModel.plan(from, targetTicks, plan);
+    std::string segments;
+    for (uint8_t i = 0; i < plan.count; i++)
+        segments += (i ? ", " : "") + std::to_string(plan.segments[i].steps) + (plan.segments[i].direction > 0 ? " CW" : " CCW");
+    motionModel.planned(from, targetTicks);
+    DEBUGF(INDI::Logger::DBG_DEBUG, "Move from %u to %u planned as %s motor steps, predicted to take %.1f s, timeout %.1f s",
+           from, targetTicks, segments.empty() ? "no" : segments.c_str(), lastMovePredicted, command.timeoutSeconds);
+    lastMoveId = command.id;
+    lastTargetTicks = targetTicks;
+    moveInProgress = true;
+    if (!compensation && !isnan(temperature))
+        temperatureModel.anchor(targetTicks, temperature);
+    else if (!compensation)
+        temperatureModel.clearAnchor();
+    EtaN[0].value = lastMovePredicted;
+    EtaNP.s = IPS_BUSY;
+    IDSetNumber(&EtaNP, NULL);
+    {
+        // Taking the lock before notifying means the worker cannot miss the wakeup between its empty check and its wait.
+        std::lock_guard<std::mutex> lock(workerMutex);
     }
-    FocusAbsPosN[0].value = targetTicks; //IMPROVEMENT: Parse the json and grab the real value returned from the arduino device    
+    workerWakeup.notify_one();
 
-    return result ? IPS_OK : IPS_ALERT;
+    return IPS_BUSY;
+}
 
+/**
+ * Autofocus sweeps step in equal increments. When two moves in a row cover the same distance the next samples are loaded
+ * into the device as a move sequence, so it takes up backlash once for the sweep rather than overshooting on every CW
+ * sample. Moves to the loaded samples are sent as plain moves, which the device runs as legs of the sequence, and a move
+ * anywhere else ends it on both sides. Dropping a superseded command does no harm, the device skips ahead to any later
+ * sample of the sequence.
+**/
+void IpFocus::MoveUrl(uint32_t targetTicks, FocuserUrl &url)
+{
+    int64_t delta = (int64_t)targetTicks - lastTargetTicks;
+    bool sweep = delta != 0 && delta == lastMoveDelta;
+    lastMoveDelta = delta;
+
+    for (size_t i = sweepNext; i < sweepTargets.size(); i++)
+    {
+        if (sweepTargets[i] == targetTicks)
+        {
+            sweepNext = i + 1;
+            buildMoveUrl(url, client.endpoint(), targetTicks, BacklashSteps[0].text, AlwaysApproachDirection[0].text);
+            return;
+        }
+    }
+    sweepTargets.clear();
+    sweepNext = 0;
+    if (!sweep)
+    {
+        buildMoveUrl(url, client.endpoint(), targetTicks, BacklashSteps[0].text, AlwaysApproachDirection[0].text);
+        return;
+    }
+
+    // The device ignores positions of 0 and below
+    for (int64_t ticks = targetTicks; sweepTargets.size() < SWEEP_SEQUENCE_LENGTH && ticks > 0 &&
+         ticks >= FocusAbsPosN[0].min && ticks <= FocusAbsPosN[0].max; ticks += delta)
+        sweepTargets.push_back(ticks);
+    if (sweepTargets.size() < 2)
+    {
+        sweepTargets.clear();
+        buildMoveUrl(url, client.endpoint(), targetTicks, BacklashSteps[0].text, AlwaysApproachDirection[0].text);
+        return;
+    }
+    DEBUGF(INDI::Logger::DBG_DEBUG, "Sweep in steps of %lld detected, loading %zu samples from %u", (long long)delta,
+           sweepTargets.size(), targetTicks);
+    std::vector<uint32_t> targets;
+    targets.swap(sweepTargets);
+    SequenceUrl(targets.data(), targets.size(), url);
 }
 
 /**
- * Power cycle the device if possible. This is a workaround for some instability of the focuser device (some wierd arduino bug)
+ * Load targets into the device as a move sequence, moving to the first.
 **/
-void IpFocus::PowerCycle() {
-    DEBUG(INDI::Logger::DBG_SESSION, "***** POWER CYCLE ******");
-    SendGetRequest(PowerOffEndpointT[0].text);
-    sleep(3);
-    SendGetRequest(PowerOnEndpointT[0].text);
-    sleep(12);
-    DEBUG(INDI::Logger::DBG_SESSION, "*** POWER CYCLE FINSIHED***");
+void IpFocus::SequenceUrl(const uint32_t *targets, size_t count, FocuserUrl &url)
+{
+    if (count > SWEEP_SEQUENCE_LENGTH)
+        count = SWEEP_SEQUENCE_LENGTH;
+    sweepTargets.assign(targets, targets + count);
+    sweepNext = 1;
+    buildSequenceUrl(url, client.endpoint(), targets, count, BacklashSteps[0].text);
 }
 
-bool IpFocus::SendGetRequest(const char *path) {
-    CURL *curl;
-    CURLcode res;
-    curl = curl_easy_init();
-    if(curl)
-    {
-        DEBUGF(INDI::Logger::DBG_DEBUG, "Performing request %s", path);
-        curl_easy_setopt(curl, CURLOPT_URL, path);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 40L);
-        res = curl_easy_perform(curl);
-        if(res != CURLE_OK)
+/**
+ * Parse a comma or space separated list of sample positions, plan the sweep and move to the first sample. The sweep then
+ * runs from TimerHit: after reaching each sample it waits the dwell time before moving to the next.
+**/
+bool IpFocus::StartSweep(const char *text)
+{
+    std::vector<uint32_t> samples;
+    const char *s = text;
+    while (*s)
+    {
+        char *end;
+        long position = strtol(s, &end, 10);
+        if (end == s)
+        {
+            if (*s != ',' && *s != ' ')
+            {
+                DEBUGF(INDI::Logger::DBG_ERROR, "Sweep samples must be a list of positions: %s", text);
+                return false;
+            }
+            s++;
+            continue;
+        }
+        if (position < FocusAbsPosN[0].min || position > FocusAbsPosN[0].max || position <= 0)
+        {
+            DEBUGF(INDI::Logger::DBG_ERROR, "Sweep sample %ld is out of range", position);
+            return false;
+        }
+        samples.push_back(position);
+        s = end;
+    }
+    if (samples.empty())
+    {
+        DEBUG(INDI::Logger::DBG_ERROR, "No sweep samples given");
+        return false;
+    }
+
+    uint32_t position = moveInProgress ? lastTargetTicks : FocusAbsPosN[0].value;
+    sweepPlan = planSweep(samples, position, motionModel, motionModel.getKinematics().backlashStrategy);
+    double dwell = SweepDwellN[0].value * (sweepPlan.samples.size() - 1);
+    SweepTimeN[0].value = sweepPlan.plannedSeconds + dwell;
+    SweepTimeN[1].value = 0;
+    SweepTimeN[2].value = sweepPlan.givenOrderSeconds + SweepDwellN[0].value * (samples.size() - 1);
+    SweepTimeNP.s = IPS_BUSY;
+    IDSetNumber(&SweepTimeNP, NULL);
+    DEBUGF(INDI::Logger::DBG_SESSION, "Sweeping %zu samples from %u to %u, predicted %.1f s, %.1f s in the given order",
+           sweepPlan.samples.size(), sweepPlan.samples.front(), sweepPlan.samples.back(), SweepTimeN[0].value,
+           SweepTimeN[2].value);
+
+    sweepActive = true;
+    sweepIndex = 0;
+    sweepStart = std::chrono::steady_clock::now();
+    // The sequence is loaded here, later samples continue it, or load the next part of it when it runs out
+    FocuserUrl url;
+    SequenceUrl(sweepPlan.samples.data(), sweepPlan.samples.size(), url);
+    if (QueueMove(sweepPlan.samples[0], url) != IPS_BUSY)
+    {
+        EndSweep(IPS_ALERT);
+        return false;
+    }
+    sweepMoveId = lastMoveId;
+    FocusAbsPosNP.s = IPS_BUSY;
+    IDSetNumber(&FocusAbsPosNP, NULL);
+    return true;
+}
+
+/**
+ * Called from TimerHit when the move to the current sample is over.
+**/
+void IpFocus::SweepMoveFinished(bool ok)
+{
+    if (!ok)
+    {
+        DEBUGF(INDI::Logger::DBG_ERROR, "Sweep failed moving to sample %u", sweepPlan.samples[sweepIndex]);
+        EndSweep(IPS_ALERT);
+        return;
+    }
+    if (++sweepIndex == sweepPlan.samples.size())
+    {
+        EndSweep(IPS_OK);
+        return;
+    }
+    sweepDwellUntil = std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds((long long)(SweepDwellN[0].value * 1000));
+}
+
+void IpFocus::EndSweep(IPState state)
+{
+    sweepActive = false;
+    SweepTimeN[1].value = std::chrono::duration<double>(std::chrono::steady_clock::now() - sweepStart).count();
+    SweepTimeNP.s = state;
+    IDSetNumber(&SweepTimeNP, NULL);
+    SweepSamplesP.s = state;
+    IDSetText(&SweepSamplesP, NULL);
+    if (state == IPS_OK)
+        DEBUGF(INDI::Logger::DBG_SESSION, "Sweep done in %.1f s, predicted %.1f s", SweepTimeN[1].value, SweepTimeN[0].value);
+}
+
+/**
+ * Runs on the I/O worker. Send the move to the device, power cycling it and replaying the move if it does not answer.
+ * The device replies straight away and moves in the background, so follow it with status polls until it stops.
+ * Returns early, leaving the device moving, as soon as a newer command is queued.
+**/
+bool IpFocus::PerformMove(const MoveCommand &command)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::milliseconds((long long)(command.timeoutSeconds * 1000));
+    // No request may outlast the move's deadline, but each gets long enough to be answered
+    auto requestTimeout = [&deadline]() {
+        long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        return (long)(left < MIN_REQUEST_TIMEOUT_MS ? MIN_REQUEST_TIMEOUT_MS : left > REQUEST_TIMEOUT_MS ? REQUEST_TIMEOUT_MS : left);
+    };
+
+    FocuserStatus status;
+    bool result = false;
+    if (udp.isOpen() && !command.loadsSequence)
+    {
+        WorkerLog(INDI::Logger::DBG_DEBUG, "Sending UDP move to %u", command.targetTicks);
+        result = UdpRequest(UDP_MOVE, command.targetTicks, command.backlashSteps, command.backlashStrategy, status);
+    }
+    // Without UDP, or if the move went unanswered there, over HTTP. Sending it again is safe, moves are absolute.
+    if (!result)
+    {
+        WorkerLog(INDI::Logger::DBG_DEBUG, "Performing request %s", command.url.c_str());
+        result = client.request(command.url, status, requestTimeout());
+        // Only a device that does not answer is power cycled
+        if (!result && client.transportResult() != TRANSPORT_OK) {
+           LogClientError();
+           if (!RecoverDevice())
+               return false;
+           // Replay the move unless a newer one is waiting, which then starts from the restored position instead
+           if (!commandQueue.empty())
+           {
+               PublishMoveUpdate(command.id, devicePosition, true, true);
+               return true;
+           }
+           stats.count(COUNTER_RETRIES);
+           start = Clock::now();
+           deadline = start + std::chrono::milliseconds((long long)(command.timeoutSeconds * 1000));
+           result = client.request(command.url, status, requestTimeout());
+        }
+
+        // The move request answers with the full status, polls use the compact frame
+        if (!result)
+        {
+            LogClientError();
+            return false;
+        }
+    }
+    uint32_t position = command.targetTicks;
+    double seconds = 0;
+    while (result)
+    {
+        if (status.has(FOCUSER_STATUS_absolutePosition))
+            position = devicePosition = status.absolutePosition;
+        if (!status.has(FOCUSER_STATUS_moving) || !status.moving)
+        {
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            stats.move.record(seconds);
+            break;
+        }
+        if (Clock::now() >= deadline)
+        {
+            WorkerLog(INDI::Logger::DBG_ERROR, "Move to %u still running after %.1f s, expected to be done well before",
+                      command.targetTicks, command.timeoutSeconds);
+            stats.count(COUNTER_MOVE_TIMEOUTS);
+            return false;
+        }
+        PublishMoveUpdate(command.id, position, true, false);
+
+        std::unique_lock<std::mutex> lock(workerMutex);
+        if (workerWakeup.wait_for(lock, std::chrono::milliseconds(udp.isOpen() ? UDP_MOVE_POLL_MS : MOVE_POLL_MS),
+                                  [this] { return workerExit || !commandQueue.empty(); }))
+            break;
+        lock.unlock();
+        result = (udp.isOpen() && UdpPollStatus(status)) || PollStatus(status, requestTimeout());
+    }
+    if (result)
+        PublishMoveUpdate(command.id, position, true, true, seconds);
+    return result;
+}
+
+/**
+ * Runs on the I/O worker. Log why the last request on client failed: the device did not answer, or its answer did not
+ * decode.
+**/
+void IpFocus::LogClientError()
+{
+    WorkerLog(INDI::Logger::DBG_ERROR, client.transportResult() != TRANSPORT_OK ? "Comms failed.:%s" : "%s", client.error());
+}
+
+/**
+ * Poll the compact status frame into status, logging why if it fails.
+**/
+bool IpFocus::PollStatus(FocuserStatus &status, long timeoutMs)
+{
+    if (!client.poll(status, timeoutMs))
+    {
+        LogClientError();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Open the UDP channel if a port is set and the device answers a status request on it. Otherwise HTTP does everything.
+**/
+bool IpFocus::OpenUdp()
+{
+    udp.close();
+    uint16_t port = UdpPortN[0].value;
+    if (port == 0)
+        return false;
+    UdpStatus reply;
+    if (!udp.open(tcpConnection->host(), port) || !udp.request(UDP_STATUS, 0, UDP_KEEP, UDP_KEEP_STRATEGY, reply, UDP_ATTEMPTS))
+    {
+        DEBUGF(INDI::Logger::DBG_SESSION, "No answer on UDP port %u, using HTTP only", port);
+        udp.close();
+        return false;
+    }
+    DEBUGF(INDI::Logger::DBG_SESSION, "Polling and moving over UDP port %u", port);
+    return true;
+}
+
+/**
+ * Send a command over UDP and decode its reply into status. If it goes unanswered UDP is closed, until the next
+ * connect, and the caller falls back to HTTP.
+**/
+bool IpFocus::UdpRequest(uint8_t type, uint32_t targetTicks, uint16_t backlashSteps, int8_t strategy,
+                         FocuserStatus &status)
+{
+    UdpStatus reply;
+    uint32_t resends = udp.resends();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok = udp.request(type, targetTicks, backlashSteps, strategy, reply, UDP_ATTEMPTS);
+    if (trace.isOpen())
+    {
+        // Sequence numbers are left out, a replay numbers its commands afresh
+        UdpCommand command = {type, 0, (uint16_t)targetTicks, backlashSteps, strategy};
+        uint8_t commandFrame[UDP_MOVE_STRATEGY_SIZE];
+        uint8_t replyFrame[UDP_STATUS_SIZE];
+        reply.seq = 0;
+        trace.record(TRACE_UDP, ok ? TRACE_OK : TRACE_TIMEOUT, start, std::chrono::steady_clock::now(), 0, commandFrame,
+                     encodeUdpCommand(command, commandFrame), replyFrame, ok ? encodeUdpStatus(reply, replyFrame) : 0);
+    }
+    stats.count(COUNTER_REQUESTS);
+    stats.count(COUNTER_RETRIES, udp.resends() - resends);
+    if (!ok)
+    {
+        WorkerLog(INDI::Logger::DBG_SESSION, "Focuser stopped answering on UDP, falling back to HTTP");
+        stats.count(COUNTER_REQUEST_FAILURES);
+        stats.count(COUNTER_TIMEOUTS);
+        stats.count(COUNTER_UDP_FALLBACKS);
+        udp.close();
+        return false;
+    }
+    stats.udpRequest.record(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    udpStatusToFocuserStatus(reply, &status);
+    return true;
+}
+
+/**
+ * Move progress over UDP: the latest telemetry if it is recent, otherwise a status request.
+**/
+bool IpFocus::UdpPollStatus(FocuserStatus &status)
+{
+    UdpStatus telemetry;
+    if (udp.telemetry(telemetry, UDP_TELEMETRY_MAX_AGE_MS))
+    {
+        udpStatusToFocuserStatus(telemetry, &status);
+        return true;
+    }
+    return UdpRequest(UDP_STATUS, 0, UDP_KEEP, UDP_KEEP_STRATEGY, status);
+}
+
+void IpFocus::PublishMoveUpdate(uint32_t id, uint32_t position, bool ok, bool finished, double seconds)
+{
+    WorkerUpdate update;
+    update.seconds = seconds;
+    update.id = id;
+    update.position = position;
+    update.ok = ok;
+    update.finished = finished;
+    update.message[0] = '\0';
+    PushUpdate(update);
+}
+
+/**
+ * Runs on the I/O worker. The INDI logger may only be used from the INDI thread, so the line goes to TimerHit, after
+ * any move progress published before it.
+**/
+void IpFocus::WorkerLog(INDI::Logger::VerbosityLevel level, const char *format, ...)
+{
+    WorkerUpdate update;
+    update.level = level;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(update.message, sizeof(update.message), format, args);
+    va_end(args);
+    PushUpdate(update);
+}
+
+void IpFocus::PushUpdate(const WorkerUpdate &update)
+{
+    if (!updateQueue.push(update))
+        droppedUpdates++;
+}
+
+/**
+ * Collect move progress from the I/O worker and publish it. Runs on the INDI event loop.
+**/
+void IpFocus::TimerHit()
+{
+    if (!isConnected())
+        return;
+
+    WorkerUpdate update;
+    while (updateQueue.pop(update))
+    {
+        if (update.message[0])
+        {
+            DEBUGF(update.level, "%s", update.message);
+            continue;
+        }
+        if (update.ok)
+            FocusAbsPosN[0].value = update.position;
+        // An update for a superseded move only updates the position, the latest request decides the final state.
+        if (update.finished && update.id == lastMoveId)
         {
-            DEBUGF(INDI::Logger::DBG_ERROR, "Comms failed.:%s",curl_easy_strerror(res));
+            moveInProgress = false;
+            FocusAbsPosNP.s = update.ok ? IPS_OK : IPS_ALERT;
+            FocusRelPosNP.s = FocusAbsPosNP.s;
+            IDSetNumber(&FocusRelPosNP, NULL);
+            if (update.ok && update.seconds > 0 && lastMoveFromRest)
+            {
+                motionModel.observe(lastMoveModelled, update.seconds);
+                DEBUGF(INDI::Logger::DBG_DEBUG, "Move took %.1f s, predicted %.1f s", update.seconds, lastMovePredicted);
+            }
+            EtaN[0].value = 0;
+            EtaNP.s = update.ok ? IPS_OK : IPS_ALERT;
+            IDSetNumber(&EtaNP, NULL);
+            if (sweepActive && update.id == sweepMoveId)
+                SweepMoveFinished(update.ok);
+        }
+        IDSetNumber(&FocusAbsPosNP, NULL);
+    }
+
+    uint32_t dropped = droppedUpdates.exchange(0);
+    if (dropped)
+        DEBUGF(INDI::Logger::DBG_ERROR, "Focuser update queue was full, %u updates dropped", dropped);
+
+    double celsius;
+    while (temperatureQueue.pop(celsius))
+        SetTemperature(celsius);
+
+    if (moveInProgress)
+    {
+        double left = lastMovePredicted - std::chrono::duration<double>(std::chrono::steady_clock::now() - lastMoveQueued).count();
+        EtaN[0].value = left > 0 ? left : 0;
+        IDSetNumber(&EtaNP, NULL);
+    }
+
+    if (sweepActive && !moveInProgress && lastMoveId == sweepMoveId && std::chrono::steady_clock::now() >= sweepDwellUntil)
+    {
+        uint32_t sample = sweepPlan.samples[sweepIndex];
+        bool loaded = std::find(sweepTargets.begin() + sweepNext, sweepTargets.end(), sample) != sweepTargets.end();
+        FocuserUrl url;
+        if (loaded)
+            MoveUrl(sample, url);
+        else
+            SequenceUrl(&sweepPlan.samples[sweepIndex], sweepPlan.samples.size() - sweepIndex, url);
+        if (QueueMove(sample, url) == IPS_BUSY)
+        {
+            sweepMoveId = lastMoveId;
+            FocusAbsPosNP.s = IPS_BUSY;
+            IDSetNumber(&FocusAbsPosNP, NULL);
+        }
+        else
+            EndSweep(IPS_ALERT);
+    }
+
+    if (std::chrono::steady_clock::now() - statsPublished >= std::chrono::milliseconds(STATS_PUBLISH_MS))
+        PublishStats();
+
+    SetTimer(COMPLETION_POLL_MS);
+}
+
+void IpFocus::FillHistogramProperty(INumberVectorProperty *property, INumber *numbers, const char *name, const char *label,
+                                    const char *unit)
+{
+    static const char *elements[][2] = { { "COUNT", "Count" }, { "P50", "Median" }, { "P90", "90th percentile" },
+                                         { "P99", "99th percentile" }, { "MAX", "Max" } };
+    for (int i = 0; i < 5; i++)
+    {
+        char elementLabel[64];
+        snprintf(elementLabel, sizeof(elementLabel), i ? "%s (%s)" : "%s", elements[i][1], unit);
+        IUFillNumber(&numbers[i], elements[i][0], elementLabel, i ? "%.1f" : "%.0f", 0, 1e9, 0, 0);
+    }
+    IUFillNumberVector(property, numbers, 5, getDeviceName(), name, label, STATS_TAB, IP_RO, 0, IPS_IDLE);
+}
+
+void IpFocus::SetHistogramProperty(INumberVectorProperty *property, INumber *numbers, const LatencyHistogram &histogram,
+                                   double scale)
+{
+    numbers[0].value = histogram.count();
+    numbers[1].value = histogram.percentile(0.5) * scale;
+    numbers[2].value = histogram.percentile(0.9) * scale;
+    numbers[3].value = histogram.percentile(0.99) * scale;
+    numbers[4].value = histogram.max() * scale;
+    property->s = IPS_OK;
+    IDSetNumber(property, NULL);
+}
+
+/**
+ * Send the statistics to clients, unless nothing was recorded since they were last sent or force is set. Runs on the INDI
+ * event loop.
+**/
+void IpFocus::PublishStats(bool force)
+{
+    statsPublished = std::chrono::steady_clock::now();
+    uint64_t total = stats.httpRequest.count() + stats.udpRequest.count() + stats.move.count() + stats.handshake.count();
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        total += CountersN[i].value = stats.get((FocuserCounter)i);
+    if (total == statsPublishedTotal && !force)
+        return;
+    statsPublishedTotal = total;
+    SetHistogramProperty(&HttpLatencyNP, HttpLatencyN, stats.httpRequest, 1000);
+    SetHistogramProperty(&UdpLatencyNP, UdpLatencyN, stats.udpRequest, 1000);
+    SetHistogramProperty(&MoveDurationNP, MoveDurationN, stats.move, 1);
+    SetHistogramProperty(&HandshakeTimeNP, HandshakeTimeN, stats.handshake, 1000);
+    CountersNP.s = IPS_OK;
+    IDSetNumber(&CountersNP, NULL);
+}
+
+/**
+ * Append the statistics to the file set on the statistics tab.
+**/
+bool IpFocus::DumpStats()
+{
+    if (!StatsFileT[0].text[0])
+    {
+        DEBUG(INDI::Logger::DBG_ERROR, "Set a file to dump the statistics to");
+        return false;
+    }
+    FILE *fp = fopen(StatsFileT[0].text, "a");
+    if (!fp)
+    {
+        DEBUGF(INDI::Logger::DBG_ERROR, "Cannot open %s: %s", StatsFileT[0].text, strerror(errno));
+        return false;
+    }
+    bool ok = stats.writeJson(fp);
+    ok = fclose(fp) == 0 && ok;
+    if (!ok)
+        DEBUGF(INDI::Logger::DBG_ERROR, "Writing statistics to %s failed", StatsFileT[0].text);
+    else
+        DEBUGF(INDI::Logger::DBG_DEBUG, "Statistics appended to %s", StatsFileT[0].text);
+    return ok;
+}
+
+/**
+ * Runs on the I/O worker while it is idle. Read the full status for its temperature, polls during moves use the compact
+ * frame, which has none.
+**/
+void IpFocus::PollTemperature()
+{
+    FocuserStatus status;
+    if (!client.status(status, MIN_REQUEST_TIMEOUT_MS))
+    {
+        LogClientError();
+        return;
+    }
+    if (!temperatureQueue.push(status.has(FOCUSER_STATUS_temperature) ? status.temperature : NAN))
+        WorkerLog(INDI::Logger::DBG_DEBUG, "Temperature queue is full, reading dropped");
+}
+
+/**
+ * A new temperature from the device, NAN if it has none.
+**/
+void IpFocus::SetTemperature(double celsius)
+{
+    if (isnan(celsius) != isnan(temperature))
+        DEBUG(INDI::Logger::DBG_SESSION, isnan(celsius) ? "The focuser stopped reporting a temperature" : "The focuser reports a temperature");
+    temperature = celsius;
+    TemperatureN[0].value = isnan(celsius) ? 0 : celsius;
+    TemperatureNP.s = isnan(celsius) ? IPS_IDLE : IPS_OK;
+    IDSetNumber(&TemperatureNP, NULL);
+    Compensate();
+}
+
+/**
+ * Hysteresis for temperature compensation. The drift the model predicts since the last position chosen is left alone
+ * until it reaches TC_STEP steps, then corrected in one move, so the focuser does not creep a few steps at a time and
+ * backlash is taken up once per correction. Nothing moves while a move or sweep runs, or without an anchor.
+**/
+void IpFocus::Compensate()
+{
+    if (isnan(temperature) || !temperatureModel.hasAnchor())
+    {
+        CompensationModelN[3].value = 0;
+        PublishCompensationModel();
+        return;
+    }
+    double target = round(temperatureModel.predict(temperature));
+    target = std::max((double)FocusAbsPosN[0].min, std::min((double)FocusAbsPosN[0].max, target));
+    double drift = target - (moveInProgress ? lastTargetTicks : FocusAbsPosN[0].value);
+    CompensationModelN[3].value = drift;
+    PublishCompensationModel();
+    if (CompensationS[0].s != ISS_ON || moveInProgress || sweepActive || fabs(drift) < CompensationSettingsN[0].value)
+        return;
+
+    DEBUGF(INDI::Logger::DBG_SESSION, "Compensating %+.0f steps for %.1f C", drift, temperature);
+    // A correction is not part of a sweep, and must not look like one to sweep detection
+    lastMoveDelta = 0;
+    sweepTargets.clear();
+    sweepNext = 0;
+    uint32_t targetTicks = target;
+    FocuserUrl url;
+    buildMoveUrl(url, client.endpoint(), targetTicks, BacklashSteps[0].text, AlwaysApproachDirection[0].text);
+    if (QueueMove(targetTicks, url, true) == IPS_BUSY)
+    {
+        FocusAbsPosNP.s = IPS_BUSY;
+        IDSetNumber(&FocusAbsPosNP, NULL);
+    }
+}
+
+void IpFocus::PublishCompensationModel()
+{
+    CompensationModelN[0].value = temperatureModel.slope();
+    CompensationModelN[1].value = temperatureModel.observations();
+    CompensationModelN[2].value = temperatureModel.temperatureSpread();
+    CompensationModelNP.s = temperatureModel.hasAnchor() ? IPS_OK : IPS_IDLE;
+    IDSetNumber(&CompensationModelNP, NULL);
+}
+
+void IpFocus::StartWorker()
+{
+    MoveCommand staleCommand;
+    while (commandQueue.pop(staleCommand));
+    WorkerUpdate staleUpdate;
+    while (updateQueue.pop(staleUpdate));
+    droppedUpdates = 0;
+    double staleTemperature;
+    while (temperatureQueue.pop(staleTemperature));
+    moveInProgress = false;
+
+    workerExit = false;
+    worker = std::thread(&IpFocus::WorkerLoop, this);
+}
+
+void IpFocus::StopWorker()
+{
+    if (!worker.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        workerExit = true;
+    }
+    workerWakeup.notify_one();
+    worker.join();
+}
+
+/**
+ * I/O worker. Drains the command queue, collapses queued moves into the latest target and performs it. Reads the
+ * temperature when it has been idle for TEMPERATURE_POLL_MS.
+**/
+void IpFocus::WorkerLoop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(workerMutex);
+            if (!workerWakeup.wait_for(lock, std::chrono::milliseconds(TEMPERATURE_POLL_MS),
+                                       [this] { return workerExit || !commandQueue.empty(); }))
+            {
+                lock.unlock();
+                PollTemperature();
+                continue;
+            }
+        }
+        if (workerExit)
+            return;
+
+        MoveCommand command;
+        MoveCommand latest;
+        bool haveCommand = false;
+        while (commandQueue.pop(command))
+        {
+            if (haveCommand)
+                WorkerLog(INDI::Logger::DBG_DEBUG, "Dropping superseded move to %u", latest.targetTicks);
+            latest = command;
+            haveCommand = true;
+        }
+        if (!haveCommand)
+            continue;
+
+        if (!PerformMove(latest))
+            PublishMoveUpdate(latest.id, latest.targetTicks, false, true);
+    }
+}
+
+/**
+ * Runs on the I/O worker when the device stops answering. Power cycle it, a workaround for some instability of the focuser
+ * device (some wierd arduino bug), then probe until it has booted, with backoff so a quick boot is noticed quickly.
+ * The device comes back at its default position, so it is told where it really is before anything else.
+ * Returns false if it did not come back or the worker is exiting.
+**/
+bool IpFocus::RecoverDevice()
+{
+    WorkerLog(INDI::Logger::DBG_SESSION, "***** POWER CYCLE ******");
+    stats.count(COUNTER_POWER_CYCLES);
+    PowerRecovery recovery;
+    FocuserStatus status;
+    recovery.begin(PowerRecovery::Clock::now());
+    while (recovery.step() != PowerRecovery::DONE)
+    {
+        if (recovery.step() == PowerRecovery::FAILED)
+        {
+            WorkerLog(INDI::Logger::DBG_ERROR, "Focuser did not answer within %d probes after power on", recovery.probes());
+            stats.count(COUNTER_RECOVERY_FAILURES);
+            return false;
+        }
+        if (!WaitUntil(recovery.due()))
             return false;
+        bool ok = false;
+        switch (recovery.step())
+        {
+        case PowerRecovery::POWER_OFF:
+            ok = SendGetRequest(PowerEndpoint(false).c_str());
+            break;
+        case PowerRecovery::POWER_ON:
+            ok = SendGetRequest(PowerEndpoint(true).c_str());
+            break;
+        case PowerRecovery::PROBE:
+            ok = client.status(status, PROBE_TIMEOUT_MS);
+            if (!ok && client.transportResult() != TRANSPORT_OK)
+                LogClientError();
+            break;
+        default:
+            break;
         }
-        curl_easy_cleanup(curl);
+        recovery.completed(ok, PowerRecovery::Clock::now());
+    }
+    WorkerLog(INDI::Logger::DBG_SESSION, "*** POWER CYCLE FINISHED, focuser booted in %.1f s ***", recovery.bootSeconds());
+
+    // Firmware with the position journal comes back where it last stopped, which is where the focuser is
+    if (status.has(FOCUSER_STATUS_absolutePosition) && status.has(FOCUSER_STATUS_positionRestored) &&
+        status.positionRestored)
+    {
+        if ((uint32_t)status.absolutePosition != devicePosition)
+            WorkerLog(INDI::Logger::DBG_SESSION, "Focuser restored position %d, last seen at %u while moving",
+                      status.absolutePosition, devicePosition);
+        devicePosition = status.absolutePosition;
+        return true;
+    }
+    // Otherwise it is at its default position, tell it where it really is
+    if (status.has(FOCUSER_STATUS_absolutePosition) && (uint32_t)status.absolutePosition != devicePosition)
+    {
+        WorkerLog(INDI::Logger::DBG_DEBUG, "Syncing the focuser to %u", devicePosition);
+        if (!client.sync(devicePosition, REQUEST_TIMEOUT_MS))
+        {
+            LogClientError();
+            stats.count(COUNTER_RECOVERY_FAILURES);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Give the worker its own copy of the power switch URLs, which the INDI thread may change while it power cycles.
+**/
+void IpFocus::CopyPowerEndpoints()
+{
+    std::lock_guard<std::mutex> lock(workerMutex);
+    powerOffEndpoint = PowerOffEndpointT[0].text;
+    powerOnEndpoint = PowerOnEndpointT[0].text;
+}
+
+/**
+ * Runs on the I/O worker. The URL that switches the focuser's power off or on.
+**/
+std::string IpFocus::PowerEndpoint(bool on)
+{
+    std::lock_guard<std::mutex> lock(workerMutex);
+    return on ? powerOnEndpoint : powerOffEndpoint;
+}
+
+/**
+ * Sleep on the worker until time, waking early only to exit. Returns false if the worker is exiting.
+**/
+bool IpFocus::WaitUntil(std::chrono::steady_clock::time_point time)
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    return !workerWakeup.wait_until(lock, time, [this] { return workerExit.load(); });
+}
+
+/**
+ * Feed the motion model what the device moves with, from a status response and the backlash setting. status may be NULL.
+**/
+void IpFocus::UpdateKinematics(const FocuserStatus *status)
+{
+    FocuserKinematics kinematics = motionModel.getKinematics();
+    if (status && status->has(FOCUSER_STATUS_speed))
+        kinematics.speed = status->speed;
+    if (status && status->has(FOCUSER_STATUS_maxSpeed))
+        kinematics.backlashSpeed = status->maxSpeed;
+    if (status && status->has(FOCUSER_STATUS_acceleration))
+        kinematics.acceleration = status->acceleration;
+    if (status && status->has(FOCUSER_STATUS_gearBoxMultiplier))
+        kinematics.gearBoxMultiplier = status->gearBoxMultiplier;
+    kinematics.backlashSteps = atoi(BacklashSteps[0].text);
+    // A direction the device does not understand leaves it with the strategy it had
+    int8_t strategy;
+    if (backlashStrategyFromText(AlwaysApproachDirection[0].text, strlen(AlwaysApproachDirection[0].text), strategy))
+        kinematics.backlashStrategy = strategy;
+    motionModel.setKinematics(kinematics);
+}
+
+bool IpFocus::SendGetRequest(const char *path) {
+    WorkerLog(INDI::Logger::DBG_DEBUG, "Performing request %s", path);
+    if (!client.get(path, POWER_REQUEST_TIMEOUT_MS))
+    {
+        LogClientError();
+        return false;
     }
     return true;
 }
 
 IPState IpFocus::MoveRelFocuser(FocusDirection dir, uint32_t ticks)
 {
-    uint32_t targetTicks = FocusAbsPosN[0].value + (ticks * (dir == FOCUS_INWARD ? -1 : 1));
+    // While a move is still running, step relative to where it is going rather than where it started.
+    uint32_t currentTicks = moveInProgress ? lastTargetTicks : FocusAbsPosN[0].value;
+    uint32_t targetTicks = currentTicks + (ticks * (dir == FOCUS_INWARD ? -1 : 1));
 
     FocusAbsPosNP.s = IPS_BUSY;
     IDSetNumber(&FocusAbsPosNP, NULL);
@@ -317,6 +1424,12 @@ bool IpFocus::saveConfigItems(FILE *fp)
     IUSaveConfigText(fp, &AlwaysApproachDirectionP);
     IUSaveConfigText(fp, &PowerOffEndpointP);
     IUSaveConfigText(fp, &PowerOnEndpointP);
+    IUSaveConfigNumber(fp, &SweepDwellNP);
+    IUSaveConfigNumber(fp, &UdpPortNP);
+    IUSaveConfigText(fp, &StatsFileTP);
+    IUSaveConfigText(fp, &TraceFileTP);
+    IUSaveConfigSwitch(fp, &CompensationSP);
+    IUSaveConfigNumber(fp, &CompensationSettingsNP);
 
     return true;
 }
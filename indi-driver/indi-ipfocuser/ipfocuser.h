@@ -11,11 +11,37 @@ IP focuser based on the INDI focuser simulator
 #include <math.h>
 #include <sys/time.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "curlmulti.h"
+#include "curltransport.h"
+#include "focuserclient.h"
+#include "focuserstats.h"
+#include "focuserstatus.h"
+#include "focusersweep.h"
+#include "focusertrace.h"
+#include "motionmodel.h"
+#include "powerrecovery.h"
+#include "recordingtransport.h"
+#include "spscqueue.h"
+#include "temperaturemodel.h"
+#include "udptransport.h"
+
+// Longest line the worker logs, longer ones are cut short.
+#define WORKER_LOG_SIZE 200
+
 
 class IpFocus : public INDI::Focuser
 {
 public:
-    IpFocus();
+    // Requests run on transfers. name, when given, replaces the default device name.
+    IpFocus(CurlMulti &transfers, const char *name = NULL);
     virtual ~IpFocus();
 
     const char *getDefaultName();
@@ -26,7 +52,11 @@ public:
     bool Handshake();
 
     virtual bool ISNewText (const char *dev, const char *name, char *texts[], char *names[], int n);
+    virtual bool ISNewNumber (const char *dev, const char *name, double values[], char *names[], int n);
+    virtual bool ISNewSwitch (const char *dev, const char *name, ISState *states, char *names[], int n);
     virtual bool Connect();
+    virtual bool Disconnect();
+    virtual void TimerHit();
 
     virtual IPState MoveFocuser(FocusDirection dir, int speed, uint16_t duration);
     virtual IPState MoveAbsFocuser(uint32_t ticks);
@@ -46,9 +76,173 @@ private:
     IText PowerOffEndpointT[1];
     IText PowerOnEndpointT[1];
 
+    ITextVectorProperty SweepSamplesP;
+    IText SweepSamplesT[1];
+    INumberVectorProperty SweepDwellNP;
+    INumber SweepDwellN[1];
+    INumberVectorProperty SweepTimeNP;
+    INumber SweepTimeN[3];
+    INumberVectorProperty EtaNP;
+    INumber EtaN[1];
+    INumberVectorProperty UdpPortNP;
+    INumber UdpPortN[1];
+
+    // Statistics tab: count, p50, p90, p99 and max of each histogram, then the counters.
+    INumberVectorProperty HttpLatencyNP;
+    INumber HttpLatencyN[5];
+    INumberVectorProperty UdpLatencyNP;
+    INumber UdpLatencyN[5];
+    INumberVectorProperty MoveDurationNP;
+    INumber MoveDurationN[5];
+    INumberVectorProperty HandshakeTimeNP;
+    INumber HandshakeTimeN[5];
+    INumberVectorProperty CountersNP;
+    INumber CountersN[COUNTER_COUNT];
+    ITextVectorProperty StatsFileTP;
+    IText StatsFileT[1];
+    ISwitchVectorProperty StatsActionSP;
+    ISwitch StatsActionS[2];
+    ITextVectorProperty TraceFileTP;
+    IText TraceFileT[1];
+
+    INumberVectorProperty TemperatureNP;
+    INumber TemperatureN[1];
+    ISwitchVectorProperty CompensationSP;
+    ISwitch CompensationS[2];
+    INumberVectorProperty CompensationSettingsNP;
+    INumber CompensationSettingsN[2];
+    ISwitchVectorProperty CompensationSampleSP;
+    ISwitch CompensationSampleS[1];
+    INumberVectorProperty CompensationModelNP;
+    INumber CompensationModelN[4];
+
+    // Work handed to the I/O worker. Only the latest move target matters, superseded ones are dropped.
+    struct MoveCommand
+    {
+        uint32_t id;
+        uint32_t targetTicks;
+        FocuserUrl url;
+        // The url loads a move sequence, which only HTTP can. Plain moves go over UDP when it is open.
+        bool loadsSequence;
+        // Give up on the move if it has not finished by then, from the motion model.
+        double timeoutSeconds;
+        // The backlash settings for a UDP move, read from the properties when it is queued as the url is. UDP_KEEP
+        // and UDP_KEEP_STRATEGY leave the device's own.
+        uint16_t backlashSteps;
+        int8_t backlashStrategy;
+    };
+
+    // Handed back to the INDI event loop: progress while the device moves, the last one for a move has finished set,
+    // and the worker's log lines, which only the INDI thread may send. One queue keeps both in the order they happened.
+    struct WorkerUpdate
+    {
+        uint32_t id;
+        uint32_t position;
+        bool ok;
+        bool finished;
+        // How long the move took, if it was followed from the request until the device stopped, otherwise 0.
+        double seconds;
+        // Set for a log line, which carries no move progress.
+        char message[WORKER_LOG_SIZE];
+        INDI::Logger::VerbosityLevel level;
+    };
+
+    void StartWorker();
+    void StopWorker();
+    void WorkerLoop();
+    bool PerformMove(const MoveCommand &command);
+    void PublishMoveUpdate(uint32_t id, uint32_t position, bool ok, bool finished, double seconds = 0);
+    void WorkerLog(INDI::Logger::VerbosityLevel level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+    void PushUpdate(const WorkerUpdate &update);
+    void LogClientError();
+    bool PollStatus(FocuserStatus &status, long timeoutMs);
+    bool OpenUdp();
+    bool UdpRequest(uint8_t type, uint32_t targetTicks, uint16_t backlashSteps, int8_t strategy,
+                    FocuserStatus &status);
+    bool UdpPollStatus(FocuserStatus &status);
+
     bool SendGetRequest(const char *path);
-    void PowerCycle();
-    std::string APIEndPoint;    
+    void UpdateKinematics(const FocuserStatus *status);
+    bool RecoverDevice();
+    void CopyPowerEndpoints();
+    std::string PowerEndpoint(bool on);
+    bool WaitUntil(std::chrono::steady_clock::time_point time);
+    void MoveUrl(uint32_t targetTicks, FocuserUrl &url);
+    void SequenceUrl(const uint32_t *targets, size_t count, FocuserUrl &url);
+    IPState QueueMove(uint32_t targetTicks, const FocuserUrl &url, bool compensation = false);
+    void PollTemperature();
+    void SetTemperature(double celsius);
+    void Compensate();
+    void PublishCompensationModel();
+    void FillHistogramProperty(INumberVectorProperty *property, INumber *numbers, const char *name, const char *label,
+                               const char *unit);
+    void SetHistogramProperty(INumberVectorProperty *property, INumber *numbers, const LatencyHistogram &histogram,
+                              double scale);
+    void PublishStats(bool force = false);
+    bool DumpStats();
+    bool StartSweep(const char *samples);
+    void SweepMoveFinished(bool ok);
+    void EndSweep(IPState state);
+
+    // The device's HTTP API. Requests run on one easy handle, on the multi handle shared with the driver's other
+    // focusers, and go into the statistics and the trace. Once connected, only the worker makes them.
+    CurlTransport curlTransport;
+    RecordingTransport transport;
+    FocuserClient client;
+    // Open while the device answers on its UDP port, closed again, falling back to HTTP, once it stops. Worker only once connected.
+    UdpTransport udp;
+
+    SpscQueue<MoveCommand, 16> commandQueue;
+    SpscQueue<WorkerUpdate, 64> updateQueue;
+    // Updates the worker found no room for, reported from TimerHit.
+    std::atomic<uint32_t> droppedUpdates;
+    // Temperatures read by the worker while idle, NAN when the device reports none.
+    SpscQueue<double, 4> temperatureQueue;
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerWakeup;
+    // The power switch URLs for the worker, copied from their properties under workerMutex whenever they are set.
+    std::string powerOffEndpoint;
+    std::string powerOnEndpoint;
+    std::atomic<bool> workerExit;
+    // Recorded from either thread, published from TimerHit.
+    FocuserStats stats;
+    // Every exchange with the device while a trace file is set. Written from either thread, opened from the main thread.
+    TraceWriter trace;
+    // Main thread only: when the statistics were last published, and what they added up to then.
+    std::chrono::steady_clock::time_point statsPublished;
+    uint64_t statsPublishedTotal;
+    // Worker only once connected: the last position the device reported, to restore after a power cycle.
+    uint32_t devicePosition;
+
+    // Main thread only: the id and target of the most recently requested move.
+    uint32_t lastMoveId;
+    uint32_t lastTargetTicks;
+    bool moveInProgress;
+
+    // Main thread only: sweep detection. The targets of the sequence loaded into the device and the next one expected.
+    int64_t lastMoveDelta;
+    std::vector<uint32_t> sweepTargets;
+    size_t sweepNext;
+
+    // Main thread only: move durations, and what was predicted for the latest move.
+    MotionModel motionModel;
+    double lastMoveModelled;
+    double lastMovePredicted;
+    bool lastMoveFromRest;
+    std::chrono::steady_clock::time_point lastMoveQueued;
+
+    // Main thread only: the latest temperature, NAN if unknown, and the temperature compensation model.
+    double temperature;
+    TemperatureModel temperatureModel;
+
+    // Main thread only: the planned sweep being run, see StartSweep.
+    SweepPlan sweepPlan;
+    size_t sweepIndex;
+    bool sweepActive;
+    uint32_t sweepMoveId;
+    std::chrono::steady_clock::time_point sweepStart;
+    std::chrono::steady_clock::time_point sweepDwellUntil;
 };
 
 #endif
@@ -0,0 +1,22 @@
+/*******************************************************************************
+  Correctly rounded decimal to double conversion for JSON numbers, shared by
+  gason and the FocuserStatus decoder.
+
+  Plain integers of up to 19 digits are converted directly, short mantissas
+  with small exponents take the exact floating point path and everything else
+  goes through the Eisel-Lemire algorithm with a 128-bit power of five table.
+  Only inputs with more than 19 significant digits that land too close to a
+  rounding boundary are handed to strtod.
+*******************************************************************************/
+
+#ifndef JSONNUMBER_H
+#define JSONNUMBER_H
+
+/**
+ * Parse the number at s, which may start with '-'. Parsing stops at the first character that
+ * cannot continue the number, or at end; pass end = nullptr for NUL terminated input.
+ * *endptr is set past the last character used, or to s when there are no digits.
+**/
+double jsonParseNumber(const char *s, const char *end, const char **endptr);
+
+#endif
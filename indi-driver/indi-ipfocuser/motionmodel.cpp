@@ -0,0 +1,125 @@
+/*******************************************************************************
+  Move duration model for the focuser device. See motionmodel.h.
+*******************************************************************************/
+#include "motionmodel.h"
+
+#include <math.h>
+
+// Weight of older observations against each new one, about the last 20 moves count.
+#define FORGETTING 0.95
+// The error estimate forgets faster, so the large errors made before calibration stop inflating timeouts soon.
+#define ERROR_FORGETTING 0.8
+// Observations needed before the scale is fitted, until then only the offset is learned.
+#define MIN_OBSERVATIONS_FOR_SCALE 3
+// The least spread of modelled durations, in seconds, that a scale can be fitted from.
+#define MIN_SPREAD_SECONDS 1.0
+#define MIN_SCALE 0.25
+#define MAX_SCALE 4.0
+// Timeout margin: proportional, a multiple of the typical prediction error and a fixed allowance for the requests.
+#define TIMEOUT_FACTOR 1.5
+#define TIMEOUT_ERRORS 3.0
+#define TIMEOUT_SLACK_SECONDS 5.0
+
+/**
+ * Trapezoidal profile like the firmware's StepRamp: accelerate to speed, cruise, decelerate. Triangular when the move
+ * is too short to reach full speed.
+**/
+double segmentSeconds(int64_t motorSteps, int rpm, int acceleration)
+{
+    if (motorSteps <= 0 || rpm <= 0)
+        return 0;
+    double stepsPerSecond = (double)rpm * DEVICE_STEPS_PER_REVOLUTION / 60;
+    if (acceleration <= 0)
+        return motorSteps / stepsPerSecond;
+    double rampSteps = stepsPerSecond * stepsPerSecond / (2.0 * acceleration);
+    if (motorSteps < 2 * rampSteps)
+        return 2 * sqrt(motorSteps / (double)acceleration);
+    return 2 * stepsPerSecond / acceleration + (motorSteps - 2 * rampSteps) / stepsPerSecond;
+}
+
+MotionModel::MotionModel()
+{
+    // Firmware defaults until the device is read
+    kinematics.speed = 280;
+    kinematics.backlashSpeed = 280;
+    kinematics.acceleration = 0;
+    kinematics.gearBoxMultiplier = 10;
+    kinematics.backlashSteps = 100;
+    kinematics.backlashStrategy = BACKLASH_APPROACH_CCW;
+    forgetDirection();
+    reset();
+}
+
+void MotionModel::reset()
+{
+    sumWeight = sumX = sumY = sumXX = sumXY = 0;
+    scale = 1;
+    offset = 0;
+    meanSquareError = 0;
+    count = 0;
+}
+
+void MotionModel::plan(uint32_t from, uint32_t to, MotionPlan &segments) const
+{
+    MoveRequest request = {(int)to, kinematics.speed, kinematics.backlashSpeed, kinematics.acceleration,
+                           kinematics.backlashSteps, kinematics.backlashStrategy};
+    PlannerState state = plannerState;
+    planMove(from, request, 0, kinematics.gearBoxMultiplier, state, segments);
+}
+
+void MotionModel::planned(uint32_t from, uint32_t to)
+{
+    MoveRequest request = {(int)to, kinematics.speed, kinematics.backlashSpeed, kinematics.acceleration,
+                           kinematics.backlashSteps, kinematics.backlashStrategy};
+    MotionPlan plan;
+    planMove(from, request, 0, kinematics.gearBoxMultiplier, plannerState, plan);
+}
+
+void MotionModel::forgetDirection()
+{
+    plannerState.loadedDirection = 0;
+}
+
+double MotionModel::modelSeconds(uint32_t from, uint32_t to) const
+{
+    MotionPlan segments;
+    plan(from, to, segments);
+    double seconds = 0;
+    for (uint8_t i = 0; i < segments.count; i++)
+        seconds += segmentSeconds(segments.segments[i].steps, segments.segments[i].rpm, kinematics.acceleration);
+    return seconds;
+}
+
+double MotionModel::predictSeconds(uint32_t from, uint32_t to) const
+{
+    double seconds = calibrate(modelSeconds(from, to));
+    return seconds > 0 ? seconds : 0;
+}
+
+double MotionModel::timeoutSeconds(uint32_t from, uint32_t to) const
+{
+    return TIMEOUT_FACTOR * predictSeconds(from, to) + TIMEOUT_ERRORS * sqrt(meanSquareError) + TIMEOUT_SLACK_SECONDS;
+}
+
+void MotionModel::observe(double modelledSeconds, double observedSeconds)
+{
+    double error = observedSeconds - calibrate(modelledSeconds);
+    meanSquareError = count ? ERROR_FORGETTING * meanSquareError + (1 - ERROR_FORGETTING) * error * error : error * error;
+    count++;
+
+    sumWeight = FORGETTING * sumWeight + 1;
+    sumX = FORGETTING * sumX + modelledSeconds;
+    sumY = FORGETTING * sumY + observedSeconds;
+    sumXX = FORGETTING * sumXX + modelledSeconds * modelledSeconds;
+    sumXY = FORGETTING * sumXY + modelledSeconds * observedSeconds;
+
+    // Weighted variance of the modelled durations. A scale fitted from moves of much the same length is noise.
+    double meanX = sumX / sumWeight;
+    double varianceX = sumXX / sumWeight - meanX * meanX;
+    if (count >= MIN_OBSERVATIONS_FOR_SCALE && varianceX >= MIN_SPREAD_SECONDS * MIN_SPREAD_SECONDS)
+    {
+        double fitted = (sumXY / sumWeight - meanX * (sumY / sumWeight)) / varianceX;
+        scale = fitted < MIN_SCALE ? MIN_SCALE : fitted > MAX_SCALE ? MAX_SCALE : fitted;
+    }
+    offset = (sumY - scale * sumX) / sumWeight;
+}
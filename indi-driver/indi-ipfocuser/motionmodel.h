@@ -0,0 +1,87 @@
+/*******************************************************************************
+  Move duration model for the focuser device.
+
+  A move is predicted from what the firmware will do with it: the segments
+  the firmware's own planner (planner.h) turns it into, the move itself and
+  any backlash compensation, each ramped like StepRamp.
+  The prediction is then calibrated against how long moves really take, as
+  seen by the driver, which folds in request latency and polling.
+*******************************************************************************/
+
+#ifndef MOTIONMODEL_H
+#define MOTIONMODEL_H
+
+#include <stdint.h>
+
+#include "planner.h"
+
+// Not in the status response, the firmware's STEPS_PER_REVOLUTION.
+#define DEVICE_STEPS_PER_REVOLUTION 195
+
+// What the device moves with, from its status response and the driver's backlash setting.
+struct FocuserKinematics
+{
+    int speed;              // rpm of requested moves
+    int backlashSpeed;      // rpm of backlash compensation, the device's maxSpeed
+    int acceleration;       // motor steps per second per second, 0 for none
+    int gearBoxMultiplier;
+    int backlashSteps;
+    int8_t backlashStrategy;    // a BacklashStrategy, from the driver's always approach setting
+};
+
+/**
+ * Seconds the device takes to run motorSteps at rpm, ramping at acceleration if it is not 0.
+**/
+double segmentSeconds(int64_t motorSteps, int rpm, int acceleration);
+
+class MotionModel
+{
+public:
+    MotionModel();
+
+    void setKinematics(const FocuserKinematics &kinematics) {
+        this->kinematics = kinematics;
+    }
+    const FocuserKinematics &getKinematics() const {
+        return kinematics;
+    }
+
+    // The segments the firmware will run for a move request from one position to another.
+    void plan(uint32_t from, uint32_t to, MotionPlan &segments) const;
+    // Carry the direction the gears are driven in on past a move sent to the device, which the next plan depends on.
+    void planned(uint32_t from, uint32_t to);
+    // The device's direction is not known, e.g. after connecting. Its own state is reset at power on.
+    void forgetDirection();
+
+    // Seconds the firmware needs for a move request from one position to another, from the kinematics alone.
+    double modelSeconds(uint32_t from, uint32_t to) const;
+    // modelSeconds corrected by what has been observed so far.
+    double predictSeconds(uint32_t from, uint32_t to) const;
+    // How long to wait for a move before giving up on it.
+    double timeoutSeconds(uint32_t from, uint32_t to) const;
+
+    // Learn from a move that started at rest and was followed until it stopped.
+    void observe(double modelledSeconds, double observedSeconds);
+    void reset();
+
+    int observations() const {
+        return count;
+    }
+
+private:
+    FocuserKinematics kinematics;
+    PlannerState plannerState;
+
+    // Exponentially weighted least squares fit of observed = scale * modelled + offset.
+    double sumWeight, sumX, sumY, sumXX, sumXY;
+    double scale, offset;
+    // Exponentially weighted mean square of the prediction error, before each observation was learned.
+    double meanSquareError;
+    int count;
+
+    double calibrate(double modelled) const {
+        return scale * modelled + offset;
+    }
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*******************************************************************************
+  Power cycle recovery for a focuser device. See powerrecovery.h.
+*******************************************************************************/
+#include "powerrecovery.h"
+
+#include <algorithm>
+
+// Off long enough for the Arduino to really reset.
+#define POWER_OFF_DWELL_MS 2000
+// The first probe after power on and the most the backoff grows to, which bounds how late a booted device is noticed.
+#define FIRST_PROBE_DELAY_MS 250
+#define MAX_PROBE_DELAY_MS 2000
+// Give up if the device has not answered this long after power on.
+#define BOOT_TIMEOUT_MS 60000
+
+void PowerRecovery::begin(Clock::time_point now)
+{
+    current = POWER_OFF;
+    dueAt = now;
+    probeCount = 0;
+}
+
+void PowerRecovery::completed(bool ok, Clock::time_point now)
+{
+    switch (current)
+    {
+    case POWER_OFF:
+        // Carry on if the switch did not answer, the probes tell whether the device came back anyway
+        current = POWER_ON;
+        dueAt = now + std::chrono::milliseconds(POWER_OFF_DWELL_MS);
+        break;
+    case POWER_ON:
+        current = PROBE;
+        poweredOnAt = now;
+        backoff = std::chrono::milliseconds(FIRST_PROBE_DELAY_MS);
+        dueAt = now + backoff;
+        break;
+    case PROBE:
+        probeCount++;
+        if (ok)
+        {
+            current = DONE;
+            answeredAt = now;
+        }
+        else if (now - poweredOnAt >= std::chrono::milliseconds(BOOT_TIMEOUT_MS))
+            current = FAILED;
+        else
+        {
+            backoff = std::min(backoff * 2, std::chrono::milliseconds(MAX_PROBE_DELAY_MS));
+            dueAt = now + backoff;
+        }
+        break;
+    case DONE:
+    case FAILED:
+        break;
+    }
+}
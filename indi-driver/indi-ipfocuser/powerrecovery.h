@@ -0,0 +1,58 @@
+/*******************************************************************************
+  Power cycle recovery for a focuser device that stopped answering.
+
+  The schedule only: power off, let it settle, power on, then probe the status
+  endpoint with exponential backoff until the device answers or the boot
+  timeout passes. Whoever drives it performs each step when it is due and
+  reports back, so waiting never blocks anything but the caller, and the
+  recovery takes as long as the device really needs to boot.
+*******************************************************************************/
+
+#ifndef POWERRECOVERY_H
+#define POWERRECOVERY_H
+
+#include <chrono>
+
+class PowerRecovery
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Step {
+        POWER_OFF,
+        POWER_ON,
+        PROBE,
+        DONE,
+        FAILED
+    };
+
+    void begin(Clock::time_point now);
+    // Report how the current step went, at the time it finished. Moves on to the next step.
+    void completed(bool ok, Clock::time_point now);
+
+    Step step() const {
+        return current;
+    }
+    // When the current step should be performed.
+    Clock::time_point due() const {
+        return dueAt;
+    }
+    // Probes so far since power on.
+    int probes() const {
+        return probeCount;
+    }
+    // From power on until the device answered, once DONE.
+    double bootSeconds() const {
+        return std::chrono::duration<double>(answeredAt - poweredOnAt).count();
+    }
+
+private:
+    Step current = DONE;
+    Clock::time_point dueAt;
+    Clock::time_point poweredOnAt;
+    Clock::time_point answeredAt;
+    std::chrono::milliseconds backoff;
+    int probeCount = 0;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*******************************************************************************
+  Statistics and trace around a transport. See recordingtransport.h.
+*******************************************************************************/
+#include "recordingtransport.h"
+
+#include <string.h>
+
+#include <string>
+
+// While tracing, the body is kept for the trace as it is handed on.
+struct TraceCapture
+{
+    BodySink sink;
+    void *context;
+    std::string body;
+};
+
+static void TraceSink(const char *data, size_t length, void *context)
+{
+    TraceCapture *capture = (TraceCapture *)context;
+    capture->body.append(data, length);
+    if (capture->sink)
+        capture->sink(data, length, capture->context);
+}
+
+RecordingTransport::RecordingTransport(FocuserTransport &transport, FocuserStats &stats, TraceWriter &trace)
+    : transport(transport), stats(stats), trace(trace)
+{
+}
+
+TransportResult RecordingTransport::get(const char *url, long timeoutMs, BodySink sink, void *context)
+{
+    bool tracing = trace.isOpen();
+    TraceCapture capture;
+    capture.sink = sink;
+    capture.context = context;
+    TraceWriter::Clock::time_point start = TraceWriter::Clock::now();
+    TransportResult result = tracing ? transport.get(url, timeoutMs, TraceSink, &capture) :
+                             transport.get(url, timeoutMs, sink, context);
+    TraceWriter::Clock::time_point end = TraceWriter::Clock::now();
+    if (tracing)
+        trace.record(TRACE_HTTP, result == TRANSPORT_OK ? TRACE_OK : result == TRANSPORT_TIMEOUT ? TRACE_TIMEOUT : TRACE_FAILED,
+                     start, end, timeoutMs, url, strlen(url), capture.body.data(), capture.body.size());
+    stats.count(COUNTER_REQUESTS);
+    if (result != TRANSPORT_OK)
+    {
+        stats.count(COUNTER_REQUEST_FAILURES);
+        if (result == TRANSPORT_TIMEOUT)
+            stats.count(COUNTER_TIMEOUTS);
+        return result;
+    }
+    stats.httpRequest.record(std::chrono::duration<double>(end - start).count());
+    return result;
+}
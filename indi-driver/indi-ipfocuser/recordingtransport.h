@@ -0,0 +1,32 @@
+/*******************************************************************************
+  FocuserTransport that runs each request on another transport and records
+  it: counted in the statistics, with the latency of answered requests, and
+  appended to the trace while one is open.
+
+  The body is only kept, for the trace, while tracing.
+*******************************************************************************/
+
+#ifndef RECORDINGTRANSPORT_H
+#define RECORDINGTRANSPORT_H
+
+#include "focuserstats.h"
+#include "focusertrace.h"
+#include "focusertransport.h"
+
+class RecordingTransport : public FocuserTransport
+{
+public:
+    RecordingTransport(FocuserTransport &transport, FocuserStats &stats, TraceWriter &trace);
+
+    TransportResult get(const char *url, long timeoutMs, BodySink sink, void *context) override;
+    const char *error() const override {
+        return transport.error();
+    }
+
+private:
+    FocuserTransport &transport;
+    FocuserStats &stats;
+    TraceWriter &trace;
+};
+
+#endif
@@ -0,0 +1,430 @@
+/*******************************************************************************
+  Minimal HTTP/1.1 client transport. See sockettransport.h.
+*******************************************************************************/
+#include "sockettransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+static const char HTTP_SCHEME[] = "http://";
+
+/**
+ * Decodes a chunked body byte by byte, handing the data on. Chunk extensions and trailers are skipped.
+**/
+struct ChunkDecoder
+{
+    enum State {
+        SIZE,
+        EXTENSION,
+        DATA,
+        DATA_END,
+        TRAILER,
+        DONE,
+        BAD
+    };
+
+    State state = SIZE;
+    uint64_t remaining = 0;
+    size_t lineLength = 0;
+    bool haveDigit = false;
+
+    void feed(const char *data, size_t length, BodySink sink, void *context)
+    {
+        size_t i = 0;
+        while (i < length && state != DONE && state != BAD)
+        {
+            if (state == DATA)
+            {
+                size_t n = remaining < length - i ? remaining : length - i;
+                if (sink)
+                    sink(data + i, n, context);
+                i += n;
+                remaining -= n;
+                if (remaining == 0)
+                    state = DATA_END;
+                continue;
+            }
+            char c = data[i++];
+            switch (state)
+            {
+            case SIZE:
+            {
+                int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                            c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (digit >= 0 && remaining >> 60 == 0)
+                {
+                    remaining = remaining * 16 + digit;
+                    haveDigit = true;
+                }
+                else if (c == ';' || c == ' ' || c == '\t')
+                    state = EXTENSION;
+                else if (c == '\n')
+                    endSizeLine();
+                else if (c != '\r')
+                    state = BAD;
+                break;
+            }
+            case EXTENSION:
+                if (c == '\n')
+                    endSizeLine();
+                break;
+            case DATA_END:
+                if (c == '\n')
+                {
+                    state = SIZE;
+                    haveDigit = false;
+                }
+                else if (c != '\r')
+                    state = BAD;
+                break;
+            case TRAILER:
+                if (c == '\n')
+                {
+                    if (lineLength == 0)
+                        state = DONE;
+                    lineLength = 0;
+                }
+                else if (c != '\r')
+                    lineLength++;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    void endSizeLine()
+    {
+        if (!haveDigit)
+            state = BAD;
+        else if (remaining == 0)
+        {
+            state = TRAILER;
+            lineLength = 0;
+        }
+        else
+            state = DATA;
+    }
+};
+
+// Whether the header line from start to end is name, in any case, and if so where its value starts.
+static bool headerIs(const char *start, const char *end, const char *name, const char *&value)
+{
+    size_t length = strlen(name);
+    if ((size_t)(end - start) <= length || strncasecmp(start, name, length) != 0 || start[length] != ':')
+        return false;
+    value = start + length + 1;
+    while (value < end && (*value == ' ' || *value == '\t'))
+        value++;
+    return true;
+}
+
+// Whether the header value from value to end holds token, in any case.
+static bool valueHas(const char *value, const char *end, const char *token)
+{
+    size_t length = strlen(token);
+    for (const char *p = value; p + length <= end; p++)
+        if (strncasecmp(p, token, length) == 0)
+            return true;
+    return false;
+}
+
+SocketTransport::SocketTransport() : fd(-1), reusable(false), port(0), resolved(false), addressLength(0), connectCount(0)
+{
+    host[0] = '\0';
+    errorText[0] = '\0';
+}
+
+SocketTransport::~SocketTransport()
+{
+    close();
+}
+
+void SocketTransport::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    reusable = false;
+}
+
+TransportResult SocketTransport::fail(TransportResult result, const char *what, int error)
+{
+    if (error)
+        snprintf(errorText, sizeof(errorText), "%s: %s", what, strerror(error));
+    else
+        snprintf(errorText, sizeof(errorText), "%s", what);
+    close();
+    return result;
+}
+
+static long millisecondsUntil(SocketTransport::Clock::time_point deadline)
+{
+    long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - SocketTransport::Clock::now()).count();
+    return left < 0 ? 0 : left;
+}
+
+/**
+ * Connect to host and port, resolving them first if they are not the ones last resolved.
+**/
+TransportResult SocketTransport::connectTo(Clock::time_point deadline)
+{
+    if (!resolved)
+    {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        char service[8];
+        snprintf(service, sizeof(service), "%u", port);
+        addrinfo *found;
+        int error = getaddrinfo(host, service, &hints, &found);
+        if (error)
+        {
+            snprintf(errorText, sizeof(errorText), "cannot resolve %.64s: %s", host, gai_strerror(error));
+            return TRANSPORT_FAILED;
+        }
+        memcpy(&address, found->ai_addr, found->ai_addrlen);
+        addressLength = found->ai_addrlen;
+        freeaddrinfo(found);
+        resolved = true;
+    }
+
+    fd = socket(address.ss_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return fail(TRANSPORT_FAILED, "socket", errno);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    connectCount++;
+    if (connect(fd, (sockaddr *)&address, addressLength) == 0)
+        return TRANSPORT_OK;
+    if (errno != EINPROGRESS)
+        return fail(TRANSPORT_FAILED, "connect", errno);
+    pollfd waiting = {fd, POLLOUT, 0};
+    int ready = poll(&waiting, 1, millisecondsUntil(deadline));
+    if (ready == 0)
+        return fail(TRANSPORT_TIMEOUT, "connect timed out", 0);
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (ready < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+        return fail(TRANSPORT_FAILED, "connect", errno);
+    if (error)
+        return fail(TRANSPORT_FAILED, "connect", error);
+    return TRANSPORT_OK;
+}
+
+TransportResult SocketTransport::sendAll(const char *data, size_t length, Clock::time_point deadline)
+{
+    while (length > 0)
+    {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent > 0)
+        {
+            data += sent;
+            length -= sent;
+            continue;
+        }
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return fail(TRANSPORT_FAILED, "send", errno);
+        pollfd waiting = {fd, POLLOUT, 0};
+        if (poll(&waiting, 1, millisecondsUntil(deadline)) == 0)
+            return fail(TRANSPORT_TIMEOUT, "send timed out", 0);
+    }
+    return TRANSPORT_OK;
+}
+
+TransportResult SocketTransport::receive(size_t offset, Clock::time_point deadline, size_t &received)
+{
+    while (true)
+    {
+        ssize_t n = recv(fd, buffer + offset, sizeof(buffer) - offset, 0);
+        if (n >= 0)
+        {
+            received = n;
+            return TRANSPORT_OK;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return fail(TRANSPORT_FAILED, "receive", errno);
+        pollfd waiting = {fd, POLLIN, 0};
+        if (poll(&waiting, 1, millisecondsUntil(deadline)) == 0)
+            return fail(TRANSPORT_TIMEOUT, "response timed out", 0);
+    }
+}
+
+/**
+ * Read the status line and headers into buffer, then hand the body to sink as it arrives. answered is set once any of
+ * the response has been read.
+**/
+TransportResult SocketTransport::readResponse(Clock::time_point deadline, BodySink sink, void *context, bool &answered)
+{
+    size_t have = 0;
+    char *headerEnd = NULL;
+    while (!headerEnd)
+    {
+        if (have == sizeof(buffer))
+            return fail(TRANSPORT_FAILED, "response headers too long", 0);
+        size_t received;
+        TransportResult result = receive(have, deadline, received);
+        if (result != TRANSPORT_OK)
+            return result;
+        if (received == 0)
+            return fail(TRANSPORT_FAILED, answered ? "connection closed in the response headers" :
+                        "connection closed without a response", 0);
+        answered = true;
+        // The terminator may straddle the previous read
+        size_t from = have < 3 ? 0 : have - 3;
+        have += received;
+        for (size_t i = from; i + 4 <= have && !headerEnd; i++)
+            if (memcmp(buffer + i, "\r\n\r\n", 4) == 0)
+                headerEnd = buffer + i + 4;
+    }
+
+    // "HTTP/1.x NNN ..."
+    if (have < 12 || memcmp(buffer, "HTTP/1.", 7) != 0)
+        return fail(TRANSPORT_FAILED, "not an HTTP response", 0);
+    bool http11 = buffer[7] != '0';
+    int status = atoi(buffer + 9);
+    bool keepAlive = http11;
+    bool chunked = false;
+    bool haveLength = false;
+    unsigned long long contentLength = 0;
+    for (char *line = (char *)memchr(buffer, '\r', headerEnd - buffer) + 2; line < headerEnd - 2;)
+    {
+        char *end = (char *)memchr(line, '\r', headerEnd - line);
+        const char *value;
+        if (headerIs(line, end, "Content-Length", value))
+        {
+            haveLength = true;
+            contentLength = strtoull(value, NULL, 10);
+        }
+        else if (headerIs(line, end, "Transfer-Encoding", value))
+            chunked = valueHas(value, end, "chunked");
+        else if (headerIs(line, end, "Connection", value))
+        {
+            if (valueHas(value, end, "close"))
+                keepAlive = false;
+            else if (valueHas(value, end, "keep-alive"))
+                keepAlive = true;
+        }
+        line = end + 2;
+    }
+    if (status / 100 == 1 || status == 204 || status == 304)
+    {
+        haveLength = true;
+        contentLength = 0;
+        chunked = false;
+    }
+
+    // Without chunks or a length the body runs until the server closes, which the device always does
+    ChunkDecoder chunks;
+    size_t pending = have - (headerEnd - buffer);
+    char *data = headerEnd;
+    while (true)
+    {
+        if (chunked)
+        {
+            chunks.feed(data, pending, sink, context);
+            if (chunks.state == ChunkDecoder::BAD)
+                return fail(TRANSPORT_FAILED, "bad chunk in the response", 0);
+            if (chunks.state == ChunkDecoder::DONE)
+                break;
+        }
+        else if (haveLength)
+        {
+            size_t n = pending < contentLength ? pending : contentLength;
+            if (sink && n)
+                sink(data, n, context);
+            contentLength -= n;
+            if (contentLength == 0)
+                break;
+        }
+        else if (sink && pending)
+            sink(data, pending, context);
+
+        size_t received;
+        TransportResult result = receive(0, deadline, received);
+        if (result != TRANSPORT_OK)
+            return result;
+        if (received == 0)
+        {
+            if (chunked || haveLength)
+                return fail(TRANSPORT_FAILED, "connection closed in the response body", 0);
+            keepAlive = false;
+            break;
+        }
+        data = buffer;
+        pending = received;
+    }
+    if (keepAlive && (chunked || haveLength))
+        reusable = true;
+    else
+        close();
+    return TRANSPORT_OK;
+}
+
+TransportResult SocketTransport::get(const char *url, long timeoutMs, BodySink sink, void *context)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    if (strncasecmp(url, HTTP_SCHEME, sizeof(HTTP_SCHEME) - 1) != 0)
+    {
+        snprintf(errorText, sizeof(errorText), "only http:// URLs are supported");
+        return TRANSPORT_FAILED;
+    }
+    const char *hostStart = url + sizeof(HTTP_SCHEME) - 1;
+    const char *hostEnd = hostStart + strcspn(hostStart, ":/?");
+    const char *path = hostEnd + strcspn(hostEnd, "/?");
+    uint16_t urlPort = *hostEnd == ':' ? atoi(hostEnd + 1) : 80;
+    size_t hostLength = hostEnd - hostStart;
+    if (hostLength == 0 || hostLength >= sizeof(host) || urlPort == 0)
+    {
+        snprintf(errorText, sizeof(errorText), "bad host in %s", url);
+        return TRANSPORT_FAILED;
+    }
+    if (hostLength != strlen(host) || memcmp(host, hostStart, hostLength) != 0 || urlPort != port)
+    {
+        close();
+        memcpy(host, hostStart, hostLength);
+        host[hostLength] = '\0';
+        port = urlPort;
+        resolved = false;
+    }
+
+    // GET <path> HTTP/1.1, Host: <host>[:port], the path always starting with '/'
+    char request[FOCUSER_URL_CAPACITY + SOCKET_HOST_SIZE + 32];
+    int length = snprintf(request, sizeof(request), "GET %s%s HTTP/1.1\r\nHost: %.*s\r\n\r\n", *path == '/' ? "" : "/",
+                          path, (int)(path - hostStart), hostStart);
+    if (length < 0 || (size_t)length >= sizeof(request))
+    {
+        snprintf(errorText, sizeof(errorText), "request too long");
+        return TRANSPORT_FAILED;
+    }
+
+    for (int attempt = 0;; attempt++)
+    {
+        bool reused = fd >= 0 && reusable;
+        if (!reused)
+        {
+            close();
+            TransportResult result = connectTo(deadline);
+            if (result != TRANSPORT_OK)
+                return result;
+        }
+        reusable = false;
+        TransportResult result = sendAll(request, length, deadline);
+        bool answered = false;
+        if (result == TRANSPORT_OK)
+            result = readResponse(deadline, sink, context, answered);
+        // A kept connection the server closed in the meantime, try once more on a new one
+        if (result != TRANSPORT_FAILED || !reused || answered || attempt > 0)
+            return result;
+    }
+}
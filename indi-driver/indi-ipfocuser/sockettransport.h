@@ -0,0 +1,74 @@
+/*******************************************************************************
+  FocuserTransport on a plain TCP socket: a minimal HTTP/1.1 client for
+  http:// URLs, with no dependencies.
+
+  Requests are written from a fixed buffer and responses read through one,
+  so a request allocates nothing. The body is framed by Content-Length,
+  chunked transfer encoding or the server closing the connection, which is
+  what the device's HTTP/1.0 server does. When the server offers it the
+  connection is kept open for the next request to the same host and port.
+  A kept connection the server has meanwhile closed is found when the
+  request on it gets no response, and the request is sent again once on a
+  new connection, which is safe as moves are absolute. Names are resolved
+  once per host and port.
+*******************************************************************************/
+
+#ifndef SOCKETTRANSPORT_H
+#define SOCKETTRANSPORT_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <chrono>
+
+#include "focusertransport.h"
+#include "focuserurl.h"
+
+// Longest host name, response header block, and read size.
+#define SOCKET_HOST_SIZE 256
+#define SOCKET_BUFFER_SIZE 2048
+
+class SocketTransport : public FocuserTransport
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    SocketTransport();
+    ~SocketTransport();
+
+    TransportResult get(const char *url, long timeoutMs, BodySink sink, void *context) override;
+    const char *error() const override {
+        return errorText;
+    }
+    void close();
+    // Connections opened since the transport was created, fewer than requests when connections are kept.
+    uint32_t connects() const {
+        return connectCount;
+    }
+
+private:
+    int fd;
+    // The open connection may take another request.
+    bool reusable;
+    char host[SOCKET_HOST_SIZE];
+    uint16_t port;
+    // Where host and port resolved to, when resolved is set.
+    bool resolved;
+    sockaddr_storage address;
+    socklen_t addressLength;
+    uint32_t connectCount;
+    char buffer[SOCKET_BUFFER_SIZE];
+    char errorText[128];
+
+    TransportResult connectTo(Clock::time_point deadline);
+    TransportResult sendAll(const char *data, size_t length, Clock::time_point deadline);
+    // Read what has arrived into buffer at offset, received is 0 once the server has closed the connection.
+    TransportResult receive(size_t offset, Clock::time_point deadline, size_t &received);
+    TransportResult readResponse(Clock::time_point deadline, BodySink sink, void *context, bool &answered);
+    TransportResult fail(TransportResult result, const char *what, int error);
+
+    SocketTransport(const SocketTransport &);
+    SocketTransport &operator=(const SocketTransport &);
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*******************************************************************************
+  Focus position against temperature. See temperaturemodel.h.
+*******************************************************************************/
+#include "temperaturemodel.h"
+
+#include <math.h>
+
+// Weight kept by a pair each time a newer one is added, about the last 20 pairs count.
+#define FORGETTING 0.95
+// How much the prior slope weighs, as the sum of squared temperature changes (C^2) it is worth.
+#define PRIOR_WEIGHT 4.0
+
+TemperatureModel::TemperatureModel() : priorSlope(0)
+{
+    reset();
+}
+
+void TemperatureModel::observe(double position, double temperature)
+{
+    if (haveLast)
+    {
+        double dT = temperature - lastTemperature;
+        double dP = position - lastPosition;
+        sumTT = FORGETTING * sumTT + dT * dT;
+        sumTP = FORGETTING * sumTP + dT * dP;
+        sumWeight = FORGETTING * sumWeight + 1;
+        count++;
+    }
+    haveLast = true;
+    lastPosition = position;
+    lastTemperature = temperature;
+    anchor(position, temperature);
+}
+
+void TemperatureModel::anchor(double position, double temperature)
+{
+    anchored = true;
+    anchorPosition = position;
+    anchorTemperature = temperature;
+}
+
+void TemperatureModel::endSession()
+{
+    haveLast = false;
+    anchored = false;
+}
+
+void TemperatureModel::reset()
+{
+    sumTT = sumTP = sumWeight = 0;
+    count = 0;
+    endSession();
+}
+
+double TemperatureModel::slope() const
+{
+    return (sumTP + PRIOR_WEIGHT * priorSlope) / (sumTT + PRIOR_WEIGHT);
+}
+
+double TemperatureModel::predict(double temperature) const
+{
+    return anchorPosition + slope() * (temperature - anchorTemperature);
+}
+
+double TemperatureModel::temperatureSpread() const
+{
+    return sumWeight > 0 ? sqrt(sumTT / sumWeight) : 0;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+  Focus position against temperature, for temperature compensation.
+
+  As the tube cools, focus moves by a roughly constant number of steps per
+  degree. The slope is fitted online from autofocus results: each result is
+  paired with the one before it in the same session, and the slope is the
+  least squares fit of the position changes against the temperature changes,
+  through the origin. Using changes keeps the fit clear of whatever shifted
+  focus between sessions, such as a different camera or filter. Older pairs
+  fade out exponentially, and a configured prior slope carries the fit until
+  the results span a few degrees.
+
+  Predictions are made from an anchor, the last position chosen at a known
+  temperature: an autofocus result or a move the user made.
+*******************************************************************************/
+
+#ifndef TEMPERATUREMODEL_H
+#define TEMPERATUREMODEL_H
+
+class TemperatureModel
+{
+public:
+    TemperatureModel();
+
+    // Steps per degree C assumed before any results, and weighed against them until they span a few degrees.
+    void setPriorSlope(double stepsPerDegree) {
+        priorSlope = stepsPerDegree;
+    }
+
+    // An autofocus result: best focus was at position at temperature. Fits the slope and anchors predictions there.
+    void observe(double position, double temperature);
+    // Anchor predictions at a position chosen at temperature, without learning from it.
+    void anchor(double position, double temperature);
+    // Stop predicting, until the next anchor.
+    void clearAnchor() {
+        anchored = false;
+    }
+    // Forget the anchor and the last result, e.g. on reconnecting. The fitted slope is kept.
+    void endSession();
+    // Forget everything learned.
+    void reset();
+
+    bool hasAnchor() const {
+        return anchored;
+    }
+    double slope() const;
+    // Where focus is at temperature. Only meaningful with an anchor.
+    double predict(double temperature) const;
+
+    int observations() const {
+        return count;
+    }
+    // Root weighted mean square of the temperature changes fitted so far, how well the slope is pinned down.
+    double temperatureSpread() const;
+
+private:
+    double priorSlope;
+    // Exponentially weighted sums of dT * dT, dT * dP and the weights, over pairs of consecutive results.
+    double sumTT, sumTP, sumWeight;
+    int count;
+
+    bool haveLast;
+    double lastPosition, lastTemperature;
+
+    bool anchored;
+    double anchorPosition, anchorTemperature;
+};
+
+#endif
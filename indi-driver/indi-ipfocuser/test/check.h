@@ -0,0 +1,46 @@
+/*******************************************************************************
+  Checks for the host tests.
+
+  A failed check prints where it is and what it found, and the test carries
+  on with the next one. main returns checkResult(), non-zero once any check
+  has failed, which is what ctest goes by.
+*******************************************************************************/
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition))                                                                    \
+        {                                                                                    \
+            checkFailures++;                                                                 \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);    \
+        }                                                                                    \
+    } while (0)
+
+// Integers of any type, compared and printed as long long.
+#define CHECK_EQUAL(expected, actual)                                                        \
+    do {                                                                                     \
+        long long expectedValue = (expected), actualValue = (actual);                        \
+        if (expectedValue != actualValue)                                                    \
+        {                                                                                    \
+            checkFailures++;                                                                 \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %s = %lld\n", __FILE__, __LINE__,   \
+                    #actual, actualValue, #expected, expectedValue);                         \
+        }                                                                                    \
+    } while (0)
+
+static inline int checkResult(const char *test)
+{
+    if (checkFailures)
+        fprintf(stderr, "%s: %d checks failed\n", test, checkFailures);
+    else
+        printf("%s: all checks passed\n", test);
+    return checkFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*******************************************************************************
+  Host test of CurlMulti shutting down with transfers still running.
+
+  A server that accepts connections and never answers keeps transfers
+  in flight. Destroying the CurlMulti must hand every one of them back,
+  whether added to the multi handle or still waiting to be, with
+  CURLE_ABORTED_BY_CALLBACK, long before their timeouts.
+*******************************************************************************/
+#include "check.h"
+#include "curlmulti.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+#define THREADS 4
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// A listening socket nobody accepts on, connections to it complete and then hear nothing. Returns its port.
+static int silentServer(int &fd)
+{
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd < 0 || bind(fd, (sockaddr *)&address, length) || listen(fd, 16) ||
+        getsockname(fd, (sockaddr *)&address, &length))
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+static CURL *request(const std::string &url, long timeoutMs)
+{
+    CURL *easy = curl_easy_init();
+    curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, timeoutMs);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    return easy;
+}
+
+static void testTimeout(const std::string &url)
+{
+    CurlMulti multi;
+    CURL *easy = request(url, 200);
+    CHECK_EQUAL(CURLE_OPERATION_TIMEDOUT, multi.perform(easy));
+    curl_easy_cleanup(easy);
+}
+
+static void testShutdown(const std::string &url)
+{
+    CurlMulti *multi = new CurlMulti();
+    std::vector<CURL *> easies;
+    std::vector<CURLcode> results(THREADS, CURLE_OK);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; i++)
+    {
+        CURL *easy = request(url, 30000);
+        easies.push_back(easy);
+        threads.push_back(std::thread([multi, easy, &results, i] { results[i] = multi->perform(easy); }));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    Clock::time_point start = Clock::now();
+    delete multi;
+    for (std::thread &thread : threads)
+        thread.join();
+    CHECK(secondsSince(start) < 5);
+    for (int i = 0; i < THREADS; i++)
+    {
+        CHECK_EQUAL(CURLE_ABORTED_BY_CALLBACK, results[i]);
+        curl_easy_cleanup(easies[i]);
+    }
+}
+
+int main()
+{
+    int fd;
+    int port = silentServer(fd);
+    CHECK(port != 0);
+    std::string url = "http://127.0.0.1:" + std::to_string(port) + "/focuser";
+    testTimeout(url);
+    testShutdown(url);
+    close(fd);
+    return checkResult("curlmulti_test");
+}
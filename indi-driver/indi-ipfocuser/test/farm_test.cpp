@@ -0,0 +1,299 @@
+/*******************************************************************************
+  Drives the driver's client against the mock focuser farm, one farm run per
+  fault, and checks what the client and its statistics report.
+
+    - no faults: a move takes as long as the motion model says, and ends at
+      its target
+    - --latency: requests are answered, no sooner than the latency
+    - --drop-rate 1: every request fails, and is counted as failed
+    - --hang-rate 1: requests time out and are counted as timeouts, and a
+      focuser powered off refuses connections
+
+  Requests go through RecordingTransport over CurlTransport, as the driver
+  sends them.
+  Usage: farm_test path/to/mock-focuser-farm
+*******************************************************************************/
+#include "check.h"
+#include "curltransport.h"
+#include "focuserclient.h"
+#include "focuserstats.h"
+#include "focusertrace.h"
+#include "motionmodel.h"
+#include "recordingtransport.h"
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Scaled time on the farm, so moves of a few thousand steps take about a second
+#define TIME_SCALE 25
+#define REQUEST_TIMEOUT_MS 2000
+
+static const char *farmPath;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * A port the kernel has free now, for the farm's focuser, with the power switch on the one after it.
+**/
+static int freePort()
+{
+    for (int attempt = 0; attempt < 20; attempt++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        int port = 0;
+        if (fd >= 0 && !bind(fd, (sockaddr *)&address, length) && !getsockname(fd, (sockaddr *)&address, &length))
+            port = ntohs(address.sin_port);
+        close(fd);
+        if (port > 0 && port < 65535)
+            return port;
+    }
+    return 0;
+}
+
+static bool accepts(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    bool ok = fd >= 0 && connect(fd, (sockaddr *)&address, sizeof(address)) == 0;
+    close(fd);
+    return ok;
+}
+
+/**
+ * One focuser on the farm, started with the given fault options and stopped when it goes out of scope.
+**/
+class Farm
+{
+public:
+    explicit Farm(std::vector<std::string> faults) : pid(-1), port(0)
+    {
+        // A port free when picked may be taken by the time the farm binds it, its UDP twin or the power port
+        // taken already, so a farm that exits at once is started again on another
+        for (int attempt = 0; attempt < 5 && !started(); attempt++)
+            start(faults);
+    }
+
+    ~Farm()
+    {
+        if (pid <= 0)
+            return;
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+
+    bool started() const
+    {
+        return pid > 0 && accepts(port);
+    }
+
+    std::string endpoint() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port) + "/focuser";
+    }
+
+    std::string power(const char *state) const
+    {
+        return "http://127.0.0.1:" + std::to_string(port + 1) + "/power/0/" + state;
+    }
+
+private:
+    pid_t pid;
+    int port;
+
+    void start(const std::vector<std::string> &faults)
+    {
+        port = freePort();
+        std::vector<std::string> arguments = {farmPath, "--focusers", "1", "--port", std::to_string(port),
+                                              "--power-port", std::to_string(port + 1), "--time-scale",
+                                              std::to_string(TIME_SCALE), "--boot-ms", "100", "--seed", "1"};
+        arguments.insert(arguments.end(), faults.begin(), faults.end());
+        pid = fork();
+        if (pid == 0)
+        {
+            std::vector<char *> argv;
+            for (std::string &argument : arguments)
+                argv.push_back(&argument[0]);
+            argv.push_back(NULL);
+            freopen("/dev/null", "w", stdout);
+            execv(farmPath, argv.data());
+            _exit(127);
+        }
+        Clock::time_point start = Clock::now();
+        while (pid > 0 && !accepts(port) && secondsSince(start) < 5)
+        {
+            if (waitpid(pid, NULL, WNOHANG) == pid)
+            {
+                pid = -1;
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+};
+
+// The driver's client stack, without the driver.
+struct Client
+{
+    CurlTransport curl;
+    FocuserStats stats;
+    TraceWriter trace;
+    RecordingTransport transport;
+    FocuserClient client;
+
+    explicit Client(const Farm &farm) : transport(curl, stats, trace), client(transport)
+    {
+        client.setEndpoint(farm.endpoint().c_str());
+    }
+};
+
+static void testMoveTiming()
+{
+    Farm farm({});
+    CHECK(farm.started());
+    if (!farm.started())
+        return;
+    Client c(farm);
+    FocuserStatus status;
+    CHECK(c.client.status(status, REQUEST_TIMEOUT_MS));
+    CHECK(status.has(FOCUSER_STATUS_absolutePosition) && status.has(FOCUSER_STATUS_speed) &&
+          status.has(FOCUSER_STATUS_maxSpeed) && status.has(FOCUSER_STATUS_acceleration) &&
+          status.has(FOCUSER_STATUS_gearBoxMultiplier));
+    if (!status.has(FOCUSER_STATUS_absolutePosition))
+        return;
+
+    // No backlash, so the move is one segment whatever the gears did before
+    FocuserKinematics kinematics = {status.speed, status.maxSpeed, status.acceleration, status.gearBoxMultiplier, 0,
+                                    BACKLASH_ON_REVERSAL};
+    MotionModel model;
+    model.setKinematics(kinematics);
+    uint32_t from = status.absolutePosition, to = from + 2000;
+    double expected = model.modelSeconds(from, to) / TIME_SCALE;
+
+    Clock::time_point start = Clock::now();
+    CHECK(c.client.move(to, "0", "none", status, REQUEST_TIMEOUT_MS));
+    CHECK(status.has(FOCUSER_STATUS_moving) && status.moving);
+    while (status.has(FOCUSER_STATUS_moving) && status.moving && secondsSince(start) < expected * 3 + 1)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (!c.client.poll(status, REQUEST_TIMEOUT_MS))
+            break;
+    }
+    double seconds = secondsSince(start);
+    CHECK(status.has(FOCUSER_STATUS_moving) && !status.moving);
+    CHECK_EQUAL(to, status.absolutePosition);
+    if (fabs(seconds - expected) > expected * 0.1 + 0.05)
+    {
+        checkFailures++;
+        fprintf(stderr, "move took %.3f s, the motion model says %.3f s\n", seconds, expected);
+    }
+    CHECK_EQUAL(0, c.stats.get(COUNTER_REQUEST_FAILURES));
+    CHECK(c.stats.get(COUNTER_REQUESTS) >= 2);
+
+    // Told where it is, it reports that without moving
+    CHECK(c.client.sync(10000, REQUEST_TIMEOUT_MS));
+    CHECK(c.client.status(status, REQUEST_TIMEOUT_MS));
+    CHECK_EQUAL(10000, status.absolutePosition);
+}
+
+static void testLatency()
+{
+    Farm farm({"--latency", "150"});
+    CHECK(farm.started());
+    if (!farm.started())
+        return;
+    Client c(farm);
+    FocuserStatus status;
+    Clock::time_point start = Clock::now();
+    CHECK(c.client.status(status, REQUEST_TIMEOUT_MS));
+    CHECK(secondsSince(start) >= 0.15);
+    CHECK_EQUAL(1, c.stats.httpRequest.count());
+    CHECK(c.stats.httpRequest.max() >= 0.15);
+}
+
+static void testDroppedConnections()
+{
+    Farm farm({"--drop-rate", "1"});
+    CHECK(farm.started());
+    if (!farm.started())
+        return;
+    Client c(farm);
+    FocuserStatus status;
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(!c.client.status(status, REQUEST_TIMEOUT_MS));
+        CHECK_EQUAL(TRANSPORT_FAILED, c.client.transportResult());
+        CHECK(c.client.error()[0] != '\0');
+    }
+    CHECK(!c.client.poll(status, REQUEST_TIMEOUT_MS));
+    CHECK_EQUAL(4, c.stats.get(COUNTER_REQUESTS));
+    CHECK_EQUAL(4, c.stats.get(COUNTER_REQUEST_FAILURES));
+    CHECK_EQUAL(0, c.stats.get(COUNTER_TIMEOUTS));
+    CHECK_EQUAL(0, c.stats.httpRequest.count());
+}
+
+static void testHang()
+{
+    Farm farm({"--hang-rate", "1"});
+    CHECK(farm.started());
+    if (!farm.started())
+        return;
+    Client c(farm);
+    FocuserStatus status;
+    Clock::time_point start = Clock::now();
+    CHECK(!c.client.status(status, 300));
+    double seconds = secondsSince(start);
+    CHECK_EQUAL(TRANSPORT_TIMEOUT, c.client.transportResult());
+    // curl times out to the millisecond or so
+    CHECK(seconds >= 0.29 && seconds < 2);
+    CHECK_EQUAL(1, c.stats.get(COUNTER_TIMEOUTS));
+    CHECK_EQUAL(1, c.stats.get(COUNTER_REQUEST_FAILURES));
+
+    // Powered off it refuses connections rather than hanging
+    CHECK(c.client.get(farm.power("off").c_str(), REQUEST_TIMEOUT_MS));
+    start = Clock::now();
+    CHECK(!c.client.status(status, 1000));
+    CHECK_EQUAL(TRANSPORT_FAILED, c.client.transportResult());
+    CHECK(secondsSince(start) < 0.5);
+    CHECK(c.client.get(farm.power("on").c_str(), REQUEST_TIMEOUT_MS));
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: farm_test path/to/mock-focuser-farm\n");
+        return 2;
+    }
+    farmPath = argv[1];
+    signal(SIGPIPE, SIG_IGN);
+    testMoveTiming();
+    testLatency();
+    testDroppedConnections();
+    testHang();
+    return checkResult("farm_test");
+}
@@ -0,0 +1,159 @@
+/*******************************************************************************
+  Host test of the firmware's PositionJournal, on an in-memory EEPROM that
+  can lose power part way through a write.
+
+  Checks a fresh EEPROM of 0xFF bytes takes the default position, that the
+  latest position and the boot count come back across reboots, also once
+  the sequence number wraps past 65535, that a power cut at any byte of a
+  write restores the position before it, and that commit does not write a
+  position that has not changed.
+*******************************************************************************/
+#include "check.h"
+#include "journal.h"
+
+#include <vector>
+
+#define DEFAULT_POSITION 5000
+
+class MemoryStorage : public JournalStorage
+{
+public:
+    std::vector<uint8_t> bytes;
+    // Writes done, and writes left before the power goes, -1 for no cut
+    long writes = 0;
+    long writesLeft = -1;
+
+    MemoryStorage() : bytes(1024, 0xFF)
+    {
+    }
+
+    uint8_t read(uint16_t address) override
+    {
+        return bytes.at(address);
+    }
+
+    void write(uint16_t address, uint8_t value) override
+    {
+        if (writesLeft == 0)
+            return;
+        if (writesLeft > 0)
+            writesLeft--;
+        writes++;
+        bytes.at(address) = value;
+    }
+};
+
+// Power the focuser on with storage as its EEPROM
+static PositionJournal boot(MemoryStorage &storage, bool restores = true)
+{
+    storage.writesLeft = -1;
+    PositionJournal journal(storage);
+    CHECK_EQUAL(restores, journal.begin(DEFAULT_POSITION));
+    CHECK_EQUAL(restores, journal.restored());
+    return journal;
+}
+
+static void testFreshEeprom()
+{
+    MemoryStorage storage;
+    PositionJournal journal = boot(storage, false);
+    CHECK_EQUAL(DEFAULT_POSITION, journal.position());
+    CHECK_EQUAL(1, journal.bootCount());
+
+    journal.commit(1234);
+    PositionJournal second = boot(storage);
+    CHECK_EQUAL(1234, second.position());
+    CHECK_EQUAL(2, second.bootCount());
+    PositionJournal third = boot(storage);
+    CHECK_EQUAL(1234, third.position());
+    CHECK_EQUAL(3, third.bootCount());
+
+    // Nothing else of the EEPROM is touched
+    for (size_t address = JOURNAL_SLOTS * JOURNAL_SLOT_SIZE; address < storage.bytes.size(); address++)
+        CHECK_EQUAL(0xFF, storage.bytes[address]);
+}
+
+static void testUnchangedPosition()
+{
+    MemoryStorage storage;
+    PositionJournal journal = boot(storage, false);
+    long writes = storage.writes;
+    journal.commit(DEFAULT_POSITION);
+    CHECK_EQUAL(writes, storage.writes);
+
+    // The old marker spoiled first, then the slot
+    journal.commit(7000);
+    CHECK_EQUAL(writes + 1 + JOURNAL_SLOT_SIZE, storage.writes);
+    writes = storage.writes;
+    journal.commit(7000);
+    journal.commit(7000);
+    CHECK_EQUAL(writes, storage.writes);
+    CHECK_EQUAL(7000, journal.position());
+}
+
+static void testSequenceWrap()
+{
+    // Far enough past 65535 for the ring to hold slots from both sides of the wrap, rebooting around it
+    MemoryStorage storage;
+    PositionJournal first = boot(storage, false);
+    PositionJournal *journal = &first;
+    std::vector<PositionJournal> rebooted;
+    rebooted.reserve(200);
+    uint16_t boots = 1;
+    for (long i = 0; i < 66000; i++)
+    {
+        int position = 100 + i % 20000;
+        journal->commit(position);
+        if ((i >= 65500 && i <= 65600) || i % 10007 == 0)
+        {
+            rebooted.push_back(boot(storage));
+            journal = &rebooted.back();
+            boots++;
+            CHECK_EQUAL(position, journal->position());
+            CHECK_EQUAL(boots, journal->bootCount());
+            if (journal->position() != position)
+            {
+                fprintf(stderr, "  after commit %ld\n", i);
+                return;
+            }
+        }
+    }
+}
+
+static void testPowerCut()
+{
+    // A cut at every write of a commit, into a blank slot and into one the ring wrote before
+    for (int history : {0, JOURNAL_SLOTS + 3})
+    {
+        for (long cut = 0; cut <= 1 + JOURNAL_SLOT_SIZE; cut++)
+        {
+            MemoryStorage storage;
+            PositionJournal journal = boot(storage, false);
+            for (int i = 0; i < history; i++)
+                journal.commit(2000 + i);
+            journal.commit(3000);
+            storage.writesLeft = cut;
+            journal.commit(4000);
+
+            // Only a slot written to the end is taken, otherwise the one before it
+            PositionJournal rebooted = boot(storage);
+            int expected = cut == 1 + JOURNAL_SLOT_SIZE ? 4000 : 3000;
+            CHECK_EQUAL(expected, rebooted.position());
+            if (rebooted.position() != expected)
+                fprintf(stderr, "  for a cut after %ld writes, %d commits before\n", cut, history);
+
+            // and journaling carries on from there
+            rebooted.commit(5000);
+            CHECK_EQUAL(5000, boot(storage).position());
+        }
+    }
+}
+
+int main()
+{
+    testFreshEeprom();
+    testUnchangedPosition();
+    testSequenceWrap();
+    testPowerCut();
+    return checkResult("journal_test");
+}
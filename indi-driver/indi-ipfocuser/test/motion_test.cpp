@@ -0,0 +1,232 @@
+/*******************************************************************************
+  Host test of the firmware's FocuserMotion, on a StepDriver that only
+  steps when told to.
+
+  Checks the segments each move is handed to the driver as, backlash legs
+  included, the position followed during and after a move, and that a move
+  requested while one runs waits for it, the latest request replacing any
+  already waiting.
+*******************************************************************************/
+#include "check.h"
+#include "motion.h"
+
+#include <algorithm>
+#include <vector>
+
+#define STEPS_PER_REVOLUTION 200
+#define GEARBOX 10
+
+// rpm for moves and for backlash, and the step rates FocuserMotion turns them into
+#define SPEED_RPM 60
+#define BACKLASH_RPM 120
+#define SPEED_STEPS (SPEED_RPM * STEPS_PER_REVOLUTION / 60)
+#define BACKLASH_STEPS_RATE (BACKLASH_RPM * STEPS_PER_REVOLUTION / 60)
+#define ACCELERATION 1000
+#define BACKLASH 20
+
+class FakeStepDriver : public StepDriver
+{
+public:
+    struct Segment
+    {
+        int8_t direction;
+        int32_t steps;
+        uint32_t speed;
+        uint32_t acceleration;
+    };
+
+    std::vector<Segment> started;
+    int32_t done = 0;
+
+    void start(int8_t direction, int32_t steps, uint32_t speed, uint32_t acceleration) override
+    {
+        Segment segment = {direction, steps, speed, acceleration};
+        started.push_back(segment);
+        done = 0;
+    }
+
+    int32_t stepsDone() override
+    {
+        return done;
+    }
+
+    bool isRunning() override
+    {
+        return !started.empty() && done < started.back().steps;
+    }
+
+    void advance(int32_t steps)
+    {
+        done = std::min(done + steps, started.back().steps);
+    }
+
+    void finish()
+    {
+        if (!started.empty())
+            done = started.back().steps;
+    }
+};
+
+static MoveRequest request(int target, int8_t strategy, int backlashSteps = BACKLASH, int acceleration = ACCELERATION)
+{
+    MoveRequest move = {target, SPEED_RPM, BACKLASH_RPM, acceleration, backlashSteps, strategy};
+    return move;
+}
+
+static void checkSegment(const FakeStepDriver &driver, size_t index, int8_t direction, int32_t steps, uint32_t speed)
+{
+    CHECK(index < driver.started.size());
+    if (index >= driver.started.size())
+        return;
+    const FakeStepDriver::Segment &segment = driver.started[index];
+    CHECK_EQUAL(direction, segment.direction);
+    CHECK_EQUAL(steps, segment.steps);
+    CHECK_EQUAL(speed, segment.speed);
+}
+
+// Finish segments until the move and any waiting one are done. Returns how many segments were run.
+static size_t runToEnd(FocuserMotion &motion, FakeStepDriver &driver)
+{
+    size_t before = driver.started.size();
+    for (int i = 0; i < 100 && motion.isMoving(); i++)
+    {
+        driver.finish();
+        motion.run();
+    }
+    CHECK(!motion.isMoving());
+    return driver.started.size() - before;
+}
+
+static void testMoveAgainstApproach()
+{
+    FakeStepDriver driver;
+    FocuserMotion motion(driver, STEPS_PER_REVOLUTION, GEARBOX);
+    motion.setPosition(1000);
+
+    // CW, against the CCW approach: the move, past the target by the backlash, and back CCW
+    motion.moveTo(request(900, BACKLASH_APPROACH_CCW));
+    CHECK(motion.isMoving());
+    CHECK_EQUAL(900, motion.targetPosition());
+    checkSegment(driver, 0, 1, 100 * GEARBOX, SPEED_STEPS);
+    CHECK_EQUAL(ACCELERATION, driver.started[0].acceleration);
+
+    // Followed as it moves, CW towards lower positions
+    driver.advance(300);
+    motion.run();
+    CHECK_EQUAL(970, motion.position());
+
+    driver.finish();
+    motion.run();
+    CHECK_EQUAL(900, motion.position());
+    checkSegment(driver, 1, 1, BACKLASH * GEARBOX, BACKLASH_STEPS_RATE);
+
+    // Backlash legs leave the position alone
+    driver.advance(100);
+    motion.run();
+    CHECK_EQUAL(900, motion.position());
+    driver.finish();
+    motion.run();
+    checkSegment(driver, 2, -1, BACKLASH * GEARBOX, BACKLASH_STEPS_RATE);
+
+    CHECK_EQUAL(0, runToEnd(motion, driver));
+    CHECK_EQUAL(900, motion.position());
+    CHECK_EQUAL(3, driver.started.size());
+
+    // The gears were left loaded CCW, so a CCW move runs straight
+    motion.moveTo(request(1000, BACKLASH_APPROACH_CCW));
+    checkSegment(driver, 3, -1, 100 * GEARBOX, SPEED_STEPS);
+    CHECK_EQUAL(0, runToEnd(motion, driver));
+    CHECK_EQUAL(1000, motion.position());
+
+    // Reversing takes up the slack first, the move only tracks position once that is done
+    motion.moveTo(request(950, BACKLASH_ON_REVERSAL));
+    checkSegment(driver, 4, 1, BACKLASH * GEARBOX, BACKLASH_STEPS_RATE);
+    driver.advance(100);
+    motion.run();
+    CHECK_EQUAL(1000, motion.position());
+    driver.finish();
+    motion.run();
+    checkSegment(driver, 5, 1, 50 * GEARBOX, SPEED_STEPS);
+    driver.advance(250);
+    motion.run();
+    CHECK_EQUAL(975, motion.position());
+    CHECK_EQUAL(0, runToEnd(motion, driver));
+    CHECK_EQUAL(950, motion.position());
+}
+
+static void testNoBacklash()
+{
+    FakeStepDriver driver;
+    FocuserMotion motion(driver, STEPS_PER_REVOLUTION, GEARBOX);
+    motion.setPosition(1000);
+    motion.moveTo(request(900, BACKLASH_APPROACH_CCW, 0));
+    CHECK_EQUAL(0, runToEnd(motion, driver));
+    checkSegment(driver, 0, 1, 100 * GEARBOX, SPEED_STEPS);
+    CHECK_EQUAL(900, motion.position());
+
+    // Nothing to do for a move to where it is
+    motion.moveTo(request(900, BACKLASH_APPROACH_CCW));
+    CHECK(!motion.isMoving());
+    CHECK_EQUAL(1, driver.started.size());
+
+    // No acceleration below 0
+    motion.moveTo(request(800, BACKLASH_ON_REVERSAL, 0, -5));
+    CHECK_EQUAL(0, driver.started.back().acceleration);
+}
+
+static void testPendingMove()
+{
+    FakeStepDriver driver;
+    FocuserMotion motion(driver, STEPS_PER_REVOLUTION, GEARBOX);
+    motion.setPosition(5000);
+    motion.moveTo(request(4000, BACKLASH_ON_REVERSAL));
+    checkSegment(driver, 0, 1, 1000 * GEARBOX, SPEED_STEPS);
+    driver.advance(5000);
+    motion.run();
+    CHECK_EQUAL(4500, motion.position());
+
+    // Both wait for the running move, the later one replacing the earlier
+    motion.moveTo(request(4800, BACKLASH_ON_REVERSAL));
+    motion.moveTo(request(4200, BACKLASH_ON_REVERSAL));
+    CHECK_EQUAL(1, driver.started.size());
+    CHECK_EQUAL(4200, motion.targetPosition());
+    motion.run();
+    CHECK_EQUAL(4500, motion.position());
+
+    // The running move completes, then 4200 is planned from 4000, reversing
+    driver.finish();
+    motion.run();
+    CHECK_EQUAL(4000, motion.position());
+    checkSegment(driver, 1, -1, BACKLASH * GEARBOX, BACKLASH_STEPS_RATE);
+    CHECK_EQUAL(1, runToEnd(motion, driver));
+    checkSegment(driver, 2, -1, 200 * GEARBOX, SPEED_STEPS);
+    CHECK_EQUAL(3, driver.started.size());
+    CHECK_EQUAL(4200, motion.position());
+    CHECK_EQUAL(4200, motion.targetPosition());
+}
+
+static void testSequenceLeg()
+{
+    FakeStepDriver driver;
+    FocuserMotion motion(driver, STEPS_PER_REVOLUTION, GEARBOX);
+    motion.setPosition(2000);
+    motion.moveTo(request(2100, BACKLASH_ON_REVERSAL));
+    runToEnd(motion, driver);
+
+    // A CW approached leg to where it is, with the gears loaded CCW: past CCW and back, the position unchanged
+    motion.moveTo(request(2100, BACKLASH_ON_REVERSAL), BACKLASH_APPROACH_CW);
+    CHECK(motion.isMoving());
+    CHECK_EQUAL(1, runToEnd(motion, driver));
+    checkSegment(driver, 1, -1, BACKLASH * GEARBOX, BACKLASH_STEPS_RATE);
+    checkSegment(driver, 2, 1, 2 * BACKLASH * GEARBOX, BACKLASH_STEPS_RATE);
+    CHECK_EQUAL(2100, motion.position());
+}
+
+int main()
+{
+    testMoveAgainstApproach();
+    testNoBacklash();
+    testPendingMove();
+    testSequenceLeg();
+    return checkResult("motion_test");
+}
@@ -0,0 +1,238 @@
+/*******************************************************************************
+  Host test of planMove and backlashStrategyFromText, the move planner the
+  firmware and the driver share.
+
+  Checks the segments planned for each backlash strategy, moving with and
+  against the approach way, how the loaded direction one plan leaves
+  changes the next, the legs of a move sequence, focusers without
+  backlash, and the strategy names alwaysApproach accepts.
+*******************************************************************************/
+#include "check.h"
+#include "planner.h"
+
+#include <string.h>
+
+#include <string>
+
+#define GEARBOX 10
+#define SPEED_RPM 60
+#define BACKLASH_RPM 120
+#define BACKLASH 20
+
+struct Expected
+{
+    int8_t direction;
+    int32_t steps;
+    int rpm;
+    bool tracksPosition;
+};
+
+static Expected move(int8_t direction, int32_t steps)
+{
+    Expected segment = {direction, steps * GEARBOX, SPEED_RPM, true};
+    return segment;
+}
+
+static Expected slack(int8_t direction, int32_t steps)
+{
+    Expected segment = {direction, steps * GEARBOX, BACKLASH_RPM, false};
+    return segment;
+}
+
+/**
+ * Plan a move from position to target and check it is the expected segments, and leaves the gears loaded the way the
+ * last of them ran.
+**/
+static void checkPlan(int position, int target, int8_t strategy, int8_t approach, PlannerState &state,
+                      const Expected *expected, uint8_t count, int backlashSteps = BACKLASH)
+{
+    MoveRequest request = {target, SPEED_RPM, BACKLASH_RPM, 1000, backlashSteps, strategy};
+    int8_t loaded = state.loadedDirection;
+    MotionPlan plan;
+    planMove(position, request, approach, GEARBOX, state, plan);
+    int failures = checkFailures;
+    CHECK_EQUAL(count, plan.count);
+    for (uint8_t i = 0; i < count && i < plan.count; i++)
+    {
+        CHECK_EQUAL(expected[i].direction, plan.segments[i].direction);
+        CHECK_EQUAL(expected[i].steps, plan.segments[i].steps);
+        CHECK_EQUAL(expected[i].rpm, plan.segments[i].rpm);
+        CHECK_EQUAL(expected[i].tracksPosition, plan.segments[i].tracksPosition);
+    }
+    CHECK_EQUAL(count ? expected[count - 1].direction : loaded, state.loadedDirection);
+    if (checkFailures != failures)
+        fprintf(stderr, "  for %d to %d, strategy %d, approach %d, loaded %d\n", position, target, strategy, approach,
+                loaded);
+}
+
+// The plan from position to target, with the segments listed after state
+#define CHECK_PLAN(position, target, strategy, approach, state, ...)                                      \
+    do {                                                                                                  \
+        const Expected expected[] = {__VA_ARGS__};                                                        \
+        checkPlan(position, target, strategy, approach, state, expected,                                  \
+                  sizeof(expected) / sizeof(expected[0]));                                                \
+    } while (0)
+
+static void testOnReversal()
+{
+    PlannerState state = {0};
+    // Nothing known about the gears at power on, so no slack is taken up
+    CHECK_PLAN(1000, 900, BACKLASH_ON_REVERSAL, 0, state, move(1, 100));
+    CHECK_PLAN(900, 800, BACKLASH_ON_REVERSAL, 0, state, move(1, 100));
+    CHECK_PLAN(800, 950, BACKLASH_ON_REVERSAL, 0, state, slack(-1, BACKLASH), move(-1, 150));
+    CHECK_PLAN(950, 1000, BACKLASH_ON_REVERSAL, 0, state, move(-1, 50));
+    CHECK_PLAN(1000, 990, BACKLASH_ON_REVERSAL, 0, state, slack(1, BACKLASH), move(1, 10));
+
+    // No move, no plan, and the gears stay as they were
+    checkPlan(990, 990, BACKLASH_ON_REVERSAL, 0, state, NULL, 0);
+    CHECK_EQUAL(1, state.loadedDirection);
+}
+
+static void testApproachCcw()
+{
+    // CW, against the approach: past the target and back, by twice the backlash once the gears are loaded CW
+    PlannerState state = {0};
+    CHECK_PLAN(1000, 900, BACKLASH_APPROACH_CCW, 0, state, move(1, 100), slack(1, BACKLASH), slack(-1, BACKLASH));
+    state.loadedDirection = 1;
+    CHECK_PLAN(1000, 900, BACKLASH_APPROACH_CCW, 0, state, move(1, 100), slack(1, BACKLASH), slack(-1, 2 * BACKLASH));
+    CHECK_PLAN(900, 800, BACKLASH_APPROACH_CCW, 0, state, move(1, 100), slack(1, BACKLASH), slack(-1, BACKLASH));
+
+    // CCW, the approach way: straight there, taking up the slack first if the gears were loaded CW
+    CHECK_PLAN(800, 850, BACKLASH_APPROACH_CCW, 0, state, move(-1, 50));
+    state.loadedDirection = 1;
+    CHECK_PLAN(850, 900, BACKLASH_APPROACH_CCW, 0, state, slack(-1, BACKLASH), move(-1, 50));
+}
+
+static void testApproachCw()
+{
+    PlannerState state = {0};
+    CHECK_PLAN(900, 1000, BACKLASH_APPROACH_CW, 0, state, move(-1, 100), slack(-1, BACKLASH), slack(1, BACKLASH));
+    CHECK_PLAN(1000, 950, BACKLASH_APPROACH_CW, 0, state, move(1, 50));
+    state.loadedDirection = -1;
+    CHECK_PLAN(950, 900, BACKLASH_APPROACH_CW, 0, state, slack(1, BACKLASH), move(1, 50));
+    state.loadedDirection = -1;
+    CHECK_PLAN(900, 1000, BACKLASH_APPROACH_CW, 0, state, move(-1, 100), slack(-1, BACKLASH), slack(1, 2 * BACKLASH));
+}
+
+static void testSequenceLegs()
+{
+    // The leg's approach overrides the request's strategy, whatever it is
+    PlannerState state = {-1};
+    CHECK_PLAN(900, 1000, BACKLASH_APPROACH_CCW, BACKLASH_APPROACH_CW, state, move(-1, 100), slack(-1, BACKLASH),
+               slack(1, 2 * BACKLASH));
+    CHECK_PLAN(1000, 950, BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CW, state, move(1, 50));
+
+    // A first leg to where the focuser is still takes up slack left on the wrong side, going past and back
+    state.loadedDirection = -1;
+    CHECK_PLAN(950, 950, BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CW, state, slack(-1, BACKLASH),
+               slack(1, 2 * BACKLASH));
+    state.loadedDirection = 1;
+    CHECK_PLAN(950, 950, BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CCW, state, slack(1, BACKLASH),
+               slack(-1, 2 * BACKLASH));
+
+    // but not if the gears are already loaded the approach way, or nothing is known about them
+    checkPlan(950, 950, BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CCW, state, NULL, 0);
+    state.loadedDirection = 0;
+    checkPlan(950, 950, BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CW, state, NULL, 0);
+    CHECK_EQUAL(0, state.loadedDirection);
+
+    // Every leg after the first is reached from the same side without paying for backlash again
+    state.loadedDirection = -1;
+    const int targets[] = {1000, 1100, 1200, 1300};
+    int position = 950;
+    CHECK_PLAN(position, targets[0], BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CCW, state, move(-1, 50));
+    for (int i = 1; i < 4; i++)
+    {
+        position = targets[i - 1];
+        CHECK_PLAN(position, targets[i], BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CCW, state, move(-1, 100));
+    }
+}
+
+static void testNoBacklash()
+{
+    // Only the move, whichever way it goes, and the gears left loaded the way it went
+    PlannerState state = {0};
+    const int8_t strategies[] = {BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CW, BACKLASH_APPROACH_CCW};
+    for (int8_t strategy : strategies)
+    {
+        const Expected cw[] = {move(1, 100)};
+        const Expected ccw[] = {move(-1, 100)};
+        checkPlan(1000, 900, strategy, 0, state, cw, 1, 0);
+        checkPlan(900, 1000, strategy, 0, state, ccw, 1, 0);
+        // A negative backlash is none
+        checkPlan(1000, 900, strategy, 0, state, cw, 1, -5);
+    }
+    // and a sequence leg to where it is does nothing
+    state.loadedDirection = -1;
+    checkPlan(900, 900, BACKLASH_ON_REVERSAL, BACKLASH_APPROACH_CW, state, NULL, 0, 0);
+    CHECK_EQUAL(-1, state.loadedDirection);
+}
+
+static void testLongMove()
+{
+    // More motor steps than a 16 bit int holds, as on the AVR
+    PlannerState state = {0};
+    MoveRequest request = {0, SPEED_RPM, BACKLASH_RPM, 0, 1000, BACKLASH_APPROACH_CCW};
+    MotionPlan plan;
+    planMove(30000, request, 0, 100, state, plan);
+    CHECK_EQUAL(3, plan.count);
+    CHECK_EQUAL(3000000, plan.segments[0].steps);
+    CHECK_EQUAL(100000, plan.segments[1].steps);
+}
+
+static void checkStrategy(const char *text, bool known, int8_t expected)
+{
+    int8_t strategy = 99;
+    int failures = checkFailures;
+    CHECK_EQUAL(known, backlashStrategyFromText(text, strlen(text), strategy));
+    CHECK_EQUAL(known ? expected : 99, strategy);
+    if (checkFailures != failures)
+        fprintf(stderr, "  for \"%s\"\n", text);
+}
+
+static void testStrategyNames()
+{
+    checkStrategy("CW", true, BACKLASH_APPROACH_CW);
+    checkStrategy("CCW", true, BACKLASH_APPROACH_CCW);
+    checkStrategy("TRUE", true, BACKLASH_APPROACH_CCW);
+    checkStrategy("", true, BACKLASH_ON_REVERSAL);
+    checkStrategy("NONE", true, BACKLASH_ON_REVERSAL);
+    checkStrategy("FALSE", true, BACKLASH_ON_REVERSAL);
+    checkStrategy("cw", true, BACKLASH_APPROACH_CW);
+    checkStrategy("Ccw", true, BACKLASH_APPROACH_CCW);
+    checkStrategy("true", true, BACKLASH_APPROACH_CCW);
+    checkStrategy("none", true, BACKLASH_ON_REVERSAL);
+
+    // Anything else leaves the strategy alone
+    checkStrategy("SIDEWAYS", false, 0);
+    checkStrategy("C", false, 0);
+    checkStrategy("CWW", false, 0);
+    checkStrategy("CCWX", false, 0);
+    checkStrategy("1", false, 0);
+    checkStrategy("FALSEY", false, 0);
+
+    // However long, a strategy name is not
+    std::string longText(256, ' ');
+    checkStrategy(longText.c_str(), false, 0);
+    longText = "CW" + std::string(256, ' ');
+    checkStrategy(longText.c_str(), false, 0);
+
+    // The text is read for length bytes only
+    int8_t strategy = 99;
+    CHECK(backlashStrategyFromText("CCW&amp;speed=60", 3, strategy));
+    CHECK_EQUAL(BACKLASH_APPROACH_CCW, strategy);
+    CHECK(backlashStrategyFromText("CW HTTP/1.1", 2, strategy));
+    CHECK_EQUAL(BACKLASH_APPROACH_CW, strategy);
+}
+
+int main()
+{
+    testOnReversal();
+    testApproachCcw();
+    testApproachCw();
+    testSequenceLegs();
+    testNoBacklash();
+    testLongMove();
+    testStrategyNames();
+    return checkResult("planner_test");
+}
@@ -0,0 +1,174 @@
+/*******************************************************************************
+  Host test of the firmware's StepRamp, the trapezoidal step timing run
+  from the step timer interrupt.
+
+  Each move is run to completion as the interrupt runs it, begin() then
+  nextInterval() after every step until it returns 0, and the pulse
+  timeline checked: as many steps as asked for, every interval fitting
+  OCR1A, deceleration mirroring acceleration, cruise at the requested speed,
+  and short moves turning round before they reach it.
+*******************************************************************************/
+#include "check.h"
+#include "ramp.h"
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+// The firmware's Timer1, F_CPU / 64
+#define TIMER_HZ 250000
+#define MAX_TICKS 0xFFFF
+
+static uint32_t cruiseTicks(uint32_t speed, uint32_t timerHz)
+{
+    uint32_t ticks = timerHz / speed;
+    return ticks < 1 ? 1 : ticks > MAX_TICKS ? MAX_TICKS : ticks;
+}
+
+/**
+ * The intervals before each step of a move, as the interrupt gets them.
+**/
+static std::vector<uint32_t> runRamp(int32_t steps, uint32_t speed, uint32_t acceleration, uint32_t timerHz = TIMER_HZ)
+{
+    StepRamp ramp;
+    std::vector<uint32_t> intervals;
+    uint32_t interval = ramp.begin(steps, speed, acceleration, timerHz);
+    // Stop a ramp that runs on rather than hang, the count check below reports it
+    while (interval != 0 && intervals.size() <= (size_t)steps)
+    {
+        intervals.push_back(interval);
+        interval = ramp.nextInterval();
+    }
+    CHECK_EQUAL(steps, ramp.stepsDone());
+    return intervals;
+}
+
+/**
+ * The checks that hold for every move.
+**/
+static void checkProfile(int32_t steps, uint32_t speed, uint32_t acceleration, uint32_t timerHz = TIMER_HZ)
+{
+    std::vector<uint32_t> intervals = runRamp(steps, speed, acceleration, timerHz);
+    size_t n = intervals.size();
+    CHECK_EQUAL(steps, n);
+    if (n != (size_t)steps)
+    {
+        fprintf(stderr, "  for %d steps at %u steps/s, %u steps/s/s\n", steps, speed, acceleration);
+        return;
+    }
+    uint32_t cruise = cruiseTicks(speed, timerHz);
+    size_t fastest = std::min_element(intervals.begin(), intervals.end()) - intervals.begin();
+    int failures = checkFailures;
+    for (size_t i = 0; i < n; i++)
+    {
+        CHECK(intervals[i] >= 1 && intervals[i] <= MAX_TICKS);
+        CHECK(intervals[i] >= cruise);
+        if (acceleration == 0)
+            CHECK_EQUAL(cruise, intervals[i]);
+        // Speeding up to the fastest step, slowing down after it
+        if (i > 0 && i <= fastest)
+            CHECK(intervals[i] <= intervals[i - 1]);
+        if (i > fastest)
+            CHECK(intervals[i] >= intervals[i - 1]);
+    }
+
+    // As many steps slowing down as speeding up. A move that reaches cruise decelerates from the cruise interval
+    // rather than from the shorter one the ramp overshot it with, so the mirrored intervals may be up to
+    // 2 / (4 * rampSteps - 1) longer. Slowing down more gently than it sped up never stalls the motor.
+    size_t rampSteps = 0;
+    while (rampSteps < n && intervals[rampSteps] > cruise)
+        rampSteps++;
+    if (rampSteps < n)
+    {
+        size_t slowingSteps = 0;
+        while (slowingSteps < n && intervals[n - 1 - slowingSteps] > cruise)
+            slowingSteps++;
+        CHECK_EQUAL(rampSteps, slowingSteps);
+    }
+    double slack = rampSteps == 0 ? 0 : rampSteps < n ? 2.0 / (4 * rampSteps - 1) : 0.005;
+    for (size_t i = 0; i < n / 2; i++)
+    {
+        CHECK(intervals[n - 1 - i] + 1 >= intervals[i]);
+        CHECK(intervals[n - 1 - i] <= intervals[i] * (1 + slack) + 1);
+    }
+    if (checkFailures != failures)
+        fprintf(stderr, "  for %d steps at %u steps/s, %u steps/s/s, %u Hz\n", steps, speed, acceleration, timerHz);
+}
+
+static void testProfiles()
+{
+    const int32_t steps[] = {1, 2, 3, 4, 5, 10, 33, 100, 101, 1000, 20000};
+    const uint32_t speeds[] = {50, 933, 4000};
+    const uint32_t accelerations[] = {0, 1, 500, 2000, 100000};
+    for (int32_t count : steps)
+        for (uint32_t speed : speeds)
+            for (uint32_t acceleration : accelerations)
+                checkProfile(count, speed, acceleration);
+}
+
+static void testCruise()
+{
+    // 1000 steps/s at 2000 steps/s/s: up to speed in 0.5 s, over 250 steps
+    std::vector<uint32_t> intervals = runRamp(20000, 1000, 2000);
+    CHECK_EQUAL(cruiseTicks(1000, TIMER_HZ), *std::min_element(intervals.begin(), intervals.end()));
+    CHECK_EQUAL(250, intervals[10000]);
+    double rampTicks = 0;
+    size_t rampSteps = 0;
+    while (rampSteps < intervals.size() && intervals[rampSteps] > 250)
+        rampTicks += intervals[rampSteps++];
+    CHECK(fabs(rampSteps - 250.0) <= 250 * 0.05);
+    CHECK(fabs(rampTicks / TIMER_HZ - 0.5) <= 0.5 * 0.05);
+}
+
+static void testTriangle()
+{
+    // 100 steps at 2000 steps/s/s turns round halfway, at sqrt(2 * 2000 * 50) = 447 steps/s, short of 1000
+    std::vector<uint32_t> intervals = runRamp(100, 1000, 2000);
+    uint32_t fastest = *std::min_element(intervals.begin(), intervals.end());
+    CHECK(fastest > cruiseTicks(1000, TIMER_HZ));
+    CHECK(fabs(fastest - TIMER_HZ / 447.0) <= TIMER_HZ / 447.0 * 0.05);
+    // The two middle steps of an even move are the fastest
+    CHECK_EQUAL(fastest, intervals[49]);
+    CHECK_EQUAL(fastest, intervals[50]);
+
+    // Two steps are both the first step's interval, one step is just that
+    std::vector<uint32_t> two = runRamp(2, 1000, 2000);
+    CHECK_EQUAL(2, two.size());
+    if (two.size() == 2)
+        CHECK_EQUAL(two[0], two[1]);
+    CHECK_EQUAL(1, runRamp(1, 1000, 2000).size());
+}
+
+static void testLowestAcceleration()
+{
+    // The first interval at 1 step/s/s is far beyond 16 bits, and at faster timers beyond 32 bits before it is clamped
+    const uint32_t timers[] = {TIMER_HZ, 2000000, 16000000, 20000000};
+    for (uint32_t timerHz : timers)
+    {
+        std::vector<uint32_t> intervals = runRamp(50, 100, 1, timerHz);
+        CHECK(!intervals.empty() && intervals[0] == MAX_TICKS);
+        checkProfile(50, 100, 1, timerHz);
+        checkProfile(3, 4000, 1, timerHz);
+    }
+}
+
+static void testFasterThanTimer()
+{
+    // Asked for more steps per second than the timer ticks, every step still comes, one tick apart
+    std::vector<uint32_t> intervals = runRamp(100, 1000000, 0);
+    CHECK_EQUAL(100, intervals.size());
+    CHECK(std::all_of(intervals.begin(), intervals.end(), [](uint32_t interval) { return interval == 1; }));
+    checkProfile(100, 1000000, 100000000);
+}
+
+int main()
+{
+    testProfiles();
+    testCruise();
+    testTriangle();
+    testLowestAcceleration();
+    testFasterThanTimer();
+    return checkResult("ramp_test");
+}
@@ -0,0 +1,205 @@
+/*******************************************************************************
+  Host test of the firmware's parseRequest, the single pass parser of the
+  HTTP request line.
+
+  Checks the routes, both query separators, arguments that are empty or
+  missing, numbers out of range, sequences longer than the firmware keeps,
+  alwaysApproach, and request lines that are not GET or end early.
+*******************************************************************************/
+#include "check.h"
+#include "planner.h"
+#include "request.h"
+
+#include <string.h>
+
+static bool parse(const char *line, FocuserRequest &request)
+{
+    return parseRequest(line, strlen(line), request);
+}
+
+static void testRoutes()
+{
+    FocuserRequest request;
+    CHECK(parse("GET /focuser HTTP/1.1\r\nHost: 192.168.1.203\r\n\r\n", request));
+    CHECK_EQUAL(ROUTE_STATUS, request.route);
+    CHECK(!request.hasQuery);
+
+    CHECK(parse("GET /focuser/p HTTP/1.1\r\n", request));
+    CHECK_EQUAL(ROUTE_COMPACT, request.route);
+    CHECK(!request.hasQuery);
+    CHECK(parse("GET /focuser/p", request));
+    CHECK_EQUAL(ROUTE_COMPACT, request.route);
+
+    // Anything else under /focuser is the status, as it always was, its query ignored
+    CHECK(parse("GET /focuser/px HTTP/1.1", request));
+    CHECK_EQUAL(ROUTE_STATUS, request.route);
+    CHECK(parse("GET /focuser/p?speed=5 HTTP/1.1", request));
+    CHECK_EQUAL(ROUTE_STATUS, request.route);
+    CHECK(!request.hasQuery);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.speed);
+
+    CHECK(parse("GET /focuser? HTTP/1.1", request));
+    CHECK_EQUAL(ROUTE_STATUS, request.route);
+    CHECK(request.hasQuery);
+
+    CHECK(parse("GET /favicon.ico HTTP/1.1", request));
+    CHECK_EQUAL(ROUTE_NOT_FOUND, request.route);
+}
+
+static void testSeparators()
+{
+    FocuserRequest request;
+    CHECK(parse("GET /focuser?speed=10&amp;maxSpeed=20&acceleration=30&amp;syncPosition=40 HTTP/1.1", request));
+    CHECK_EQUAL(10, request.speed);
+    CHECK_EQUAL(20, request.maxSpeed);
+    CHECK_EQUAL(30, request.acceleration);
+    CHECK_EQUAL(40, request.syncPosition);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.absolutePosition);
+
+    // Doubled, leading and trailing separators are skipped
+    CHECK(parse("GET /focuser?&amp;&backlashSteps=7&&amp;absolutePosition=8& HTTP/1.1", request));
+    CHECK_EQUAL(7, request.backlashSteps);
+    CHECK_EQUAL(8, request.absolutePosition);
+}
+
+static void testAbsentArguments()
+{
+    FocuserRequest request;
+    // An empty value is the same as no key at all, as is a key without '='
+    CHECK(parse("GET /focuser?speed=&amp;maxSpeed&amp;acceleration=5 HTTP/1.1", request));
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.speed);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.maxSpeed);
+    CHECK_EQUAL(5, request.acceleration);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.absolutePosition);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.backlashSteps);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.syncPosition);
+    CHECK_EQUAL(REQUEST_STRATEGY_ABSENT, request.alwaysApproach);
+    CHECK(!request.hasSequence);
+
+    // Unknown keys and keys that only start like known ones are ignored
+    CHECK(parse("GET /focuser?speedy=3&amp;spee=4&amp;foo=5 HTTP/1.1", request));
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.speed);
+}
+
+static void testNumbers()
+{
+    FocuserRequest request;
+    CHECK(parse("GET /focuser?absolutePosition=32767&amp;speed=32768&amp;maxSpeed=999999999999 HTTP/1.1", request));
+    CHECK_EQUAL(32767, request.absolutePosition);
+    CHECK_EQUAL(32767, request.speed);
+    CHECK_EQUAL(32767, request.maxSpeed);
+
+    CHECK(parse("GET /focuser?syncPosition=-12&amp;backlashSteps=-99999&amp;acceleration=+15 HTTP/1.1", request));
+    CHECK_EQUAL(-12, request.syncPosition);
+    CHECK_EQUAL(-32767, request.backlashSteps);
+    CHECK_EQUAL(15, request.acceleration);
+
+    // Read as atoi() reads them: up to the first non digit, 0 if there is none
+    CHECK(parse("GET /focuser?speed=12abc&amp;maxSpeed=abc&amp;acceleration=- HTTP/1.1", request));
+    CHECK_EQUAL(12, request.speed);
+    CHECK_EQUAL(0, request.maxSpeed);
+    CHECK_EQUAL(0, request.acceleration);
+}
+
+static void testSequence()
+{
+    FocuserRequest request;
+    CHECK(parse("GET /focuser?sequence=9000,9100,9200&amp;backlashSteps=100 HTTP/1.1", request));
+    CHECK(request.hasSequence);
+    CHECK_EQUAL(3, request.sequenceLength);
+    CHECK_EQUAL(9000, request.sequence[0]);
+    CHECK_EQUAL(9200, request.sequence[2]);
+    CHECK_EQUAL(100, request.backlashSteps);
+
+    // Only the first REQUEST_MAX_SEQUENCE positions are kept, the rest of the list is still skipped
+    CHECK(parse("GET /focuser?sequence=1,2,3,4,5,6,7,8,9,10,11,12&amp;speed=60 HTTP/1.1", request));
+    CHECK_EQUAL(REQUEST_MAX_SEQUENCE, request.sequenceLength);
+    for (int i = 0; i < REQUEST_MAX_SEQUENCE; i++)
+        CHECK_EQUAL(i + 1, request.sequence[i]);
+    CHECK_EQUAL(60, request.speed);
+
+    // Positions that are not positive are dropped
+    CHECK(parse("GET /focuser?sequence=0,-5,100,x,200 HTTP/1.1", request));
+    CHECK_EQUAL(2, request.sequenceLength);
+    CHECK_EQUAL(100, request.sequence[0]);
+    CHECK_EQUAL(200, request.sequence[1]);
+
+    // A list with nothing in it is still a sequence, an empty value is not
+    CHECK(parse("GET /focuser?sequence=, HTTP/1.1", request));
+    CHECK(request.hasSequence);
+    CHECK_EQUAL(0, request.sequenceLength);
+    CHECK(parse("GET /focuser?sequence= HTTP/1.1", request));
+    CHECK(!request.hasSequence);
+}
+
+static void testAlwaysApproach()
+{
+    struct
+    {
+        const char *query;
+        int8_t strategy;
+    } cases[] = {
+        {"alwaysApproach=CW", BACKLASH_APPROACH_CW},
+        {"alwaysApproach=ccw", BACKLASH_APPROACH_CCW},
+        {"alwaysApproach=true", BACKLASH_APPROACH_CCW},
+        {"alwaysApproach=", BACKLASH_ON_REVERSAL},
+        {"alwaysApproach=None", BACKLASH_ON_REVERSAL},
+        {"alwaysApproach=false", BACKLASH_ON_REVERSAL},
+        {"alwaysApproach=sideways", REQUEST_STRATEGY_ABSENT},
+        {"alwaysApproach=cwx", REQUEST_STRATEGY_ABSENT},
+        {"speed=1", REQUEST_STRATEGY_ABSENT},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        char line[80];
+        snprintf(line, sizeof(line), "GET /focuser?%s&amp;speed=2 HTTP/1.1", cases[i].query);
+        FocuserRequest request;
+        CHECK(parse(line, request));
+        CHECK_EQUAL(cases[i].strategy, request.alwaysApproach);
+        CHECK_EQUAL(2, request.speed);
+    }
+}
+
+static void testRequestLine()
+{
+    FocuserRequest request;
+    CHECK(!parse("POST /focuser?speed=5 HTTP/1.1", request));
+    CHECK_EQUAL(ROUTE_NOT_FOUND, request.route);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.speed);
+    CHECK(!parse("get /focuser HTTP/1.1", request));
+    CHECK(!parse("", request));
+    CHECK(!parse("GET", request));
+
+    // A packet cut short is parsed as far as it goes
+    const char *line = "GET /focuser?speed=123&amp;maxSpeed=45 HTTP/1.1";
+    CHECK(parseRequest(line, 7, request));
+    CHECK_EQUAL(ROUTE_NOT_FOUND, request.route);
+    CHECK(parseRequest(line, 21, request));
+    CHECK_EQUAL(ROUTE_STATUS, request.route);
+    CHECK_EQUAL(12, request.speed);
+    CHECK(parseRequest(line, 30, request));
+    CHECK_EQUAL(123, request.speed);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.maxSpeed);
+    CHECK(!parseRequest(line, 3, request));
+
+    // and no further than a NUL or the end of the line
+    const char nul[] = "GET /focuser?speed=1\0&amp;maxSpeed=2 HTTP/1.1";
+    CHECK(parseRequest(nul, sizeof(nul) - 1, request));
+    CHECK_EQUAL(1, request.speed);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.maxSpeed);
+    CHECK(parse("GET /focuser?speed=1\r\nmaxSpeed=2", request));
+    CHECK_EQUAL(1, request.speed);
+    CHECK_EQUAL(REQUEST_ARG_ABSENT, request.maxSpeed);
+}
+
+int main()
+{
+    testRoutes();
+    testSeparators();
+    testAbsentArguments();
+    testNumbers();
+    testSequence();
+    testAlwaysApproach();
+    testRequestLine();
+    return checkResult("request_test");
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+  Host test of decodeCompactStatus, the decoder of the frame the device
+  serves while a move is followed.
+
+  Checks the six fields are stored, that a full JSON status is decoded in
+  its place, and that malformed frames and numbers beyond int32_t are
+  refused with endptr at the offending field rather than stored wrapped.
+*******************************************************************************/
+#include "check.h"
+#include "focuserstatus.h"
+#include "gason.h"
+
+#include <string.h>
+
+static int decode(const char *frame, FocuserStatus &status, const char **endptr = NULL)
+{
+    const char *stop;
+    int result = decodeCompactStatus(frame, strlen(frame), &status, &stop);
+    if (endptr)
+        *endptr = stop;
+    return result;
+}
+
+static void testFields()
+{
+    FocuserStatus status;
+    CHECK_EQUAL(JSON_OK, decode("1200 1500 1 60 7 -1\n", status));
+    CHECK_EQUAL(1200, status.absolutePosition);
+    CHECK_EQUAL(1500, status.targetPosition);
+    CHECK(status.moving);
+    CHECK_EQUAL(60, status.speed);
+    CHECK_EQUAL(7, status.moveCount);
+    CHECK_EQUAL(-1, status.sequenceStep);
+    CHECK(status.has(FOCUSER_STATUS_sequenceStep));
+    CHECK(!status.has(FOCUSER_STATUS_temperature));
+
+    // The limits of int32_t are stored as they are
+    CHECK_EQUAL(JSON_OK, decode("2147483647 -2147483648 0 0 0 0", status));
+    CHECK_EQUAL(INT32_MAX, status.absolutePosition);
+    CHECK_EQUAL(INT32_MIN, status.targetPosition);
+    CHECK(!status.moving);
+
+    // Firmware without the compact endpoint answers with the full status
+    CHECK_EQUAL(JSON_OK, decode(" {\"absolutePosition\": 42, \"moving\": false}", status));
+    CHECK_EQUAL(42, status.absolutePosition);
+    CHECK(!status.has(FOCUSER_STATUS_targetPosition));
+}
+
+static void testOutOfRange()
+{
+    FocuserStatus status;
+    const char *endptr;
+    const char *frame = "9999999999 1500 1 60 7 0";
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode(frame, status, &endptr));
+    CHECK(endptr == frame);
+
+    frame = "1200 2147483648 1 60 7 0";
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode(frame, status, &endptr));
+    CHECK(endptr == frame + 5);
+    CHECK(!status.has(FOCUSER_STATUS_targetPosition));
+
+    frame = "1200 1500 1 60 7 -2147483649";
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode(frame, status, &endptr));
+    CHECK(endptr == frame + 18);
+
+    // More than ten digits are refused before they are added up
+    frame = "1200 1500 1 60 00000000001 0";
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode(frame, status, &endptr));
+    CHECK(endptr == frame + 15);
+}
+
+static void testMalformed()
+{
+    FocuserStatus status;
+    const char *endptr;
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode("", status));
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode("1200 1500 1 60 7", status));
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode("1200  1500 1 60 7 0", status));
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode("1200 1500 1 60 7 0 9", status));
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode("1200 - 1 60 7 0", status));
+    const char *frame = "1200 1500 x 60 7 0";
+    CHECK_EQUAL(JSON_BAD_NUMBER, decode(frame, status, &endptr));
+    CHECK(endptr == frame + 10);
+}
+
+int main()
+{
+    testFields();
+    testOutOfRange();
+    testMalformed();
+    return checkResult("status_test");
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+  Host test of planSweep, the order autofocus sweep samples are visited in.
+
+  Checks samples are visited in the backlash strategy's approach direction,
+  increasing position for CCW and on reversal, decreasing for CW, with
+  duplicates dropped, and that the planned order is never slower than the
+  given one, and faster when the given one moves against the approach.
+*******************************************************************************/
+#include "check.h"
+#include "focusersweep.h"
+
+#include <vector>
+
+static MotionModel model(int8_t strategy)
+{
+    FocuserKinematics kinematics = {60, 120, 0, 10, 50, strategy};
+    MotionModel motionModel;
+    motionModel.setKinematics(kinematics);
+    return motionModel;
+}
+
+static void checkOrder(const SweepPlan &plan, const std::vector<uint32_t> &expected)
+{
+    CHECK_EQUAL(expected.size(), plan.samples.size());
+    for (size_t i = 0; i < expected.size() && i < plan.samples.size(); i++)
+        CHECK_EQUAL(expected[i], plan.samples[i]);
+}
+
+static void testOrder()
+{
+    const std::vector<uint32_t> samples = {9200, 9000, 9400, 9100, 9300, 9200};
+    checkOrder(planSweep(samples, 5000, model(BACKLASH_APPROACH_CCW), BACKLASH_APPROACH_CCW),
+               {9000, 9100, 9200, 9300, 9400});
+    checkOrder(planSweep(samples, 5000, model(BACKLASH_ON_REVERSAL), BACKLASH_ON_REVERSAL),
+               {9000, 9100, 9200, 9300, 9400});
+    checkOrder(planSweep(samples, 5000, model(BACKLASH_APPROACH_CW), BACKLASH_APPROACH_CW),
+               {9400, 9300, 9200, 9100, 9000});
+}
+
+static void testCost()
+{
+    // Listed in increasing order, which under CW overshoots on every sample
+    const std::vector<uint32_t> increasing = {9000, 9100, 9200, 9300, 9400};
+    SweepPlan cw = planSweep(increasing, 10000, model(BACKLASH_APPROACH_CW), BACKLASH_APPROACH_CW);
+    CHECK(cw.plannedSeconds < cw.givenOrderSeconds);
+    SweepPlan ccw = planSweep(increasing, 10000, model(BACKLASH_APPROACH_CCW), BACKLASH_APPROACH_CCW);
+    CHECK(ccw.plannedSeconds <= ccw.givenOrderSeconds + 1e-9);
+
+    const std::vector<uint32_t> decreasing(increasing.rbegin(), increasing.rend());
+    ccw = planSweep(decreasing, 5000, model(BACKLASH_APPROACH_CCW), BACKLASH_APPROACH_CCW);
+    CHECK(ccw.plannedSeconds < ccw.givenOrderSeconds);
+    cw = planSweep(decreasing, 5000, model(BACKLASH_APPROACH_CW), BACKLASH_APPROACH_CW);
+    CHECK(cw.plannedSeconds <= cw.givenOrderSeconds + 1e-9);
+}
+
+int main()
+{
+    testOrder();
+    testCost();
+    return checkResult("sweep_test");
+}
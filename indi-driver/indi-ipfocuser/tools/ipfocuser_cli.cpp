@@ -0,0 +1,428 @@
+/*******************************************************************************
+  Command line client for a focuser device, on libipfocuser, without INDI.
+
+  Runs a batch of commands against one focuser and prints how long each
+  took, then a summary for each kind of command. Commands follow the
+  endpoint on the command line, or come from a script with --file, any
+  number to a line with comments after '#'. Moves wait until the focuser has
+  stopped, following it with compact status polls, so a batch runs the way
+  a scheduler would drive the focuser.
+
+  Commands:
+    status              print the full status
+    poll                print the compact status
+    move POS            move to POS and wait until the focuser stops
+    start POS           start a move to POS without waiting
+    wait                wait until the focuser stops
+    sequence P1,P2,...  load a move sequence, waiting until P1 is reached
+    sync POS            tell the focuser it is at POS, without moving
+    sleep MS            pause
+
+  Usage: ipfocuser-cli [--socket] [--timeout ms] [--poll-interval ms]
+                       [--move-timeout s] [--backlash steps]
+                       [--approach CW|CCW|none] [--repeat n] [--file script]
+                       [--trace file] [--quiet] endpoint [command ...]
+
+  endpoint is http://host[:port]/focuser, a bare host or a URL without a
+  path meaning its /focuser. HTTP goes through libcurl, or with --socket the
+  library's own HTTP/1.1 client. --trace appends the exchanges to a trace
+  for ipfocuser_replay. The exit status is 1 if any command failed.
+*******************************************************************************/
+#include "curltransport.h"
+#include "focuserclient.h"
+#include "focuserstats.h"
+#include "focusertrace.h"
+#include "recordingtransport.h"
+#include "sockettransport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_TIMEOUT_MS 10000
+#define DEFAULT_POLL_INTERVAL_MS 100
+#define DEFAULT_MOVE_TIMEOUT_S 300
+
+// XX(name, arguments), arguments being what follows the command word.
+#define CLI_COMMANDS(XX)     \
+    XX(status, NONE)         \
+    XX(poll, NONE)           \
+    XX(move, POSITION)       \
+    XX(start, POSITION)      \
+    XX(wait, NONE)           \
+    XX(sequence, POSITIONS)  \
+    XX(sync, POSITION)       \
+    XX(sleep, MILLISECONDS)
+
+enum CommandKind {
+#define XX(name, arguments) COMMAND_##name,
+    CLI_COMMANDS(XX)
+#undef XX
+    COMMAND_KINDS
+};
+
+enum CommandArguments {
+    NONE,
+    POSITION,
+    POSITIONS,
+    MILLISECONDS
+};
+
+static const char *commandNames[COMMAND_KINDS] = {
+#define XX(name, arguments) #name,
+    CLI_COMMANDS(XX)
+#undef XX
+};
+
+static const CommandArguments commandArguments[COMMAND_KINDS] = {
+#define XX(name, arguments) arguments,
+    CLI_COMMANDS(XX)
+#undef XX
+};
+
+struct Command
+{
+    CommandKind kind;
+    std::vector<uint32_t> positions;
+    long milliseconds;
+    std::string text;
+};
+
+struct Options
+{
+    long timeoutMs = DEFAULT_TIMEOUT_MS;
+    long pollIntervalMs = DEFAULT_POLL_INTERVAL_MS;
+    double moveTimeoutSeconds = DEFAULT_MOVE_TIMEOUT_S;
+    const char *backlashSteps = NULL;
+    const char *approach = NULL;
+    bool quiet = false;
+};
+
+struct Summary
+{
+    LatencyHistogram latency;
+    unsigned long commands = 0, failures = 0;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ipfocuser-cli [--socket] [--timeout ms] [--poll-interval ms] [--move-timeout s]\n"
+                    "                     [--backlash steps] [--approach CW|CCW|none] [--repeat n] [--file script]\n"
+                    "                     [--trace file] [--quiet] endpoint [command ...]\n"
+                    "Commands: status, poll, move POS, start POS, wait, sequence P1,P2,..., sync POS, sleep MS\n");
+}
+
+// http://host[:port]/focuser from a bare host or a URL without a path.
+static std::string endpointOf(const char *text)
+{
+    std::string endpoint = strstr(text, "://") ? text : std::string("http://") + text;
+    if (endpoint.find('/', endpoint.find("://") + 3) == std::string::npos)
+        endpoint += "/focuser";
+    return endpoint;
+}
+
+static bool parsePositions(const std::string &text, std::vector<uint32_t> &positions)
+{
+    const char *s = text.c_str();
+    while (*s)
+    {
+        char *end;
+        unsigned long position = strtoul(s, &end, 10);
+        if (end == s || position > UINT32_MAX || (*end && *end != ','))
+            return false;
+        positions.push_back(position);
+        s = *end ? end + 1 : end;
+    }
+    return !positions.empty();
+}
+
+/**
+ * Turn words into commands, reporting the first that does not parse.
+**/
+static bool parseCommands(const std::vector<std::string> &words, std::vector<Command> &commands)
+{
+    for (size_t i = 0; i < words.size(); i++)
+    {
+        Command command;
+        int kind = 0;
+        while (kind < COMMAND_KINDS && words[i] != commandNames[kind])
+            kind++;
+        if (kind == COMMAND_KINDS)
+        {
+            fprintf(stderr, "Unknown command %s\n", words[i].c_str());
+            return false;
+        }
+        command.kind = (CommandKind)kind;
+        command.milliseconds = 0;
+        command.text = words[i];
+        CommandArguments arguments = commandArguments[kind];
+        if (arguments != NONE)
+        {
+            if (++i == words.size())
+            {
+                fprintf(stderr, "%s needs an argument\n", commandNames[kind]);
+                return false;
+            }
+            command.text += " " + words[i];
+            bool ok = arguments == MILLISECONDS ? (command.milliseconds = atol(words[i].c_str())) >= 0 :
+                      parsePositions(words[i], command.positions) && (arguments == POSITIONS || command.positions.size() == 1);
+            if (!ok)
+            {
+                fprintf(stderr, "Bad argument for %s: %s\n", commandNames[kind], words[i].c_str());
+                return false;
+            }
+        }
+        commands.push_back(command);
+    }
+    return true;
+}
+
+static bool readScript(const char *path, std::vector<std::string> &words)
+{
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if (strcmp(path, "-"))
+    {
+        file.open(path);
+        if (!file)
+            return false;
+        in = &file;
+    }
+    std::string line;
+    while (std::getline(*in, line))
+    {
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string word;
+        while (tokens >> word)
+            words.push_back(word);
+    }
+    return true;
+}
+
+static void describe(const FocuserStatus &status, char *text, size_t size)
+{
+    int length = snprintf(text, size, "position %d target %d %s", status.absolutePosition, status.targetPosition,
+                          status.has(FOCUSER_STATUS_moving) && status.moving ? "moving" : "stopped");
+    if (status.has(FOCUSER_STATUS_sequenceStep) && status.sequenceStep > 0 && length > 0 && (size_t)length < size)
+        length += snprintf(text + length, size - length, " step %d", status.sequenceStep);
+    if (status.has(FOCUSER_STATUS_temperature) && length > 0 && (size_t)length < size)
+        snprintf(text + length, size - length, " temperature %.1f", status.temperature);
+}
+
+/**
+ * Follow a move with compact polls until the focuser stops, starting from status, the latest seen.
+**/
+static bool waitStopped(FocuserClient &client, const Options &options, FocuserStatus &status, int &polls)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds((long long)(options.moveTimeoutSeconds * 1000));
+    polls = 0;
+    while (!status.has(FOCUSER_STATUS_moving) || status.moving)
+    {
+        if (Clock::now() >= deadline)
+            return false;
+        if (polls > 0 || status.has(FOCUSER_STATUS_moving))
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.pollIntervalMs));
+        polls++;
+        if (!client.poll(status, options.timeoutMs))
+            return false;
+    }
+    return true;
+}
+
+static bool run(FocuserClient &client, const Options &options, const Command &command, char *detail, size_t size)
+{
+    FocuserStatus status;
+    status.present = 0;
+    int polls = 0;
+    bool ok = false;
+    switch (command.kind)
+    {
+    case COMMAND_status:
+        ok = client.status(status, options.timeoutMs);
+        break;
+    case COMMAND_poll:
+        ok = client.poll(status, options.timeoutMs);
+        break;
+    case COMMAND_move:
+    case COMMAND_start:
+        ok = client.move(command.positions[0], options.backlashSteps, options.approach, status, options.timeoutMs);
+        break;
+    case COMMAND_sequence:
+        ok = client.loadSequence(command.positions.data(), command.positions.size(), options.backlashSteps, status,
+                                 options.timeoutMs);
+        break;
+    case COMMAND_wait:
+        ok = true;
+        break;
+    case COMMAND_sync:
+        ok = client.sync(command.positions[0], options.timeoutMs);
+        break;
+    case COMMAND_sleep:
+        std::this_thread::sleep_for(std::chrono::milliseconds(command.milliseconds));
+        snprintf(detail, size, "-");
+        return true;
+    default:
+        break;
+    }
+    if (ok && (command.kind == COMMAND_move || command.kind == COMMAND_sequence || command.kind == COMMAND_wait) &&
+        !waitStopped(client, options, status, polls))
+    {
+        if (client.transportResult() == TRANSPORT_OK && status.has(FOCUSER_STATUS_moving) && status.moving)
+            snprintf(detail, size, "still moving after %.0f s", options.moveTimeoutSeconds);
+        else
+            snprintf(detail, size, "%s", client.error());
+        return false;
+    }
+    if (!ok)
+    {
+        snprintf(detail, size, "%s", client.error());
+        return false;
+    }
+    if (command.kind == COMMAND_sync)
+    {
+        snprintf(detail, size, "-");
+        return true;
+    }
+    describe(status, detail, size);
+    if (polls)
+        snprintf(detail + strlen(detail), size - strlen(detail), ", %d polls", polls);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    bool useSocket = false;
+    int repeat = 1;
+    const char *script = NULL;
+    const char *tracePath = NULL;
+    const char *endpointText = NULL;
+    std::vector<std::string> words;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--socket"))
+            useSocket = true;
+        else if (!strcmp(argv[i], "--quiet"))
+            options.quiet = true;
+        else if (!strcmp(argv[i], "--timeout") && hasValue)
+            options.timeoutMs = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--poll-interval") && hasValue)
+            options.pollIntervalMs = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--move-timeout") && hasValue)
+            options.moveTimeoutSeconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--backlash") && hasValue)
+            options.backlashSteps = argv[++i];
+        else if (!strcmp(argv[i], "--approach") && hasValue)
+            options.approach = argv[++i];
+        else if (!strcmp(argv[i], "--repeat") && hasValue)
+            repeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--file") && hasValue)
+            script = argv[++i];
+        else if (!strcmp(argv[i], "--trace") && hasValue)
+            tracePath = argv[++i];
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+        {
+            usage();
+            return 2;
+        }
+        else if (!endpointText)
+            endpointText = argv[i];
+        else
+            words.push_back(argv[i]);
+    }
+    if (!endpointText || options.timeoutMs <= 0 || options.pollIntervalMs < 0 || repeat < 1)
+    {
+        usage();
+        return 2;
+    }
+    if (script && !readScript(script, words))
+    {
+        fprintf(stderr, "Cannot read %s\n", script);
+        return 2;
+    }
+    std::vector<Command> commands;
+    if (!parseCommands(words, commands))
+        return 2;
+    if (commands.empty())
+    {
+        Command status;
+        status.kind = COMMAND_status;
+        status.milliseconds = 0;
+        status.text = "status";
+        commands.push_back(status);
+    }
+
+    CurlTransport curlTransport;
+    SocketTransport socketTransport;
+    FocuserTransport *transport = useSocket ? (FocuserTransport *)&socketTransport : &curlTransport;
+    FocuserStats stats;
+    TraceWriter trace;
+    RecordingTransport recording(*transport, stats, trace);
+    if (tracePath)
+    {
+        if (!trace.open(tracePath))
+        {
+            fprintf(stderr, "Cannot write the trace to %s\n", tracePath);
+            return 2;
+        }
+        transport = &recording;
+    }
+    FocuserClient client(*transport);
+    std::string endpoint = endpointOf(endpointText);
+    if (!client.setEndpoint(endpoint.c_str()))
+    {
+        fprintf(stderr, "%s\n", client.error());
+        return 2;
+    }
+
+    Summary summaries[COMMAND_KINDS];
+    Clock::time_point batchStart = Clock::now();
+    for (int round = 0; round < repeat; round++)
+    {
+        for (const Command &command : commands)
+        {
+            char detail[256];
+            Clock::time_point start = Clock::now();
+            bool ok = run(client, options, command, detail, sizeof(detail));
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            Summary &summary = summaries[command.kind];
+            summary.commands++;
+            if (ok)
+                summary.latency.record(seconds);
+            else
+                summary.failures++;
+            if (!options.quiet || !ok)
+                printf("%-28s %10.1f ms  %s%s\n", command.text.c_str(), seconds * 1e3, ok ? "" : "FAILED: ", detail);
+        }
+    }
+    double total = std::chrono::duration<double>(Clock::now() - batchStart).count();
+
+    bool failed = false;
+    printf("\n%-9s %8s %7s %10s %10s %10s %10s\n", "command", "count", "failed", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for (int i = 0; i < COMMAND_KINDS; i++)
+    {
+        const Summary &s = summaries[i];
+        if (!s.commands)
+            continue;
+        failed = failed || s.failures;
+        printf("%-9s %8lu %7lu %10.1f %10.1f %10.1f %10.1f\n", commandNames[i], s.commands, s.failures,
+               s.latency.percentile(0.5) * 1e3, s.latency.percentile(0.9) * 1e3, s.latency.percentile(0.99) * 1e3,
+               s.latency.max() * 1e3);
+    }
+    printf("%.2f s in all", total);
+    if (useSocket)
+        printf(", %u connections", socketTransport.connects());
+    printf("\n");
+    return failed ? 1 : 0;
+}
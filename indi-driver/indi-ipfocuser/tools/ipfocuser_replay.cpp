@@ -0,0 +1,241 @@
+/*******************************************************************************
+  Replays a trace recorded by the driver (see focusertrace.h) against a
+  device, normally the mock focuser farm, or prints it.
+
+  Every exchange is sent again the way the driver sends it: HTTP with one
+  long lived CurlTransport and the recorded timeout, UDP commands through
+  UdpTransport. By default each is sent as long after its session started as
+  it was in the recording, so polls and moves overlap as they did that night.
+  With --fast they are sent back to back. Requests to the power switch are
+  sent to --power, ending in /off or /on like the recorded ones, or skipped.
+
+  At the end the recorded and replayed latencies, failures and responses are
+  compared for each kind of exchange. Point it at a farm started with faults
+  injected to see how a night would have gone on a worse device, or at a
+  build of the firmware to see what a change does to a real workload.
+
+  Usage: ipfocuser_replay [--fast] [--device http://host:port] [--udp-port n]
+                          [--power http://host:port/power/0] trace
+         ipfocuser_replay --dump trace
+*******************************************************************************/
+#include "curltransport.h"
+#include "focuserstats.h"
+#include "focusertrace.h"
+#include "udptransport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#define DEFAULT_TIMEOUT_MS 10000
+#define UDP_ATTEMPTS 4
+
+enum ExchangeKind {
+    EXCHANGE_DEVICE,
+    EXCHANGE_POWER,
+    EXCHANGE_UDP,
+    EXCHANGE_KINDS
+};
+
+static const char *kindNames[EXCHANGE_KINDS] = { "http", "power", "udp" };
+
+struct Comparison
+{
+    LatencyHistogram recorded;
+    LatencyHistogram replayed;
+    unsigned long exchanges, skipped, recordedFailures, replayedFailures, differing;
+
+    Comparison() : exchanges(0), skipped(0), recordedFailures(0), replayedFailures(0), differing(0)
+    {
+    }
+};
+
+static void AppendBody(const char *data, size_t length, void *context)
+{
+    ((std::string *)context)->append(data, length);
+}
+
+static const char *resultName(uint8_t result)
+{
+    return result == TRACE_OK ? "ok" : result == TRACE_TIMEOUT ? "timeout" : "failed";
+}
+
+// Requests to the focuser have /focuser in their path, anything else went to the power switch.
+static ExchangeKind httpKind(const std::string &url)
+{
+    return url.find("/focuser") != std::string::npos ? EXCHANGE_DEVICE : EXCHANGE_POWER;
+}
+
+static void printUdp(const TraceRecord &record)
+{
+    UdpCommand command;
+    UdpStatus reply;
+    if (decodeUdpCommand((const uint8_t *)record.request.data(), record.request.size(), command))
+        printf("%s target %u backlash %u strategy %d", command.type == UDP_MOVE ? "move" : "status", command.target,
+               command.backlashSteps, command.backlashStrategy);
+    if (decodeUdpStatus((const uint8_t *)record.response.data(), record.response.size(), reply))
+        printf(" -> position %u target %u%s", reply.position, reply.target,
+               reply.flags & UDP_FLAG_MOVING ? " moving" : "");
+    printf("\n");
+}
+
+static int dump(TraceReader &reader)
+{
+    TraceRecord record;
+    while (reader.next(record))
+    {
+        if (record.kind == TRACE_SESSION)
+        {
+            time_t started = record.time / 1000000;
+            char date[64];
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&started));
+            printf("session started %s\n", date);
+            continue;
+        }
+        printf("%10.3f s %-5s %-7s %9.1f ms  ", record.time / 1e6, record.kind == TRACE_UDP ? "udp" : "http",
+               resultName(record.result), record.latencyUs / 1e3);
+        if (record.kind == TRACE_UDP)
+            printUdp(record);
+        else
+            printf("%s (%zu bytes)\n", record.request.c_str(), record.response.size());
+    }
+    return 0;
+}
+
+static std::string hostOf(const std::string &url)
+{
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    size_t end = url.find_first_of(":/", start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+int main(int argc, char *argv[])
+{
+    bool fast = false, dumpOnly = false;
+    std::string device, power;
+    int udpPort = 0;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--fast"))
+            fast = true;
+        else if (!strcmp(argv[i], "--dump"))
+            dumpOnly = true;
+        else if (!strcmp(argv[i], "--device") && i + 1 < argc)
+            device = argv[++i];
+        else if (!strcmp(argv[i], "--udp-port") && i + 1 < argc)
+            udpPort = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--power") && i + 1 < argc)
+            power = argv[++i];
+        else
+            path = argv[i];
+    }
+    if (!path || (!dumpOnly && device.empty()))
+    {
+        fprintf(stderr, "Usage: ipfocuser_replay [--fast] [--device http://host:port] [--udp-port n]\n"
+                        "                        [--power http://host:port/power/0] trace\n"
+                        "       ipfocuser_replay --dump trace\n");
+        return 2;
+    }
+
+    TraceReader reader;
+    if (!reader.open(path))
+    {
+        fprintf(stderr, "%s is not a focuser trace\n", path);
+        return 1;
+    }
+    if (dumpOnly)
+        return dump(reader);
+
+    CurlTransport http;
+    UdpTransport udp;
+    if (udpPort && !udp.open(hostOf(device).c_str(), udpPort))
+    {
+        fprintf(stderr, "cannot open UDP to %s port %d\n", hostOf(device).c_str(), udpPort);
+        return 1;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point sessionStart = Clock::now();
+    Comparison comparisons[EXCHANGE_KINDS];
+    TraceRecord record;
+    std::string body;
+    while (reader.next(record))
+    {
+        if (record.kind == TRACE_SESSION)
+        {
+            sessionStart = Clock::now();
+            continue;
+        }
+        ExchangeKind kind = record.kind == TRACE_UDP ? EXCHANGE_UDP : httpKind(record.request);
+        Comparison &comparison = comparisons[kind];
+        std::string url;
+        if (kind == EXCHANGE_DEVICE)
+            url = device + record.request.substr(record.request.find("/focuser"));
+        else if (kind == EXCHANGE_POWER && !power.empty())
+            url = power + record.request.substr(record.request.rfind('/'));
+        if ((kind == EXCHANGE_UDP && !udp.isOpen()) || (kind != EXCHANGE_UDP && url.empty()))
+        {
+            comparison.skipped++;
+            continue;
+        }
+        if (!fast)
+            std::this_thread::sleep_until(sessionStart + std::chrono::microseconds(record.time));
+
+        comparison.exchanges++;
+        if (record.result == TRACE_OK)
+            comparison.recorded.record(record.latencyUs / 1e6);
+        else
+            comparison.recordedFailures++;
+        Clock::time_point start = Clock::now();
+        bool ok;
+        bool same;
+        if (kind == EXCHANGE_UDP)
+        {
+            UdpCommand command;
+            UdpStatus reply;
+            uint8_t replyFrame[UDP_STATUS_SIZE];
+            ok = decodeUdpCommand((const uint8_t *)record.request.data(), record.request.size(), command) &&
+                 udp.request(command.type, command.target, command.backlashSteps, command.backlashStrategy, reply,
+                             UDP_ATTEMPTS);
+            // The recording numbered its replies 0
+            reply.seq = 0;
+            same = ok && std::string((const char *)replyFrame, encodeUdpStatus(reply, replyFrame)) == record.response;
+        }
+        else
+        {
+            body.clear();
+            ok = http.get(url.c_str(), (long)(record.timeoutMs ? record.timeoutMs : DEFAULT_TIMEOUT_MS), AppendBody,
+                          &body) == TRANSPORT_OK;
+            same = body == record.response;
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (ok)
+            comparison.replayed.record(seconds);
+        else
+            comparison.replayedFailures++;
+        if (ok && record.result == TRACE_OK && !same)
+            comparison.differing++;
+        if (ok != (record.result == TRACE_OK))
+            printf("%10.3f s %-5s recorded %s, replayed %s\n", record.time / 1e6, kindNames[kind],
+                   resultName(record.result), ok ? "ok" : "failed");
+    }
+
+    printf("%-6s %9s %8s %19s %19s %21s %21s %10s\n", "kind", "exchanges", "skipped", "failed recorded",
+           "failed replayed", "p50/p99 recorded ms", "p50/p99 replayed ms", "differing");
+    for (int i = 0; i < EXCHANGE_KINDS; i++)
+    {
+        Comparison &c = comparisons[i];
+        printf("%-6s %9lu %8lu %19lu %19lu %10.1f/%-10.1f %10.1f/%-10.1f %10lu\n", kindNames[i], c.exchanges, c.skipped,
+               c.recordedFailures, c.replayedFailures, c.recorded.percentile(0.5) * 1e3, c.recorded.percentile(0.99) * 1e3,
+               c.replayed.percentile(0.5) * 1e3, c.replayed.percentile(0.99) * 1e3, c.differing);
+    }
+
+    return 0;
+}
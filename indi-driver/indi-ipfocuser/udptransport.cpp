@@ -0,0 +1,133 @@
+/*******************************************************************************
+  UDP channel to the focuser device. See udptransport.h.
+*******************************************************************************/
+#include "udptransport.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Wait before the first resend, doubled for each one after. Four attempts give up after 750 ms.
+#define FIRST_RESEND_MS 50
+
+UdpTransport::UdpTransport() : fd(-1), nextSeq(1), resendCount(0), haveTelemetry(false)
+{
+}
+
+UdpTransport::~UdpTransport()
+{
+    close();
+}
+
+bool UdpTransport::open(const char *host, uint16_t port)
+{
+    close();
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *address;
+    if (getaddrinfo(host, service, &hints, &address))
+        return false;
+    memcpy(&device, address->ai_addr, sizeof(device));
+    freeaddrinfo(address);
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    haveTelemetry = false;
+    return fd >= 0;
+}
+
+void UdpTransport::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+bool UdpTransport::request(uint8_t type, uint16_t target, uint16_t backlashSteps, int8_t backlashStrategy, UdpStatus &reply,
+                           int attempts)
+{
+    if (fd < 0)
+        return false;
+    UdpCommand command = {type, nextSeq++, target, backlashSteps, backlashStrategy};
+    uint8_t frame[UDP_MOVE_STRATEGY_SIZE];
+    uint8_t length = encodeUdpCommand(command, frame);
+    long wait = FIRST_RESEND_MS;
+    for (int attempt = 0; attempt < attempts; attempt++, wait *= 2)
+    {
+        if (attempt > 0)
+            resendCount++;
+        sendto(fd, frame, length, 0, (const sockaddr *)&device, sizeof(device));
+        if (receive(command.seq, reply, wait))
+            return true;
+    }
+    return false;
+}
+
+bool UdpTransport::telemetry(UdpStatus &status, long maxAgeMs)
+{
+    UdpStatus unused;
+    receive(0, unused, 0);
+    if (!haveTelemetry || Clock::now() - telemetryAt > std::chrono::milliseconds(maxAgeMs))
+        return false;
+    status = lastTelemetry;
+    return true;
+}
+
+bool UdpTransport::receive(uint16_t seq, UdpStatus &reply, long timeoutMs)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;)
+    {
+        long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        pollfd ready = {fd, POLLIN, 0};
+        int count = poll(&ready, 1, left > 0 ? left : 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        uint8_t frame[64];
+        sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t n = recvfrom(fd, frame, sizeof(frame), MSG_DONTWAIT, (sockaddr *)&from, &fromLength);
+        UdpStatus status;
+        if (n < 0 || from.sin_addr.s_addr != device.sin_addr.s_addr || from.sin_port != device.sin_port ||
+            !decodeUdpStatus(frame, n, status))
+            continue;
+        if (status.type & UDP_REPLY)
+        {
+            // Replies to earlier commands, answered too late, are of no use any more
+            if (seq && status.seq == seq)
+            {
+                reply = status;
+                return true;
+            }
+        }
+        // Telemetry numbers wrap, a late datagram is one numbered behind the latest. They start again from 1 on reboot.
+        else if (!haveTelemetry || (int16_t)(status.seq - lastTelemetry.seq) > 0 || status.seq == 1)
+        {
+            lastTelemetry = status;
+            telemetryAt = Clock::now();
+            haveTelemetry = true;
+        }
+    }
+}
+
+void udpStatusToFocuserStatus(const UdpStatus &udp, FocuserStatus *status)
+{
+    status->absolutePosition = udp.position;
+    status->targetPosition = udp.target;
+    status->moving = udp.flags & UDP_FLAG_MOVING;
+    status->speed = udp.speed;
+    status->moveCount = udp.moveCount;
+    status->sequenceStep = udp.sequenceStep;
+    status->present = 1u << FOCUSER_STATUS_absolutePosition | 1u << FOCUSER_STATUS_targetPosition |
+                      1u << FOCUSER_STATUS_moving | 1u << FOCUSER_STATUS_speed | 1u << FOCUSER_STATUS_moveCount |
+                      1u << FOCUSER_STATUS_sequenceStep;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+  Client side of the focuser's UDP command and telemetry channel, see
+  udpframe.h in the firmware for the datagrams.
+
+  Each command gets the next sequence number and is resent, waiting twice as
+  long each time, until the reply with that number arrives or the attempts run
+  out. The device answers a resent command without acting on it again, and
+  moves are absolute, so a command that got through but lost its reply is
+  safe to send again over HTTP. Telemetry read meanwhile is kept, so a caller
+  following a move can use the latest instead of asking.
+*******************************************************************************/
+
+#ifndef UDPTRANSPORT_H
+#define UDPTRANSPORT_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include <chrono>
+
+#include "focuserstatus.h"
+#include "udpframe.h"
+
+class UdpTransport
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    UdpTransport();
+    ~UdpTransport();
+
+    // Open a socket for the device at host:port. It is not connected, telemetry is broadcast, so datagrams from
+    // anywhere else are skipped as they are read. Returns false if host does not resolve.
+    bool open(const char *host, uint16_t port);
+    void close();
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    // Send a UDP_STATUS or UDP_MOVE command and wait for its reply. Returns false if none came after attempts sends.
+    // A backlashStrategy of UDP_KEEP_STRATEGY is left out of the move, as older firmware expects.
+    bool request(uint8_t type, uint16_t target, uint16_t backlashSteps, int8_t backlashStrategy, UdpStatus &reply,
+                 int attempts);
+    // The latest telemetry, if one no older than maxAgeMs has arrived. Reads what is waiting without blocking.
+    bool telemetry(UdpStatus &status, long maxAgeMs);
+    // Commands sent again for want of a reply, since the transport was created.
+    uint32_t resends() const {
+        return resendCount;
+    }
+
+private:
+    int fd;
+    sockaddr_in device;
+    uint16_t nextSeq;
+    uint32_t resendCount;
+    bool haveTelemetry;
+    UdpStatus lastTelemetry;
+    Clock::time_point telemetryAt;
+
+    // Read datagrams until the reply to seq arrives or timeoutMs passes, keeping any telemetry.
+    bool receive(uint16_t seq, UdpStatus &reply, long timeoutMs);
+};
+
+/**
+ * Store the fields a status datagram carries into status, the same ones decodeCompactStatus sets.
+**/
+void udpStatusToFocuserStatus(const UdpStatus &udp, FocuserStatus *status);
+
+#endif
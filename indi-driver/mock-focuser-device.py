@@ -11,6 +11,6 @@ def index():
     print(absPos)
     print(backlashSteps)
     print(alwaysApproach)
-    return template('{"uptime":"05:14:12", "absolutePosition":    {{absPos}}, "maxPosition":    100000, "minPosition":    10}', absPos = absPos)
+    return template('{"uptime":"05:14:12", "absolutePosition":    {{absPos}}, "maxPosition":    100000, "minPosition":    10, "moving": false, "targetPosition": {{absPos}}}', absPos = absPos)
 
 run(host='localhost', port=8080)
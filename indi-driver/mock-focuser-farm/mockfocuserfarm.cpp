@@ -0,0 +1,1030 @@
+/*******************************************************************************
+  Mock focuser farm: N simulated ipFocuser devices on consecutive ports, served
+  from one epoll loop, for load testing the driver and its recovery paths.
+
+  Each focuser speaks the firmware's HTTP API: HTTP/1.0, one request per
+  connection, parsed by the firmware's own request parser, with the same status
+  responses. The UDP channel of udpframe.h is served on the same port number,
+  with telemetry sent straight to the client rather than broadcast. Moves run
+  through the firmware's own FocuserMotion and StepRamp, driven by a simulated
+  step timer, so speed, gearbox, backlash segments and acceleration ramps take
+  as long as they would on the device (or --time-scale times less).
+
+  Faults, rolled per request or command datagram:
+    --latency MIN:MAX   delay every response by a uniform MIN..MAX ms
+    --drop-rate P       close the connection, or drop the datagram, without
+                        answering
+    --hang-rate P       the device hangs: it keeps accepting connections but
+                        never answers again until it is power cycled
+
+  The power switch listens on its own port (default: the port after the last
+  focuser) and answers GET /power/<n>/off and GET /power/<n>/on, n counting
+  from 0. While off the focuser refuses connections. After power on it boots
+  for --boot-ms, then comes back with the firmware defaults, like the real
+  device after a reset, at the position its journal restores. Each focuser's
+  EEPROM is kept in memory for as long as the farm runs.
+
+  With --temperature START:RATE every focuser reports a temperature starting
+  at START degrees C and changing by RATE degrees an hour (of scaled time),
+  formatted by the firmware's own code, for testing temperature compensation.
+  Without it the temperature is null, as on a device without a thermistor.
+
+  Usage: mock-focuser-farm [--focusers N] [--port FIRST] [--power-port P]
+                           [--time-scale X] [--latency MIN:MAX] [--drop-rate P]
+                           [--hang-rate P] [--boot-ms MS] [--temperature START:RATE]
+                           [--seed S] [--verbose]
+  Ctrl-C prints per focuser counters and exits.
+*******************************************************************************/
+#include "journal.h"
+#include "motion.h"
+#include "planner.h"
+#include "ramp.h"
+#include "request.h"
+#include "temperature.h"
+#include "udpframe.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Firmware constants, see ipFocuser.ino
+#define DEFAULT_ABS_POSN 10000
+#define MAX_APS_POSN 20000
+#define MIN_APS_POSN 0
+#define DEFAULT_MAX_SPEED 280
+#define DEFAULT_ACCELERATION 0
+#define DEFAULT_BACKLASHSTEPS 100
+#define STEPS_PER_REVOLUTION 195
+#define GEARBOX_MULTIPLIER 10
+#define DEFAULT_BACKLASH_STRATEGY BACKLASH_APPROACH_CCW
+// Timer1 with a /64 prescaler at 16MHz
+#define STEP_TIMER_HZ 250000
+
+// Longest the loop sleeps while a focuser is moving, bounds how late the next backlash segment starts.
+#define MOTION_POLL_MS 2
+#define MAX_REQUEST_SIZE 4096
+
+struct FarmOptions
+{
+    int focusers = 1;
+    int port = 8080;
+    int powerPort = 0;
+    double timeScale = 1;
+    int latencyMinMs = 0;
+    int latencyMaxMs = 0;
+    double dropRate = 0;
+    double hangRate = 0;
+    int bootMs = 3000;
+    bool hasTemperature = false;
+    double temperatureStart = 0;
+    double temperatureRate = 0;
+    unsigned seed = 1;
+    bool verbose = false;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * Step timer simulation: replays the ramp's step intervals against the scaled clock whenever motion asks how far it got.
+**/
+class SimulatedStepDriver : public StepDriver
+{
+public:
+    SimulatedStepDriver(Clock::time_point epoch, double timeScale) : epoch(epoch), timeScale(timeScale) {}
+
+    virtual void start(int8_t, int32_t steps, uint32_t speed, uint32_t acceleration)
+    {
+        running = steps > 0;
+        nextStepTick = now() + ramp.begin(steps, speed, acceleration, STEP_TIMER_HZ);
+    }
+
+    virtual int32_t stepsDone()
+    {
+        advance();
+        return ramp.stepsDone();
+    }
+
+    virtual bool isRunning()
+    {
+        advance();
+        return running;
+    }
+
+    void stop()
+    {
+        running = false;
+    }
+
+private:
+    Clock::time_point epoch;
+    double timeScale;
+    StepRamp ramp;
+    bool running = false;
+    uint64_t nextStepTick = 0;
+
+    uint64_t now() const
+    {
+        return (uint64_t)(millisecondsSince(epoch) * timeScale * (STEP_TIMER_HZ / 1000.0));
+    }
+
+    void advance()
+    {
+        uint64_t tick = now();
+        while (running && nextStepTick <= tick)
+        {
+            uint32_t interval = ramp.nextInterval();
+            if (interval == 0)
+                running = false;
+            else
+                nextStepTick += interval;
+        }
+    }
+};
+
+
+struct Connection;
+struct Focuser;
+
+// What an epoll event refers to
+struct Endpoint
+{
+    enum Kind
+    {
+        FOCUSER_LISTENER,
+        FOCUSER_UDP,
+        POWER_LISTENER,
+        CONNECTION
+    } kind;
+    Focuser *focuser;
+    Connection *connection;
+};
+
+// The focuser's EEPROM, erased like a new device's
+struct MemoryStorage : JournalStorage
+{
+    MemoryStorage()
+    {
+        memset(bytes, 0xFF, sizeof(bytes));
+    }
+
+    uint8_t read(uint16_t address) override
+    {
+        return bytes[address];
+    }
+
+    void write(uint16_t address, uint8_t value) override
+    {
+        bytes[address] = value;
+    }
+
+    uint8_t bytes[1024];
+};
+
+struct Focuser
+{
+    enum Power
+    {
+        POWER_ON,
+        POWER_OFF,
+        BOOTING
+    };
+
+    Focuser(int index, int port, Clock::time_point epoch, double timeScale)
+        : index(index), port(port), driver(epoch, timeScale), journal(eeprom)
+    {
+        endpoint = {Endpoint::FOCUSER_LISTENER, this, nullptr};
+        udpEndpoint = {Endpoint::FOCUSER_UDP, this, nullptr};
+        reset();
+    }
+
+    // Power on defaults, as setup() leaves them
+    void reset()
+    {
+        driver.stop();
+        motion.reset(new FocuserMotion(driver, STEPS_PER_REVOLUTION, GEARBOX_MULTIPLIER));
+        journal.begin(DEFAULT_ABS_POSN);
+        motion->setPosition(journal.position());
+        currentSpeed = DEFAULT_MAX_SPEED;
+        maxSpeed = DEFAULT_MAX_SPEED;
+        acceleration = DEFAULT_ACCELERATION;
+        backlashSteps = DEFAULT_BACKLASHSTEPS;
+        backlashStrategy = DEFAULT_BACKLASH_STRATEGY;
+        sequence.clear();
+        sequenceStep = 0;
+        moveCount = 0;
+        udpClient = {};
+        udpReply.clear();
+        telemetrySeq = 0;
+        telemetryMoving = false;
+        hung = false;
+        bootedAt = Clock::now();
+    }
+
+    int index;
+    int port;
+    int listener = -1;
+    Endpoint endpoint;
+    int udpSocket = -1;
+    Endpoint udpEndpoint;
+    SimulatedStepDriver driver;
+    MemoryStorage eeprom;
+    PositionJournal journal;
+    std::unique_ptr<FocuserMotion> motion;
+    int currentSpeed, maxSpeed, acceleration, backlashSteps;
+    int8_t backlashStrategy;
+    std::vector<int> sequence;
+    int sequenceStep;
+    int8_t sequenceDirection;
+    int moveCount;
+    // The firmware's UDP client state, see udpCommand() and sendTelemetry()
+    sockaddr_in udpClient;
+    Clock::time_point udpLastHeard;
+    std::string udpReply;
+    Clock::time_point lastTelemetry;
+    uint16_t telemetrySeq;
+    bool telemetryMoving;
+    Power power = POWER_ON;
+    bool hung = false;
+    Clock::time_point bootedAt;
+    Clock::time_point bootDoneAt;
+
+    unsigned long requests = 0, moves = 0, dropped = 0, hangs = 0, powerCycles = 0;
+};
+
+struct Connection
+{
+    int fd;
+    Focuser *focuser;   // null for the power switch
+    Endpoint endpoint;
+    std::string in;
+    std::string out;
+    size_t written = 0;
+    bool complete = false;
+    Clock::time_point respondAt;
+};
+
+// A UDP reply held back by the injected latency
+struct Datagram
+{
+    Focuser *focuser;
+    sockaddr_in to;
+    std::string bytes;
+    Clock::time_point sendAt;
+};
+
+class Farm
+{
+public:
+    explicit Farm(const FarmOptions &options) : options(options), random(options.seed) {}
+
+    bool start();
+    void run();
+    void printCounters() const;
+
+private:
+    FarmOptions options;
+    std::mt19937 random;
+    Clock::time_point epoch = Clock::now();
+    int epollFd = -1;
+    int powerListener = -1;
+    Endpoint powerEndpoint = {Endpoint::POWER_LISTENER, nullptr, nullptr};
+    std::vector<std::unique_ptr<Focuser>> focusers;
+    std::vector<Connection *> connections;
+    std::vector<Datagram> datagrams;
+
+    int openListener(int port);
+    int openUdp(int port);
+    bool openFocuser(Focuser *focuser);
+    void closeFocuser(Focuser *focuser);
+    void receiveDatagrams(Focuser *focuser);
+    void sendTelemetry(Focuser *focuser);
+    int latencyMs();
+    bool watch(int fd, uint32_t events, Endpoint *endpoint, int operation = EPOLL_CTL_ADD);
+    void acceptConnections(int listener, Focuser *focuser);
+    void receive(Connection *connection);
+    void handleRequest(Connection *connection);
+    void sendDue();
+    void flush(Connection *connection);
+    void closeConnection(Connection *connection);
+    void powerOff(Focuser *focuser);
+    void powerOn(Focuser *focuser);
+    void finishBoots();
+    int waitTimeout();
+    bool roll(double probability);
+
+    std::string focuserResponse(Focuser *focuser, const std::string &request);
+    std::string udpResponse(Focuser *focuser, const sockaddr_in &from, const uint8_t *data, size_t length);
+    std::string powerResponse(const std::string &request);
+};
+
+int Farm::openListener(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) || listen(fd, SOMAXCONN))
+    {
+        fprintf(stderr, "port %d: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int Farm::openUdp(int port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (sockaddr *)&address, sizeof(address)))
+    {
+        fprintf(stderr, "udp port %d: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Start serving a focuser's HTTP and UDP ports. Returns false, with neither open, if either port is taken.
+**/
+bool Farm::openFocuser(Focuser *focuser)
+{
+    if ((focuser->listener = openListener(focuser->port)) >= 0 && watch(focuser->listener, EPOLLIN, &focuser->endpoint) &&
+        (focuser->udpSocket = openUdp(focuser->port)) >= 0 && watch(focuser->udpSocket, EPOLLIN, &focuser->udpEndpoint))
+        return true;
+    closeFocuser(focuser);
+    return false;
+}
+
+void Farm::closeFocuser(Focuser *focuser)
+{
+    for (int *fd : {&focuser->listener, &focuser->udpSocket})
+    {
+        if (*fd < 0)
+            continue;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, *fd, nullptr);
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+bool Farm::watch(int fd, uint32_t events, Endpoint *endpoint, int operation)
+{
+    epoll_event event = {};
+    event.events = events;
+    event.data.ptr = endpoint;
+    return epoll_ctl(epollFd, operation, fd, &event) == 0;
+}
+
+bool Farm::start()
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+        return false;
+    for (int i = 0; i < options.focusers; i++)
+    {
+        Focuser *focuser = new Focuser(i, options.port + i, epoch, options.timeScale);
+        focusers.emplace_back(focuser);
+        if (!openFocuser(focuser))
+            return false;
+    }
+    int powerPort = options.powerPort ? options.powerPort : options.port + options.focusers;
+    if ((powerListener = openListener(powerPort)) < 0 || !watch(powerListener, EPOLLIN, &powerEndpoint))
+        return false;
+    printf("%d focusers on ports %d-%d, power switch on port %d\n", options.focusers, options.port,
+           options.port + options.focusers - 1, powerPort);
+    fflush(stdout);
+    return true;
+}
+
+void Farm::run()
+{
+    epoll_event events[256];
+    while (!stopRequested)
+    {
+        int count = epoll_wait(epollFd, events, 256, waitTimeout());
+        if (count < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            return;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            Endpoint *endpoint = (Endpoint *)events[i].data.ptr;
+            switch (endpoint->kind)
+            {
+            case Endpoint::FOCUSER_LISTENER:
+                if (endpoint->focuser->listener >= 0)
+                    acceptConnections(endpoint->focuser->listener, endpoint->focuser);
+                break;
+            case Endpoint::FOCUSER_UDP:
+                if (endpoint->focuser->udpSocket >= 0)
+                    receiveDatagrams(endpoint->focuser);
+                break;
+            case Endpoint::POWER_LISTENER:
+                acceptConnections(powerListener, nullptr);
+                break;
+            case Endpoint::CONNECTION:
+                // Skip connections already closed earlier in this batch, e.g. by a power off
+                if (endpoint->connection->fd < 0)
+                    break;
+                if (events[i].events & EPOLLOUT)
+                    flush(endpoint->connection);
+                else
+                    receive(endpoint->connection);
+                break;
+            }
+        }
+        finishBoots();
+        for (auto &focuser : focusers)
+        {
+            if (focuser->power != Focuser::POWER_ON)
+                continue;
+            focuser->motion->run();
+            // At rest somewhere new, as in the firmware's loop()
+            if (!focuser->motion->isMoving())
+                focuser->journal.commit(focuser->motion->position());
+            sendTelemetry(focuser.get());
+        }
+        sendDue();
+
+        // Closed connections are freed here, once no event of this batch can refer to them
+        for (size_t i = 0; i < connections.size();)
+        {
+            if (connections[i]->fd < 0)
+            {
+                delete connections[i];
+                connections[i] = connections.back();
+                connections.pop_back();
+            }
+            else
+                i++;
+        }
+    }
+}
+
+/**
+ * Sleep until the next delayed response is due or a boot completes, and only briefly while anything moves so that
+ * each segment of a move starts on time.
+**/
+int Farm::waitTimeout()
+{
+    Clock::time_point now = Clock::now();
+    double timeout = -1;
+    auto consider = [&timeout](double ms) {
+        if (ms < 0)
+            ms = 0;
+        if (timeout < 0 || ms < timeout)
+            timeout = ms;
+    };
+    for (Connection *connection : connections)
+        if (connection->fd >= 0 && connection->complete && !connection->out.empty() && connection->written == 0)
+            consider(std::chrono::duration<double, std::milli>(connection->respondAt - now).count());
+    for (const Datagram &datagram : datagrams)
+        consider(std::chrono::duration<double, std::milli>(datagram.sendAt - now).count());
+    for (auto &focuser : focusers)
+    {
+        if (focuser->power == Focuser::BOOTING)
+            consider(std::chrono::duration<double, std::milli>(focuser->bootDoneAt - now).count());
+        else if (focuser->power == Focuser::POWER_ON && focuser->motion->isMoving())
+            consider(MOTION_POLL_MS);
+        else if (focuser->power == Focuser::POWER_ON && focuser->udpClient.sin_port && !focuser->hung)
+            consider(UDP_TELEMETRY_IDLE_MS - std::chrono::duration<double, std::milli>(now - focuser->lastTelemetry).count());
+    }
+    return timeout < 0 ? -1 : (int)timeout + (timeout > (int)timeout);
+}
+
+void Farm::acceptConnections(int listener, Focuser *focuser)
+{
+    for (;;)
+    {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        Connection *connection = new Connection();
+        connection->fd = fd;
+        connection->focuser = focuser;
+        connection->endpoint = {Endpoint::CONNECTION, focuser, connection};
+        if (!watch(fd, EPOLLIN | EPOLLRDHUP, &connection->endpoint))
+        {
+            close(fd);
+            delete connection;
+            continue;
+        }
+        connections.push_back(connection);
+    }
+}
+
+void Farm::receive(Connection *connection)
+{
+    char buffer[2048];
+    for (;;)
+    {
+        ssize_t n = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            if (!connection->complete)
+                connection->in.append(buffer, n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            // Client gave up, e.g. a timeout on a hung device
+            closeConnection(connection);
+            return;
+        }
+        if (errno != EINTR)
+            break;
+    }
+    if (!connection->complete && (connection->in.find("\r\n\r\n") != std::string::npos || connection->in.size() > MAX_REQUEST_SIZE))
+    {
+        connection->complete = true;
+        handleRequest(connection);
+    }
+}
+
+bool Farm::roll(double probability)
+{
+    return probability > 0 && std::uniform_real_distribution<double>(0, 1)(random) < probability;
+}
+
+int Farm::latencyMs()
+{
+    return options.latencyMaxMs > options.latencyMinMs
+               ? std::uniform_int_distribution<int>(options.latencyMinMs, options.latencyMaxMs)(random)
+               : options.latencyMinMs;
+}
+
+void Farm::handleRequest(Connection *connection)
+{
+    Focuser *focuser = connection->focuser;
+    connection->respondAt = Clock::now() + std::chrono::milliseconds(latencyMs());
+
+    if (!focuser)
+    {
+        connection->out = powerResponse(connection->in);
+        return;
+    }
+
+    focuser->requests++;
+    if (!focuser->hung && roll(options.hangRate))
+    {
+        focuser->hung = true;
+        focuser->hangs++;
+        if (options.verbose)
+            printf("focuser %d hung\n", focuser->index);
+    }
+    if (focuser->hung)
+        return;   // Never answered, the client times out or the power is cut
+    if (roll(options.dropRate))
+    {
+        focuser->dropped++;
+        closeConnection(connection);
+        return;
+    }
+    focuser->motion->run();
+    connection->out = focuserResponse(focuser, connection->in);
+}
+
+/**
+ * Answer every command datagram waiting on a focuser's UDP port, with the same faults as HTTP requests.
+**/
+void Farm::receiveDatagrams(Focuser *focuser)
+{
+    uint8_t buffer[512];
+    for (;;)
+    {
+        sockaddr_in from = {};
+        socklen_t fromLength = sizeof(from);
+        ssize_t n = recvfrom(focuser->udpSocket, buffer, sizeof(buffer), 0, (sockaddr *)&from, &fromLength);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        focuser->requests++;
+        if (!focuser->hung && roll(options.hangRate))
+        {
+            focuser->hung = true;
+            focuser->hangs++;
+            if (options.verbose)
+                printf("focuser %d hung\n", focuser->index);
+        }
+        if (focuser->hung)
+            continue;
+        if (roll(options.dropRate))
+        {
+            focuser->dropped++;
+            continue;
+        }
+        focuser->motion->run();
+        std::string reply = udpResponse(focuser, from, buffer, n);
+        if (!reply.empty())
+            datagrams.push_back({focuser, from, reply, Clock::now() + std::chrono::milliseconds(latencyMs())});
+    }
+}
+
+/**
+ * The firmware's udpCommand(): a move runs like its HTTP equivalent, a resent command gets the reply it already had.
+**/
+std::string Farm::udpResponse(Focuser *focuser, const sockaddr_in &from, const uint8_t *data, size_t length)
+{
+    UdpCommand command;
+    if (!decodeUdpCommand(data, length, command))
+        return std::string();
+    bool resend = focuser->udpClient.sin_addr.s_addr == from.sin_addr.s_addr && focuser->udpClient.sin_port == from.sin_port &&
+                  focuser->udpReply.size() == UDP_STATUS_SIZE && (uint8_t)focuser->udpReply[0] == (command.type | UDP_REPLY) &&
+                  udpGet16((const uint8_t *)focuser->udpReply.data() + 1) == command.seq;
+    if (!resend)
+    {
+        if (command.type == UDP_MOVE)
+        {
+            std::string request = "GET /focuser?absolutePosition=" + std::to_string(command.target);
+            if (command.backlashSteps != UDP_KEEP)
+                request += "&backlashSteps=" + std::to_string(command.backlashSteps);
+            if (command.backlashStrategy >= BACKLASH_APPROACH_CCW && command.backlashStrategy <= BACKLASH_APPROACH_CW)
+                request += command.backlashStrategy == BACKLASH_APPROACH_CW ? "&alwaysApproach=CW" :
+                           command.backlashStrategy == BACKLASH_APPROACH_CCW ? "&alwaysApproach=CCW" : "&alwaysApproach=";
+            focuserResponse(focuser, request + " HTTP/1.0\r\n\r\n");
+        }
+        FocuserMotion &motion = *focuser->motion;
+        UdpStatus status = {(uint8_t)(command.type | UDP_REPLY), command.seq, (uint16_t)motion.position(),
+                            (uint16_t)motion.targetPosition(), (uint8_t)(motion.isMoving() ? UDP_FLAG_MOVING : 0),
+                            (uint16_t)focuser->currentSpeed, (uint16_t)focuser->moveCount, (uint8_t)focuser->sequenceStep};
+        uint8_t frame[UDP_STATUS_SIZE];
+        focuser->udpReply.assign((const char *)frame, encodeUdpStatus(status, frame));
+        focuser->udpClient = from;
+    }
+    focuser->udpLastHeard = Clock::now();
+    return focuser->udpReply;
+}
+
+/**
+ * The firmware's sendTelemetry(), sent to the client's address since broadcasts do not reach localhost.
+**/
+void Farm::sendTelemetry(Focuser *focuser)
+{
+    Clock::time_point now = Clock::now();
+    if (!focuser->udpClient.sin_port || focuser->hung || millisecondsSince(focuser->udpLastHeard) > UDP_SUBSCRIPTION_MS)
+        return;
+    FocuserMotion &motion = *focuser->motion;
+    bool moving = motion.isMoving();
+    if (moving == focuser->telemetryMoving &&
+        millisecondsSince(focuser->lastTelemetry) < (moving ? UDP_TELEMETRY_MOVING_MS : UDP_TELEMETRY_IDLE_MS))
+        return;
+    focuser->telemetryMoving = moving;
+    focuser->lastTelemetry = now;
+    UdpStatus status = {UDP_TELEMETRY, ++focuser->telemetrySeq, (uint16_t)motion.position(), (uint16_t)motion.targetPosition(),
+                        (uint8_t)(moving ? UDP_FLAG_MOVING : 0), (uint16_t)focuser->currentSpeed,
+                        (uint16_t)focuser->moveCount, (uint8_t)focuser->sequenceStep};
+    uint8_t frame[UDP_STATUS_SIZE];
+    encodeUdpStatus(status, frame);
+    sendto(focuser->udpSocket, frame, sizeof(frame), 0, (const sockaddr *)&focuser->udpClient, sizeof(focuser->udpClient));
+}
+
+/**
+ * Write every response whose injected latency has passed.
+**/
+void Farm::sendDue()
+{
+    Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < datagrams.size();)
+    {
+        Datagram &datagram = datagrams[i];
+        if (datagram.sendAt > now)
+        {
+            i++;
+            continue;
+        }
+        // Replies still due when the power went off are lost with it
+        if (datagram.focuser->udpSocket >= 0)
+            sendto(datagram.focuser->udpSocket, datagram.bytes.data(), datagram.bytes.size(), 0,
+                   (const sockaddr *)&datagram.to, sizeof(datagram.to));
+        datagram = datagrams.back();
+        datagrams.pop_back();
+    }
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+        Connection *connection = connections[i];
+        if (connection->fd >= 0 && connection->complete && !connection->out.empty() && connection->written == 0 && connection->respondAt <= now)
+            flush(connection);
+    }
+}
+
+void Farm::flush(Connection *connection)
+{
+    while (connection->written < connection->out.size())
+    {
+        ssize_t n = send(connection->fd, connection->out.data() + connection->written, connection->out.size() - connection->written, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            connection->written += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            watch(connection->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, &connection->endpoint, EPOLL_CTL_MOD);
+            return;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        break;
+    }
+    // HTTP/1.0 like the firmware: one response, then close
+    closeConnection(connection);
+}
+
+void Farm::closeConnection(Connection *connection)
+{
+    if (connection->fd < 0)
+        return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    close(connection->fd);
+    connection->fd = -1;
+}
+
+/**
+ * The firmware's loadSequence() and sequenceApproach().
+**/
+static bool loadSequence(Focuser *focuser, const FocuserRequest &request)
+{
+    focuser->sequence.assign(request.sequence, request.sequence + request.sequenceLength);
+    focuser->sequenceStep = 0;
+    focuser->sequenceDirection = focuser->sequence.size() > 1 && focuser->sequence[1] < focuser->sequence[0] ? 1 : -1;
+    return !focuser->sequence.empty();
+}
+
+static int8_t sequenceApproach(Focuser *focuser, int position)
+{
+    for (size_t i = focuser->sequenceStep; i < focuser->sequence.size(); i++)
+    {
+        if (focuser->sequence[i] == position)
+        {
+            focuser->sequenceStep = i + 1;
+            return focuser->sequenceDirection;
+        }
+    }
+    focuser->sequence.clear();
+    focuser->sequenceStep = 0;
+    return 0;
+}
+
+/**
+ * The firmware's loop() and interpretCommand(), against this focuser's state.
+**/
+std::string Farm::focuserResponse(Focuser *focuser, const std::string &request)
+{
+    FocuserMotion &motion = *focuser->motion;
+    FocuserRequest parsed;
+    parseRequest(request.data(), request.size() > 0xFFFF ? 0xFFFF : request.size(), parsed);
+    char frame[128];
+    if (parsed.route == ROUTE_COMPACT)
+    {
+        snprintf(frame, sizeof(frame), "HTTP/1.0 200 OK\r\n\r\n%d %d %d %d %d %d", motion.position(), motion.targetPosition(),
+                 motion.isMoving() ? 1 : 0, focuser->currentSpeed, focuser->moveCount, focuser->sequenceStep);
+        return frame;
+    }
+    if (parsed.route == ROUTE_NOT_FOUND)
+        return "HTTP/1.0 404 Not Found";
+
+    int requestedPosition = motion.targetPosition();
+    bool sequenceLoaded = false;
+    if (parsed.hasQuery)
+    {
+        if (parsed.maxSpeed > 0)
+            focuser->maxSpeed = parsed.maxSpeed;
+        if (parsed.acceleration >= 0)
+            focuser->acceleration = parsed.acceleration;
+        if (parsed.speed > 0)
+            focuser->currentSpeed = parsed.speed < focuser->maxSpeed ? parsed.speed : focuser->maxSpeed;
+        if (parsed.absolutePosition > 0)
+            requestedPosition = parsed.absolutePosition;
+        if (parsed.backlashSteps >= 0)
+            focuser->backlashSteps = parsed.backlashSteps;
+        if (parsed.alwaysApproach != REQUEST_STRATEGY_ABSENT)
+            focuser->backlashStrategy = parsed.alwaysApproach;
+        if (parsed.syncPosition >= 0 && !motion.isMoving())
+        {
+            motion.setPosition(parsed.syncPosition);
+            requestedPosition = parsed.syncPosition;
+            focuser->sequence.clear();
+            focuser->sequenceStep = 0;
+        }
+        if (parsed.hasSequence && loadSequence(focuser, parsed))
+        {
+            requestedPosition = focuser->sequence[0];
+            sequenceLoaded = true;
+        }
+    }
+    if (requestedPosition != motion.targetPosition() || sequenceLoaded)
+    {
+        MoveRequest move = {requestedPosition, focuser->currentSpeed, focuser->maxSpeed, focuser->acceleration,
+                            focuser->backlashSteps, focuser->backlashStrategy};
+        motion.moveTo(move, sequenceApproach(focuser, requestedPosition));
+        focuser->moveCount = (focuser->moveCount + 1) & 0x7FFF;
+        focuser->moves++;
+        if (options.verbose)
+            printf("focuser %d moving to %d\n", focuser->index, requestedPosition);
+    }
+
+    long t = (long)(millisecondsSince(focuser->bootedAt) * options.timeScale / 1000);
+    char temperature[TEMPERATURE_TEXT_SIZE];
+    double hours = millisecondsSince(epoch) * options.timeScale / 3600000;
+    formatTemperature(options.hasTemperature ? (int)lround((options.temperatureStart + options.temperatureRate * hours) * 10)
+                                             : TEMPERATURE_NONE, temperature);
+    char body[640];
+    snprintf(body, sizeof(body),
+             "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nPragma: no-cache\r\n\r\n"
+             "{\"uptime\":\"%02ld:%02ld:%02ld\",\"speed\":%d,\"temperature\":%s,\"temperatureCompensationOn\":false,"
+             "\"backlashSteps\":%d,\"absolutePosition\":%d,\"maxPosition\":%d,\"minPosition\":%d,\"gearBoxMultiplier\":%d,"
+             "\"moving\":%s,\"targetPosition\":%d,\"maxSpeed\":%d,\"acceleration\":%d,\"sequenceStep\":%d,\"sequenceLength\":%d,"
+             "\"bootCount\":%d,\"positionRestored\":%s}",
+             t / 3600 % 100, t / 60 % 60, t % 60, focuser->currentSpeed, temperature, focuser->backlashSteps, motion.position(),
+             MAX_APS_POSN, MIN_APS_POSN, GEARBOX_MULTIPLIER, motion.isMoving() ? "true" : "false",
+             motion.targetPosition(), focuser->maxSpeed, focuser->acceleration, focuser->sequenceStep,
+             (int)focuser->sequence.size(), focuser->journal.bootCount(), focuser->journal.restored() ? "true" : "false");
+    return body;
+}
+
+/**
+ * GET /power/<n>/off or /power/<n>/on.
+**/
+std::string Farm::powerResponse(const std::string &request)
+{
+    int index;
+    char state[4];
+    if (sscanf(request.c_str(), "GET /power/%d/%3[a-z]", &index, state) != 2 || index < 0 || index >= (int)focusers.size())
+        return "HTTP/1.0 404 Not Found";
+    Focuser *focuser = focusers[index].get();
+    if (!strcmp(state, "off"))
+        powerOff(focuser);
+    else if (!strcmp(state, "on"))
+        powerOn(focuser);
+    else
+        return "HTTP/1.0 400 Bad Request";
+    return "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\nOK";
+}
+
+/**
+ * Cut the power: the listener and UDP port go away so new connections are refused, and open ones are dropped.
+**/
+void Farm::powerOff(Focuser *focuser)
+{
+    if (focuser->power == Focuser::POWER_OFF)
+        return;
+    focuser->power = Focuser::POWER_OFF;
+    focuser->driver.stop();
+    closeFocuser(focuser);
+    for (Connection *connection : connections)
+        if (connection->focuser == focuser)
+            closeConnection(connection);
+    if (options.verbose)
+        printf("focuser %d powered off\n", focuser->index);
+}
+
+void Farm::powerOn(Focuser *focuser)
+{
+    if (focuser->power != Focuser::POWER_OFF)
+        return;
+    focuser->power = Focuser::BOOTING;
+    focuser->bootDoneAt = Clock::now() + std::chrono::milliseconds(options.bootMs);
+    focuser->powerCycles++;
+    if (options.verbose)
+        printf("focuser %d booting\n", focuser->index);
+}
+
+void Farm::finishBoots()
+{
+    Clock::time_point now = Clock::now();
+    for (auto &focuser : focusers)
+    {
+        if (focuser->power != Focuser::BOOTING || focuser->bootDoneAt > now)
+            continue;
+        focuser->reset();
+        if (!openFocuser(focuser.get()))
+        {
+            // Port taken meanwhile, try again on the next pass
+            focuser->bootDoneAt = now + std::chrono::milliseconds(100);
+            continue;
+        }
+        focuser->power = Focuser::POWER_ON;
+        if (options.verbose)
+            printf("focuser %d up\n", focuser->index);
+    }
+}
+
+void Farm::printCounters() const
+{
+    printf("%8s %6s %10s %8s %8s %6s %12s %9s\n", "focuser", "port", "requests", "moves", "dropped", "hangs",
+           "powercycles", "position");
+    for (auto &focuser : focusers)
+        printf("%8d %6d %10lu %8lu %8lu %6lu %12lu %9d\n", focuser->index, focuser->port, focuser->requests,
+               focuser->moves, focuser->dropped, focuser->hangs, focuser->powerCycles, focuser->motion->position());
+}
+
+static bool parseOptions(int argc, char *argv[], FarmOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--verbose"))
+        {
+            options.verbose = true;
+            continue;
+        }
+        if (!value)
+            return false;
+        i++;
+        if (!strcmp(arg, "--focusers"))
+            options.focusers = atoi(value);
+        else if (!strcmp(arg, "--port"))
+            options.port = atoi(value);
+        else if (!strcmp(arg, "--power-port"))
+            options.powerPort = atoi(value);
+        else if (!strcmp(arg, "--time-scale"))
+            options.timeScale = atof(value);
+        else if (!strcmp(arg, "--latency"))
+        {
+            if (sscanf(value, "%d:%d", &options.latencyMinMs, &options.latencyMaxMs) == 1)
+                options.latencyMaxMs = options.latencyMinMs;
+        }
+        else if (!strcmp(arg, "--drop-rate"))
+            options.dropRate = atof(value);
+        else if (!strcmp(arg, "--hang-rate"))
+            options.hangRate = atof(value);
+        else if (!strcmp(arg, "--boot-ms"))
+            options.bootMs = atoi(value);
+        else if (!strcmp(arg, "--temperature"))
+            options.hasTemperature = sscanf(value, "%lf:%lf", &options.temperatureStart, &options.temperatureRate) >= 1;
+        else if (!strcmp(arg, "--seed"))
+            options.seed = strtoul(value, nullptr, 10);
+        else
+            return false;
+    }
+    return options.focusers > 0 && options.port > 0 && options.timeScale > 0 && options.latencyMinMs >= 0 &&
+           options.latencyMaxMs >= options.latencyMinMs;
+}
+
+int main(int argc, char *argv[])
+{
+    FarmOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "usage: %s [--focusers N] [--port FIRST] [--power-port P] [--time-scale X] [--latency MIN:MAX]\n"
+                        "       [--drop-rate P] [--hang-rate P] [--boot-ms MS] [--temperature START:RATE] [--seed S]\n"
+                        "       [--verbose]\n", argv[0]);
+        return 2;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    Farm farm(options);
+    if (!farm.start())
+        return 1;
+    farm.run();
+    farm.printCounters();
+    return 0;
+}